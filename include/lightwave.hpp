@@ -14,8 +14,12 @@
 #include <lightwave/registry.hpp>
 
 // MARK: - utilities
+#include <lightwave/alias.hpp>
+#include <lightwave/allocations.hpp>
+#include <lightwave/distributed.hpp>
 #include <lightwave/iterators.hpp>
 #include <lightwave/parallel.hpp>
+#include <lightwave/scheduler.hpp>
 #include <lightwave/streaming.hpp>
 #include <lightwave/warp.hpp>
 
@@ -23,6 +27,7 @@
 #include <lightwave/bsdf.hpp>
 #include <lightwave/camera.hpp>
 #include <lightwave/emission.hpp>
+#include <lightwave/film.hpp>
 #include <lightwave/image.hpp>
 #include <lightwave/instance.hpp>
 #include <lightwave/integrator.hpp>
@@ -0,0 +1,55 @@
+/**
+ * @file alias.hpp
+ * @brief Contains the AliasTable, which samples discrete distributions in constant time.
+ */
+
+#pragma once
+
+#include <lightwave/core.hpp>
+
+#include <algorithm>
+#include <span>
+#include <vector>
+
+namespace lightwave {
+
+/**
+ * @brief Samples indices proportionally to given weights in constant time, using Walker's alias method: each bin
+ * is picked uniformly, and either keeps its own index or forwards to its alias.
+ */
+class AliasTable {
+    struct Bin {
+        /// @brief The probability of keeping the index of the bin (instead of picking its alias).
+        float threshold;
+        /// @brief The probability of sampling the index of the bin.
+        float pmf;
+        /// @brief The index that is picked instead of the bin with probability @c 1-threshold .
+        int alias;
+    };
+    std::vector<Bin> m_bins;
+
+public:
+    AliasTable() = default;
+    /**
+     * @brief Builds the table for the given non-negative weights, which need not be normalized.
+     * @note If all weights are zero, the indices are sampled uniformly.
+     */
+    explicit AliasTable(std::span<const float> weights);
+
+    /// @brief Returns the number of indices of the distribution.
+    int size() const { return int(m_bins.size()); }
+    /// @brief Reports whether the distribution has no indices.
+    bool empty() const { return m_bins.empty(); }
+
+    /// @brief Samples an index using a uniformly distributed random number in [0,1).
+    int sample(float u) const {
+        const float scaled = u * m_bins.size();
+        const int index = std::min(int(scaled), int(m_bins.size()) - 1);
+        return scaled - index < m_bins[index].threshold ? index : m_bins[index].alias;
+    }
+
+    /// @brief Returns the probability of sampling the given index.
+    float pmf(int index) const { return m_bins[index].pmf; }
+};
+
+}
@@ -0,0 +1,57 @@
+/**
+ * @file allocations.hpp
+ * @brief Contains instrumentation that counts heap allocations, which is used to verify that rendering does not
+ * allocate memory in its inner loops.
+ */
+
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/logger.hpp>
+
+#include <cstdint>
+
+namespace lightwave {
+
+/**
+ * @brief Returns the number of heap allocations (calls to the global @c operator @c new ) performed by all threads
+ * so far.
+ * @note Allocations are only counted when compiled with @c LW_COUNT_ALLOCATIONS (e.g., by passing
+ * @c -DEXTRA_DEFINES=LW_COUNT_ALLOCATIONS to CMake), as counting requires an atomic operation per allocation.
+ * Otherwise, this always returns zero.
+ */
+int64_t allocationCount();
+/// @brief Returns the number of bytes allocated on the heap by all threads so far (see @ref allocationCount ).
+int64_t allocatedBytes();
+/// @brief Returns the number of heap allocations performed by the calling thread so far (see @ref allocationCount ).
+int64_t threadAllocationCount();
+
+#ifdef LW_COUNT_ALLOCATIONS
+/**
+ * @brief Reports the number of heap allocations performed during a phase of the program (e.g., loading the scene or
+ * rendering), from construction until destruction of this object.
+ */
+class AllocationPhase {
+    const char *m_name;
+    int64_t m_count;
+    int64_t m_bytes;
+
+public:
+    AllocationPhase(const char *name)
+    : m_name(name), m_count(allocationCount()), m_bytes(allocatedBytes()) {}
+
+    ~AllocationPhase() {
+        const int64_t count = allocationCount() - m_count;
+        const int64_t bytes = allocatedBytes() - m_bytes;
+        logger(EInfo, "%s performed %d heap allocations (%.1f KiB)", m_name, count, bytes / 1024.0);
+    }
+};
+#else
+/// @brief Does nothing unless heap allocations are counted (see @ref allocationCount ).
+class AllocationPhase {
+public:
+    AllocationPhase(const char *name) {}
+};
+#endif
+
+}
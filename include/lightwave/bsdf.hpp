@@ -18,6 +18,9 @@ struct BsdfSample {
     /// @brief The weight of the sample, given by @code cos(theta) * B(wi, wo) /
     /// p(wi) @endcode
     Color weight;
+    /// @brief The probability density (in solid angle) of sampling @c wi , which
+    /// is @c Infinity for specular (i.e., Dirac delta) lobes.
+    float pdf;
 
     /// @brief Return an invalid sample, used to denote that sampling has
     /// failed.
@@ -25,6 +28,7 @@ struct BsdfSample {
         return {
             .wi     = Vector(0),
             .weight = Color(0),
+            .pdf    = 0,
         };
     }
 
@@ -37,11 +41,16 @@ struct BsdfEval {
     /// @brief The value of the Bsdf, given by @code cos(theta) * B(wi, wo)
     /// @endcode
     Color value;
+    /// @brief The probability density (in solid angle) of @ref Bsdf::sample
+    /// sampling @c wi for the given @c wo (used for multiple importance
+    /// sampling).
+    float pdf;
 
     /// @brief Indicates the the Bsdf is zero for the given pair of directions.
     static BsdfEval invalid() {
         return {
             .value = Color(0),
+            .pdf   = 0,
         };
     }
 
@@ -79,6 +88,12 @@ public:
                               Sampler &rng) const = 0;
 
     virtual Color getAlbedo(const Point2 &uv) const = 0; 
+
+    /**
+     * @brief Returns whether the Bsdf reflects light equally in all directions (i.e., is Lambertian), so that the
+     * light it reflects at a point does not depend on the direction it is seen from.
+     */
+    virtual bool isDiffuse() const { return false; }
 };
 
 } // namespace lightwave
@@ -22,6 +22,34 @@ struct CameraSample {
     Color weight;
 };
 
+/// @brief The result of connecting a point in the scene to a Camera using @ref Camera::connect .
+struct CameraConnection {
+    /// @brief The continuous pixel coordinates at which the point is seen, ranging from [0,0] to resolution().
+    Point2 pixel;
+    /// @brief The direction vector, pointing from the point towards the camera.
+    Vector wi;
+    /// @brief The distance from the point to the camera.
+    float distance;
+    /// @brief The importance the camera emits towards the point, given by @code We * cos(theta) / distance^2 @endcode
+    /// where the importance @c We is normalized to integrate to one over the entire image.
+    Color weight;
+
+    /// @brief Return an invalid connection, used to denote that the point cannot be seen by the camera.
+    static CameraConnection invalid() {
+        return {
+            .pixel = Point2(0),
+            .wi = Vector(0),
+            .distance = 0,
+            .weight = Color(0),
+        };
+    }
+
+    /// @brief Tests whether the connection is invalid (i.e., the point cannot be seen by the camera).
+    bool isInvalid() const {
+        return weight == Color(0);
+    }
+};
+
 /// @brief A Camera, representing the relationship between pixel coordinates and rays.
 class Camera : public Object {
 protected:
@@ -60,6 +88,26 @@ public:
      * @param rng A random number generator used to steer the sampling.
      */
     virtual CameraSample sample(const Point2 &normalized, Sampler &rng) const = 0;
+
+    /**
+     * @brief Connects a point in the scene to the camera, which allows paths traced from the light sources to
+     * contribute to the image (e.g., for bidirectional path tracing).
+     * @note Only needs to be implemented by cameras that can be connected to (see @ref canBeConnected ).
+     * @param point The point in world coordinates that should be connected to the camera.
+     * @return The pixel the point is seen at and the importance emitted towards it, or an invalid connection if the
+     * point lies outside of the field of view.
+     */
+    virtual CameraConnection connect(const Point &point) const { return CameraConnection::invalid(); }
+
+    /**
+     * @brief Returns the probability density (in solid angle) of @ref sample generating a ray in a given direction
+     * (in world coordinates) for a uniformly chosen position on the image.
+     * @note Only needs to be implemented by cameras that can be connected to (see @ref canBeConnected ).
+     */
+    virtual float pdfDirection(const Vector &direction) const { return 0; }
+
+    /// @brief Returns whether points in the scene can be connected to the camera (i.e., the camera is a pinhole).
+    virtual bool canBeConnected() const { return false; }
 };
 
 }
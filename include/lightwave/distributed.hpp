@@ -0,0 +1,67 @@
+/**
+ * @file distributed.hpp
+ * @brief Contains utilities to split the rendering of a single image across several processes, which are coordinated
+ * through a local socket.
+ */
+
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/math.hpp>
+
+#include <filesystem>
+#include <string>
+
+namespace lightwave {
+
+/// @brief A part of a render, consisting of a region of the image and a range of sample indices.
+struct WorkUnit {
+    /// @brief The pixels that are to be rendered.
+    Bounds2i region;
+    /// @brief The index of the first sample to take for each pixel.
+    int sampleStart;
+    /// @brief The index after the last sample to take for each pixel.
+    int sampleEnd;
+};
+
+/**
+ * @brief A connection to a coordinator process (see @ref runCoordinator ), which hands out work units to render.
+ * @note Only supported on POSIX platforms.
+ */
+class CoordinatorClient {
+    int m_socket = -1;
+
+    /// @brief Sends a line of text to the coordinator.
+    void send(const std::string &message);
+    /// @brief Receives a line of text from the coordinator.
+    std::string receive();
+
+public:
+    /// @brief Connects to the coordinator listening on the given Unix socket.
+    CoordinatorClient(const std::filesystem::path &socketPath);
+    ~CoordinatorClient();
+
+    /**
+     * @brief Requests the next work unit for an image of the given resolution and sample count.
+     * Returns false once all work has been handed out.
+     * @note Requesting a new unit also informs the coordinator that the previous unit has been rendered.
+     */
+    bool request(const Vector2i &resolution, int samplesPerPixel, WorkUnit &unit);
+
+    /**
+     * @brief Informs the coordinator that the results of all work units have been stored.
+     * Coordinators hand out the units of clients that disconnect without calling this again.
+     */
+    void finish();
+};
+
+/**
+ * @brief Runs a coordinator, which listens on a Unix socket and hands out work units to rendering processes.
+ * The image is divided into tiles of @c tileSize pixels, and the sample indices into chunks of @c sampleChunk
+ * samples. The resolution and sample count are taken from the first request of a client. The coordinator exits once
+ * all units have been rendered and the results of all clients have been stored.
+ * @return The exit code of the coordinator process.
+ */
+int runCoordinator(const std::filesystem::path &socketPath, int tileSize, int sampleChunk);
+
+}
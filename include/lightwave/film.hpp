@@ -0,0 +1,182 @@
+/**
+ * @file film.hpp
+ * @brief Contains the Film class, which accumulates the samples taken for each
+ * pixel over the course of a render.
+ */
+
+#pragma once
+
+#include <lightwave/color.hpp>
+#include <lightwave/core.hpp>
+#include <lightwave/image.hpp>
+#include <lightwave/math.hpp>
+
+#include <shared_mutex>
+#include <vector>
+
+namespace lightwave {
+
+/**
+ * @brief Accumulates the samples of each pixel, which allows rendering an image
+ * in several passes (e.g., progressively) while tracking how many samples each
+ * pixel has received.
+ * The accumulated state can be written to and restored from a compact binary
+ * file, which is used to checkpoint and resume renders, and to merge the
+ * results of renders that were split across several processes.
+ * @note Pixels are not synchronized, callers need to ensure that each pixel is
+ * only accumulated into by one thread at a time (e.g., by rendering disjoint
+ * tiles).
+ */
+class Film {
+public:
+    /// @brief The accumulated state of a single pixel.
+    struct Pixel {
+        /// @brief The sum of all samples taken for this pixel.
+        Color sum;
+        /// @brief The number of samples taken for this pixel.
+        int sampleCount = 0;
+        /// @brief The running mean of the luminance of all samples (Welford's algorithm).
+        float mean = 0;
+        /// @brief The running sum of squared deviations from the mean luminance (Welford's algorithm).
+        float m2 = 0;
+
+        /// @brief Adds a sample, updating the variance estimate.
+        void add(const Color &value) {
+            sum += value;
+            sampleCount++;
+
+            const float luminance = value.luminance();
+            const float delta = luminance - mean;
+            mean += delta / sampleCount;
+            m2 += delta * (luminance - mean);
+        }
+
+        /// @brief Combines the samples of another pixel state into this one (Chan et al.'s parallel variance algorithm).
+        void merge(const Pixel &other) {
+            if (other.sampleCount == 0)
+                return;
+            const int count = sampleCount + other.sampleCount;
+            const float delta = other.mean - mean;
+            mean += delta * other.sampleCount / count;
+            m2 += other.m2 + delta * delta * (float(sampleCount) * other.sampleCount / count);
+            sum += other.sum;
+            sampleCount = count;
+        }
+
+        /// @brief Returns the current estimate (i.e., the mean of all samples).
+        Color estimate() const {
+            return sampleCount ? (1.0f / sampleCount) * sum : Color();
+        }
+
+        /**
+         * @brief Returns the relative standard error of the mean luminance.
+         * The error is taken relative to the mean luminance plus a small constant, so that nearly black pixels do not
+         * require excessive sample counts to be considered converged. Pixels with less than two samples have infinite
+         * error.
+         */
+        float relativeError() const {
+            if (sampleCount < 2)
+                return Infinity;
+            const float variance = m2 / (sampleCount - 1);
+            return std::sqrt(variance / sampleCount) / (std::abs(mean) + 0.01f);
+        }
+    };
+
+private:
+    /// @brief The resolution of this film in pixels.
+    Point2i m_resolution;
+    /// @brief The accumulated state of each pixel in scanline order.
+    std::vector<Pixel, FirstTouchAllocator<Pixel>> m_pixels;
+    /// @brief Guards pixel updates via @ref update against concurrent snapshots taken by @ref save .
+    mutable std::shared_mutex m_snapshotMutex;
+
+public:
+    /// @brief Changes the resolution and discards all samples.
+    void initialize(const Point2i &resolution) {
+        m_resolution = resolution;
+        m_pixels.resize(resolution.x() * resolution.y());
+        for_each_parallel(ChunkedRange(int(m_pixels.size()), 16384),
+                          [&](const Range &range) {
+                              for (int i : range)
+                                  m_pixels[i] = Pixel();
+                          });
+    }
+
+    /// @brief Discards all samples of the pixels within @c region .
+    void clear(const Bounds2i &region) {
+        for (auto pixel : region)
+            (*this)(pixel) = Pixel();
+    }
+
+    /// @brief Adds all samples of the pixels within @c region of another film (of the same resolution) to this film.
+    void merge(const Film &other, const Bounds2i &region) {
+        for (auto pixel : region)
+            (*this)(pixel).merge(other(pixel));
+    }
+
+    /// @brief Returns the resolution of this film in pixels.
+    const Point2i &resolution() const { return m_resolution; }
+    /// @brief Returns the bounding box of this film, ranging from [0,0] to [resolution.x, resolution.y].
+    Bounds2i bounds() const { return { {}, Vector2i(m_resolution) }; }
+
+    /// @brief Returns the accumulated state of a given pixel.
+    const Pixel &operator()(const Point2i &pixel) const {
+        return m_pixels[pixel.y() * m_resolution.x() + pixel.x()];
+    }
+    /// @brief Returns a modifiable reference to the accumulated state of a given pixel.
+    Pixel &operator()(const Point2i &pixel) {
+        return m_pixels[pixel.y() * m_resolution.x() + pixel.x()];
+    }
+
+    /// @brief Adds a sample to a given pixel, updating its variance estimate.
+    void add(const Point2i &pixel, const Color &value) { (*this)(pixel).add(value); }
+
+    /**
+     * @brief Replaces the accumulated state of a given pixel.
+     * Unlike modifying pixels directly, this is safe to use while another thread writes the film to a file via
+     * @ref save , which then either sees the old or the new state of the pixel.
+     */
+    void update(const Point2i &pixel, const Pixel &state) {
+        std::shared_lock lock { m_snapshotMutex };
+        (*this)(pixel) = state;
+    }
+
+    /// @brief Returns the current estimate (i.e., the mean of all samples) of a given pixel.
+    Color estimate(const Point2i &pixel) const { return (*this)(pixel).estimate(); }
+
+    /// @brief Returns the relative standard error of the mean luminance of a given pixel, see
+    /// @ref Pixel::relativeError .
+    float relativeError(const Point2i &pixel) const { return (*this)(pixel).relativeError(); }
+
+    /// @brief Returns the total number of samples taken for all pixels.
+    int64_t totalSamples() const {
+        int64_t total = 0;
+        for (const auto &pixel : m_pixels)
+            total += pixel.sampleCount;
+        return total;
+    }
+
+    /// @brief Writes the current estimates of all pixels within @c block to an image.
+    void develop(Image &image, const Bounds2i &block) const {
+        for (auto pixel : block)
+            image(pixel) = estimate(pixel);
+    }
+
+    /**
+     * @brief Writes the accumulated state of all pixels to a compressed binary file, alongside the time that has
+     * been spent rendering so far.
+     * The file is first written to a temporary location and then moved into place, so that an interruption while
+     * writing never leaves a corrupt file behind.
+     */
+    void save(const std::filesystem::path &path, float elapsedTime) const;
+
+    /**
+     * @brief Restores the accumulated state of all pixels from a file written by @ref save and returns the time
+     * that had been spent rendering.
+     * If the film has not been initialized yet, it takes on the resolution of the file, otherwise the resolutions
+     * must match.
+     */
+    float load(const std::filesystem::path &path);
+};
+
+} // namespace lightwave
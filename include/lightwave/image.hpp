@@ -8,8 +8,10 @@
 
 #include <lightwave/color.hpp>
 #include <lightwave/core.hpp>
+#include <lightwave/iterators.hpp>
 #include <lightwave/logger.hpp>
 #include <lightwave/math.hpp>
+#include <lightwave/parallel.hpp>
 #include <lightwave/properties.hpp>
 
 namespace lightwave {
@@ -20,7 +22,8 @@ class Image final : public Object {
     Point2i m_resolution;
 
     /// @brief A sequence of the pixel colors of this image.
-    std::vector<Color> m_data;
+    /// @note Pixels are not touched on allocation, see @ref initialize .
+    std::vector<Color, FirstTouchAllocator<Color>> m_data;
 
     /// @brief The folder the image was loaded from or should be stored to.
     std::filesystem::path m_basePath;
@@ -65,6 +68,10 @@ public:
         m_basePath = basePath;
     }
 
+    /// @brief Returns the folder the image will be stored in if no explicit
+    /// path is given.
+    const std::filesystem::path &basePath() const { return m_basePath; }
+
     /// @brief Copies the data and resolution from another image, but leaves all
     /// other attributes the same.
     void copy(const Image &image) {
@@ -80,11 +87,20 @@ public:
     void loadImage(const std::filesystem::path &path,
                    bool isLinearSpace = false);
 
-    /// @brief Changes the resolution and sets all pixels to black.
+    /**
+     * @brief Changes the resolution and sets all pixels to black.
+     * Clearing is done in parallel, which spreads the pages of the image across
+     * the NUMA nodes of the worker threads instead of placing all of them in
+     * the memory of the calling thread.
+     */
     void initialize(const Point2i &resolution) {
         m_resolution = resolution;
         m_data.resize(resolution.x() * resolution.y());
-        std::fill(m_data.begin(), m_data.end(), Color());
+        for_each_parallel(ChunkedRange(int(m_data.size()), 16384),
+                          [&](const Range &range) {
+                              for (int i : range)
+                                  m_data[i] = Color();
+                          });
     }
 
     /// @brief Saves the image as an EXR file at a given path.
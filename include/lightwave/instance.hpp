@@ -49,6 +49,8 @@ class Instance : public Shape {
     
     /// @brief Transforms the frame from object coordinates to world coordinates.
     inline void transformFrame(SurfaceEvent &surf) const;
+    /// @brief Transforms an area sample from object coordinates to world coordinates.
+    void transformSample(AreaSample &sample) const;
 
 public:
     Instance(const Properties &properties) 
@@ -114,6 +116,12 @@ public:
      * @return @c true if an intersection was found.
      */
     bool intersect(const Ray &ray, Intersection &its, Sampler &rng) const override;
+    /**
+     * @brief Finds the crossings of a ray in world coordinates with this instance up to a given distance (see
+     * @ref Shape::intersectCrossings ), which blocks the ray unless it is the boundary of a medium.
+     */
+    bool intersectCrossings(const Ray &ray, float tMax, std::vector<MediumCrossing> &crossings,
+                            Sampler &rng) const override;
     /// @brief Returns the bounding box of the instance in world coordinates. 
     Bounds getBoundingBox() const override;
     /// @brief Returns the centroid of the instance in world coordinates. 
@@ -123,6 +131,14 @@ public:
      * @param rng A random number generator used to steer sampling decisions.
      */
     AreaSample sampleArea(Sampler &rng) const override;
+    /**
+     * @brief Samples a point in world coordinates on the surface of this instance that is to illuminate a given point
+     * in world coordinates, preferably proportionally to solid angle (see @ref Shape::sampleAreaFrom ).
+     */
+    AreaSample sampleAreaFrom(const Point &origin, Sampler &rng) const override;
+    /// @brief Returns the density of @ref sampleAreaFrom relative to that of @ref sampleArea for a point in world
+    /// coordinates.
+    float pdfRatioFrom(const Point &origin, const Point &position) const override;
 
     /// @brief Returns a textual representation of this image.
     std::string toString() const override {
@@ -9,9 +9,12 @@
 #include <lightwave/color.hpp>
 #include <lightwave/math.hpp>
 #include <lightwave/sampler.hpp>
+#include <lightwave/film.hpp>
 #include <lightwave/image.hpp>
 #include <lightwave/scene.hpp>
 
+#include <span>
+
 namespace lightwave {
 
 //#define DEBUG_PIXEL
@@ -31,6 +34,41 @@ extern t_debugPixel debugPixel;
 #define DEBUG_PIXEL_LOG(...) do {} while(0)
 #endif
 
+/// @brief Settings for the renders of sampling integrators, which are configured from the command line.
+struct RenderSettings {
+    /// @brief The interval (in seconds) at which the accumulated samples are written to disk, or zero to disable
+    /// checkpointing.
+    float checkpointInterval = 0;
+    /// @brief Whether renders continue from an existing checkpoint instead of starting from scratch.
+    bool resume = false;
+    /// @brief Set to request that running renders stop as soon as possible (e.g., when the process is asked to
+    /// terminate), after which a final checkpoint is written.
+    std::atomic<bool> interrupted = false;
+
+    /// @brief Restricts rendering to a region of the image (an empty region renders the entire image).
+    Bounds2i region;
+    /// @brief The index of the first sample to take for each pixel.
+    int sampleStart = 0;
+    /// @brief The index after the last sample to take for each pixel, or zero to take all samples of the sampler.
+    int sampleEnd = 0;
+    /// @brief The socket of a coordinator that hands out regions and sample ranges to render, if any.
+    std::filesystem::path coordinator;
+    /// @brief The film file used for checkpoints and partial renders, which defaults to the path of the output
+    /// image with the extension ".film".
+    std::filesystem::path filmPath;
+};
+
+/// @brief The global render settings.
+extern RenderSettings renderSettings;
+
+/// @brief Identifies a single sample of a pixel, which is estimated by @ref SamplingIntegrator::estimate .
+struct PixelSample {
+    /// @brief The pixel the sample belongs to.
+    Point2i pixel;
+    /// @brief The index of the sample within the pixel, which is used to seed the sampler.
+    int sampleIndex;
+};
+
 /**
  * @brief Integrators are rendering algorithms that take a scene and produce an image from them (e.g., using path tracing).
  * The term integrator refers to the key challenge of simulating light transport, namely solving the reflected radiance integral.
@@ -54,6 +92,44 @@ protected:
     ref<Image> m_image;
     /// @brief The scene that should be rendered.
     ref<Scene> m_scene;
+    /// @brief The samples accumulated for each pixel of the image.
+    Film m_film;
+
+    /// @brief The time (in seconds) after which rendering stops, or zero for no limit.
+    float m_timeBudget;
+    /**
+     * @brief Whether the image is rendered progressively, i.e., the whole frame is rendered in passes of
+     * @ref m_samplesPerPass samples instead of rendering each tile to its full sample count at once.
+     */
+    bool m_progressive;
+    /// @brief The number of samples per pixel taken in each pass of a progressive render.
+    int m_samplesPerPass;
+    /// @brief The factor by which the resolution is reduced for a quick preview before the first progressive pass
+    /// (a factor of one disables the preview).
+    int m_previewScale;
+
+    /**
+     * @brief Whether pixels are sampled adaptively, i.e., pixels stop receiving samples once their relative error
+     * falls below @ref m_errorThreshold and the saved samples are spent on noisier pixels instead. The total number
+     * of samples taken stays bounded by the sample count of the sampler times the number of pixels.
+     */
+    bool m_adaptive;
+    /// @brief The relative error below which a pixel is considered converged when sampling adaptively.
+    float m_errorThreshold;
+    /// @brief The number of samples every pixel receives before its error is estimated when sampling adaptively.
+    int m_minSamples;
+    /// @brief The maximum number of samples a single pixel can receive when sampling adaptively.
+    int m_maxSamples;
+    /// @brief An optional image that receives the final number of samples taken for each pixel.
+    ref<Image> m_sampleCountImage;
+    /// @brief The maximum number of pixel samples that are handed to @ref estimate at once.
+    int m_batchSize = 1;
+    /**
+     * @brief Whether @ref Li is called for samples that are not part of the image (i.e., while estimating the cost of
+     * tiles or rendering the preview), which repeat the seeds of the first sample of their pixels. Integrators must
+     * not record anything from such samples that is added to the image later on (e.g., splats).
+     */
+    bool m_previewing = false;
 
 public:
     SamplingIntegrator(const Properties &properties)
@@ -61,6 +137,19 @@ public:
         m_sampler = properties.getChild<Sampler>();
         m_image = properties.getOptionalChild<Image>();
         m_scene = properties.getChild<Scene>();
+
+        m_timeBudget = properties.get<float>("timeBudget", 0);
+        m_progressive = properties.get<bool>("progressive", m_timeBudget > 0);
+        m_previewScale = std::max(properties.get<int>("previewScale", 1), 1);
+
+        m_adaptive = properties.get<bool>("adaptive", false);
+        m_errorThreshold = properties.get<float>("errorThreshold", 0.01f);
+        m_minSamples = std::max(properties.get<int>("minSamples", 16), 2);
+        m_maxSamples = properties.get<int>("maxSamples", 4 * m_sampler->samplesPerPixel());
+        m_sampleCountImage = properties.get<Image>("sampleCount", nullptr);
+
+        // adaptive sampling re-evaluates the error after each pass, for which single samples are too fine-grained
+        m_samplesPerPass = std::max(properties.get<int>("samplesPerPass", m_adaptive ? 8 : 1), 1);
     }
 
     /// @brief Sets the output image that should be populated by rendering.
@@ -83,6 +172,22 @@ public:
      * @ref execute function of the integrator.
      */
     virtual Color Li(const Ray &ray, Sampler &rng) = 0;
+
+    /**
+     * @brief Estimates the color of a batch of pixel samples (i.e., the radiance along their camera rays, weighted
+     * by the camera), writing the result of each sample to the corresponding entry of @c results .
+     * By default, this seeds the sampler for each sample, generates its camera ray and invokes @ref Li . Integrators
+     * that benefit from processing many paths at once (e.g., wavefront integrators) can override this, in which case
+     * @ref m_batchSize controls how many samples they receive.
+     */
+    virtual void estimate(std::span<const PixelSample> samples, std::span<Color> results, Sampler &rng);
+
+    /**
+     * @brief Called once all samples have been taken and before the image is saved, which allows adding
+     * contributions that have not been found by the samples of the pixels they belong to (e.g., light paths that
+     * are connected to the camera and splatted onto the image).
+     */
+    virtual void finishImage() {}
 };
 
 }
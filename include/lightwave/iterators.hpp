@@ -72,7 +72,7 @@ public:
     ChunkedRange(int count, int blockSize)
     : ChunkedRange(0, count, blockSize) {}
 
-    iterator begin() const { return iterator(m_start, m_start + m_blockSize, m_end); }
+    iterator begin() const { return iterator(m_start, std::min(m_end, m_start + m_blockSize), m_end); }
     iterator end() const { return iterator(m_end, m_end, m_end); }
 
 private:
@@ -158,4 +158,62 @@ public:
     iterator end() const { return { *this, -1, 0 }; }
 };
 
+/**
+ * @brief Iterates over the pixels of a block in Morton (Z-curve) order.
+ * Compared to scanline order, consecutive pixels stay close to each other in both dimensions, which keeps the memory
+ * accessed by rays of neighbouring pixels (acceleration structures, textures, etc) in cache.
+ */
+class MortonOrder {
+public:
+    struct iterator {
+        Point2i operator*() const { return m_order.m_bounds.min() + position(); }
+        bool operator!=(const iterator &other) const { return m_code != other.m_code; }
+        iterator &operator++() {
+            // skip codes outside of the block, which occur for blocks that are not power-of-two squares
+            do {
+                m_code++;
+            } while (m_code < m_order.m_codeCount && !inside());
+            return *this;
+        }
+
+    private:
+        friend class MortonOrder;
+        iterator(const MortonOrder &order, uint32_t code) : m_order(order), m_code(code) {}
+
+        /// @brief Extracts the even bits of a 32-bit integer.
+        static int compact(uint32_t x) {
+            x &= 0x55555555;
+            x = (x ^ (x >> 1)) & 0x33333333;
+            x = (x ^ (x >> 2)) & 0x0f0f0f0f;
+            x = (x ^ (x >> 4)) & 0x00ff00ff;
+            x = (x ^ (x >> 8)) & 0x0000ffff;
+            return int(x);
+        }
+
+        Vector2i position() const { return { compact(m_code), compact(m_code >> 1) }; }
+        bool inside() const {
+            const Vector2i p = position(), size = m_order.m_bounds.diagonal();
+            return p.x() < size.x() && p.y() < size.y();
+        }
+
+        const MortonOrder &m_order;
+        uint32_t m_code;
+    };
+
+    MortonOrder(const Bounds2i &bounds)
+    : m_bounds(bounds) {
+        const Vector2i size = bounds.diagonal();
+        uint32_t extent = 1;
+        while (int(extent) < std::max(size.x(), size.y())) extent <<= 1;
+        m_codeCount = bounds.isEmpty() ? 0 : extent * extent;
+    }
+
+    iterator begin() const { return { *this, 0 }; }
+    iterator end() const { return { *this, m_codeCount }; }
+
+private:
+    Bounds2i m_bounds;
+    uint32_t m_codeCount;
+};
+
 }
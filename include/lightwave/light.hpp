@@ -9,6 +9,8 @@
 #include <lightwave/color.hpp>
 #include <lightwave/math.hpp>
 
+#include <optional>
+
 namespace lightwave {
 
 /// @brief The result of sampling a light from a given query point using @ref Light::sampleDirect .
@@ -19,6 +21,9 @@ struct DirectLightSample {
     Color weight;
     /// @brief The distance from the query point to the sampled point on the light source.
     float distance;
+    /// @brief The probability density (in solid angle) of sampling @c wi , which is @c Infinity for light sources
+    /// that cannot be hit by rays (e.g., point lights).
+    float pdf;
 
     /// @brief Return an invalid sample, used to denote that sampling has failed.
     static DirectLightSample invalid() {
@@ -26,6 +31,7 @@ struct DirectLightSample {
             .wi = Vector(),
             .weight = Color(),
             .distance = 0,
+            .pdf = 0,
         };
     }
 
@@ -35,6 +41,65 @@ struct DirectLightSample {
     }
 };
 
+/// @brief The densities of sampling a ray of light leaving a light source using @ref Light::sampleEmission .
+struct EmissionPdf {
+    /// @brief The density (in area) of sampling the origin of the ray, which is one for light sources that emit
+    /// from a single point.
+    float position;
+    /// @brief The density (in solid angle) of sampling the direction of the ray.
+    float direction;
+};
+
+/// @brief The result of sampling a ray of light leaving a light source using @ref Light::sampleEmission .
+struct EmissionSample {
+    /// @brief The ray along which light leaves the light source (in world coordinates).
+    Ray ray;
+    /// @brief The power carried by the ray, given by @code Le * cos(theta) / (p(x) * p(w)) @endcode
+    Color weight;
+    /// @brief The surface normal at the origin of the ray, or zero for light sources without a surface.
+    Vector normal;
+    /// @brief The densities of having sampled the ray, which are only provided by light sources within the scene
+    /// (i.e., those that have @ref Light::bounds ).
+    EmissionPdf pdf;
+    /// @brief The light source the ray leaves, which is set by @ref Scene::sampleEmission .
+    const Light *light;
+
+    /// @brief Return an invalid sample, used to denote that sampling has failed.
+    static EmissionSample invalid() {
+        return {
+            .ray = Ray(),
+            .weight = Color(0),
+            .normal = Vector(0),
+            .pdf = { 0, 0 },
+            .light = nullptr,
+        };
+    }
+
+    /// @brief Tests whether the sample is invalid (i.e., sampling has failed).
+    bool isInvalid() const {
+        return weight == Color(0);
+    }
+};
+
+/**
+ * @brief Bounds the region and directions a light source emits from, used to estimate its contribution to points in
+ * the scene when picking light sources (e.g., by the light BVH of the @ref Scene ).
+ */
+struct LightBounds {
+    /// @brief The region of space the light source emits from (in world coordinates).
+    Bounds bounds;
+    /// @brief An estimate of the total power emitted by the light source (averaged over the color channels).
+    float power;
+    /// @brief The central direction of the cone that bounds the surface normals of the light source.
+    Vector axis;
+    /// @brief The cosine of the opening angle of the cone that bounds the surface normals (-1 for all directions).
+    float cosThetaO;
+    /// @brief The cosine of the largest angle between the normals and the directions light is emitted into.
+    float cosThetaE;
+    /// @brief Whether light is also emitted on the back side of the surfaces (i.e., around @c -axis ).
+    bool twoSided;
+};
+
 /**
  * @brief A light source that can be sampled for direct connections.
  * Some light sources can also be intersected by rays (e.g., area lights or the background light),
@@ -49,8 +114,53 @@ public:
      */
     virtual DirectLightSample sampleDirect(const Point &origin, Sampler &rng) const = 0;
 
+    /**
+     * @brief Returns the probability density (in solid angle) of @ref sampleDirect sampling a given point on the
+     * light source, which is needed to weight the emission of light sources that have been hit by rays (e.g., for
+     * multiple importance sampling).
+     * @note Only needs to be implemented by light sources that can be intersected.
+     * @param origin The light receiving point that the probability should be computed for.
+     * @param event The point on the light source that has been hit (in world coordinates).
+     */
+    virtual float pdfDirect(const Point &origin, const SurfaceEvent &event) const { return 0; }
+
+    /**
+     * @brief Samples a ray of light leaving the light source, which is used to trace light paths from the light
+     * sources into the scene (e.g., for photon mapping).
+     * @param sceneBounds The bounding box of the scene geometry, which light sources at infinity shoot their rays at.
+     * @param rng A random number generator used to steer the sampling.
+     */
+    virtual EmissionSample sampleEmission(const Bounds &sceneBounds, Sampler &rng) const {
+        return EmissionSample::invalid();
+    }
+
+    /**
+     * @brief Returns the densities of @ref sampleEmission sampling a ray that leaves a given point on the light source
+     * in a given direction, which is needed to weight paths that reach light sources against paths traced from them
+     * (e.g., for bidirectional path tracing).
+     * @note Only needs to be implemented by light sources within the scene (i.e., those that have @ref bounds ).
+     * @param event The point on the light source (in world coordinates), whose @c pdf is the density of sampling it
+     * by area (as reported by intersections).
+     * @param direction The direction in which light leaves the point.
+     */
+    virtual EmissionPdf pdfEmission(const SurfaceEvent &event, const Vector &direction) const { return { 0, 0 }; }
+
     /// @brief Returns whether this light source can be hit by rays (i.e., has an area that has been placed within the scene).
     virtual bool canBeIntersected() const { return false; }
+
+    /**
+     * @brief Returns an estimate of the total power emitted by the light source (averaged over the color channels),
+     * by which light sources are picked when sampling them proportional to their power.
+     * @param sceneBounds The bounding box of the scene geometry, which light sources at infinity use to estimate the
+     * power arriving at the scene.
+     */
+    virtual float power(const Bounds &sceneBounds) const = 0;
+
+    /**
+     * @brief Returns the region and directions the light source emits from, or nothing for light sources at
+     * infinity (e.g., directional lights or the background light).
+     */
+    virtual std::optional<LightBounds> bounds() const { return std::nullopt; }
 };
 
 /// @brief The result of evaluating a @ref BackgroundLight for a incident direction.
@@ -77,6 +187,11 @@ public:
         return DirectLightSample::invalid();
     }
 
+    using Light::pdfDirect;
+    /// @brief Returns the probability density (in solid angle) of @ref sampleDirect sampling a given direction
+    /// pointing away from the scene.
+    virtual float pdfDirect(const Vector &direction) const { return 0; }
+
     bool canBeIntersected() const override { return true; }
 };
 
@@ -6,8 +6,11 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
 #include <lightwave/core.hpp>
+#include <memory>
 #include <mutex>
+#include <thread>
 
 namespace lightwave {
 
@@ -19,52 +22,105 @@ enum LogLevel {
     EError = 3,
 };
 
-/// @brief The interface used to log messages to console output.
+class ProgressReporter;
+
+/**
+ * @brief The interface used to log messages to console output.
+ *
+ * Messages are formatted by the calling thread and placed in a lock-free ring
+ * buffer, from which a background thread writes them to the console in the
+ * order they were logged. This keeps threads that log (or report progress)
+ * from contending for the console. The background thread also redraws the
+ * status line at a fixed rate. Pending messages are written when the logger
+ * is destroyed (i.e., on exit), on @ref flush , and when the process crashes.
+ */
 class Logger {
-    /// @brief Synchronization to ensure that messages from different threads
-    /// are not intermangled.
-    std::mutex m_mutex;
-    /// @brief A status message to be shown at the bottom of console output
-    /// (e.g., render progress in percent).
+    /// @brief An entry of the ring buffer (see Vyukov's bounded MPMC queue).
+    struct Slot {
+        /// @brief Equals the position of the message in the sequence of all messages when the slot can be written,
+        /// and the position plus one once the message has been written.
+        std::atomic<uint64_t> sequence;
+        LogLevel level;
+        std::string message;
+    };
+
+    /// @brief The number of messages that can be queued before logging threads have to wait.
+    static constexpr uint64_t Capacity = 1024;
+    /// @brief The interval (in milliseconds) at which the status line is redrawn.
+    static constexpr int StatusInterval = 100;
+
+    std::unique_ptr<Slot[]> m_slots;
+    /// @brief The position of the next message to be queued.
+    std::atomic<uint64_t> m_tail;
+    /// @brief The position of the next message to be written.
+    std::atomic<uint64_t> m_head;
+
+    /// @brief Serializes writing to the console (between the background thread, @ref flush and crash handlers).
+    std::mutex m_outputMutex;
+    /// @brief Guards the status line and the progress reporter that provides it.
+    std::mutex m_statusMutex;
+    /// @brief A status message to be shown at the bottom of console output.
     std::string m_status;
+    /// @brief Whether the status has been changed since it has last been drawn.
+    bool m_statusChanged = false;
+    /// @brief A progress reporter that provides the status line while it is registered.
+    const ProgressReporter *m_progress = nullptr;
+
+    /// @brief The background thread that writes queued messages and redraws the status.
+    std::thread m_thread;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    /// @brief Set to stop the background thread, after which messages are written directly.
+    std::atomic<bool> m_stopped;
+
+    /// @brief Queues a formatted message (or writes it directly if the background thread has stopped).
+    void log(LogLevel level, std::string &&message);
+    /// @brief Removes the next message from the queue, returning false if the queue is empty.
+    bool dequeue(LogLevel &level, std::string &message);
+    /// @brief Writes all queued messages and the current status to the console, where the caller must hold
+    /// @ref m_outputMutex .
+    void drain();
 
 public:
+    Logger();
+    ~Logger();
+
     /// @brief Logs a message to console output, which will be constructed from
     /// the given format string and corresponding arguments.
     template <typename... Args>
     void operator()(LogLevel level, const char *fmt, const Args &...args) {
-        std::unique_lock lock{ m_mutex };
-
-        std::cout << "\033[2K\r";
-
-        switch (level) {
-            case EDebug:
-                std::cout << "\033[90m[debug] \033[0m";
-                break;
-            case EInfo:
-                std::cout << "\033[32m[info] \033[0m";
-                break;
-            case EWarn:
-                std::cout << "\033[33m[warn] \033[0m";
-                break;
-            case EError:
-                std::cout << "\033[31m[error] \033[0m";
-                break;
-        }
-        (level >= EError ? std::cerr : std::cout)
-            << tfm::format(fmt, args...) << std::endl;
-
-        std::cout << m_status << std::flush;
+        log(level, tfm::format(fmt, args...));
     }
 
     /// @brief Sets the status text for display at the bottom of console output,
     /// constructed from a given format string.
     template <typename... Args>
     void setStatus(const char *fmt, const Args &...args) {
-        std::unique_lock lock{ m_mutex };
-        m_status = tfm::format(fmt, args...);
-        std::cout << "\033[2K\r" << m_status << std::flush;
+        std::string status = tfm::format(fmt, args...);
+        {
+            std::unique_lock lock{ m_statusMutex };
+            m_status        = std::move(status);
+            m_statusChanged = true;
+        }
+        m_wake.notify_one();
     }
+
+    /**
+     * @brief Shows the progress of the given reporter in the status line, which
+     * is redrawn at a fixed rate until @ref setProgress is called again (e.g.,
+     * with @c nullptr ).
+     */
+    void setProgress(const ProgressReporter *progress);
+
+    /// @brief Writes all queued messages to the console before returning.
+    void flush();
+
+    /**
+     * @brief Writes all queued messages from a crashing thread, which does not
+     * wait for other threads that might hold the console (e.g., when they have
+     * crashed while writing).
+     */
+    void flushOnCrash();
 };
 
 /// @brief The interface used to log messages to console output.
@@ -75,15 +131,15 @@ extern Logger logger;
 class ProgressReporter {
     /// @brief The number of work units that need to be completed for the task
     /// to finish.
-    int m_unitsTotal;
+    int64_t m_unitsTotal;
     /// @brief The number of work units that have been completed so far.
-    std::atomic<int> m_unitsCompleted;
+    std::atomic<int64_t> m_unitsCompleted;
     /// @brief Measures how much time has elapsed since work began.
     Timer m_timer;
     /// @brief Tracks whether the work has been finished.
     bool m_hasFinished;
 
-    std::string makeProgressBar(float progress, int width = 32) {
+    static std::string makeProgressBar(float progress, int width = 32) {
         int index          = int(round(progress * width));
         std::string result = "\033[96m";
         for (int i = 0; i < width; i++) {
@@ -95,28 +151,33 @@ class ProgressReporter {
     }
 
 public:
-    ProgressReporter(int unitsTotal) {
+    ProgressReporter(int64_t unitsTotal) {
         m_unitsTotal     = unitsTotal;
         m_unitsCompleted = 0;
         m_hasFinished    = false;
 
-        logger.setStatus("\033[96m[render]\033[0m starting render job");
+        logger.setProgress(this);
     }
 
     /// @brief The number of work units that have been completed so far.
-    int unitsCompleted() const { return m_unitsCompleted; }
+    int64_t unitsCompleted() const { return m_unitsCompleted; }
     /// @brief The number of work units that need to be completed for the task
     /// to finish.
-    int uintsTotal() const { return m_unitsTotal; }
+    int64_t uintsTotal() const { return m_unitsTotal; }
 
-    /// @brief Marks a number of @c unitsCompleted as completed and notifies the
-    /// user about the progress.
-    void operator+=(int unitsCompleted) {
-        m_unitsCompleted += unitsCompleted;
+    /// @brief Marks a number of @c unitsCompleted as completed, which the
+    /// logger shows to the user the next time it redraws the status line.
+    void operator+=(int64_t unitsCompleted) {
+        m_unitsCompleted.fetch_add(unitsCompleted, std::memory_order_relaxed);
+    }
+
+    /// @brief Returns the status line showing the current progress.
+    std::string status() const {
         const auto progress    = m_unitsCompleted / float(m_unitsTotal);
         const auto elapsedTime = m_timer.getElapsedTime();
-
-        logger.setStatus(
+        if (progress <= 0)
+            return "\033[96m[render]\033[0m starting render job";
+        return tfm::format(
             "\033[96m[render]\033[0m %s \033[96m%3.0f%%\033[0m "
             "(\033[92m%.0fs\033[0m elapsed, \033[93m%.0fs\033[0m eta)",
             makeProgressBar(progress), 100 * progress, elapsedTime,
@@ -127,6 +188,7 @@ public:
     void finish() {
         if (m_hasFinished)
             return;
+        logger.setProgress(nullptr);
         logger.setStatus("");
         logger(EInfo, "done! took %.2f seconds", m_timer.getElapsedTime());
         m_hasFinished = true;
@@ -39,6 +39,13 @@ public:
 
     virtual float probabilityOfSampelingThisPoint(float t) const = 0;
 
+    /**
+     * @brief Whether the medium has the same density everywhere, in which case @ref probabilityOfSampelingThisPoint
+     * is the exact density of the distances returned by @ref sampleHitDistance (which allows combining them with
+     * other sampling techniques using multiple importance sampling).
+     */
+    virtual bool isHomogeneous() const { return false; }
+
     virtual Vector samplePhase(Intersection &its, Sampler &rng) const = 0;
 };
 
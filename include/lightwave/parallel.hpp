@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <memory>
 #include <mutex>
 #include <thread>
 
@@ -19,6 +20,69 @@
 
 namespace lightwave {
 
+/**
+ * @brief Returns the number of worker threads used for parallel loops.
+ * Defaults to one thread per core available to the process.
+ */
+int threadCount();
+
+/// @brief Sets the number of worker threads used for parallel loops, where a
+/// count of zero (or less) restores the default of one thread per core.
+void setThreadCount(int count);
+
+/**
+ * @brief Enables or disables pinning worker threads to cores.
+ * When enabled, worker @c i is bound to the @c i -th core (modulo the number of
+ * cores) the process is allowed to run on, which keeps caches warm and stops
+ * the OS from migrating workers between sockets.
+ * @note Only supported on Linux, a warning is issued on other platforms.
+ */
+void setThreadPinning(bool enabled);
+
+/// @brief Returns the index of the calling worker thread in [0, threadCount()),
+/// or zero when called outside of a parallel loop.
+int threadIndex();
+
+/// @brief Marks the calling thread as worker @c index and pins it to its core
+/// if requested. Called by @ref for_each_parallel for each thread it spawns.
+void initializeWorkerThread(int index);
+
+/// @brief Returns the number of NUMA nodes of this machine (one if NUMA is not
+/// supported).
+int numaNodeCount();
+
+/**
+ * @brief Enables or disables interleaving memory allocated by the calling
+ * thread across all NUMA nodes.
+ * This is used while loading the scene, so that read-only data shared by all
+ * workers (such as acceleration structures and meshes) is spread evenly across
+ * sockets instead of residing in the memory of the loading thread.
+ * @note Has no effect on machines with a single NUMA node.
+ */
+void setNumaInterleaving(bool enabled);
+
+/**
+ * @brief An allocator that does not initialize elements on value-construction.
+ * Containers using this leave freshly allocated memory untouched, so that each
+ * page is placed on the NUMA node of the thread that first writes to it.
+ */
+template <typename T> struct FirstTouchAllocator : std::allocator<T> {
+    template <typename U> struct rebind {
+        using other = FirstTouchAllocator<U>;
+    };
+
+    FirstTouchAllocator() = default;
+    template <typename U>
+    FirstTouchAllocator(const FirstTouchAllocator<U> &) noexcept {}
+
+    /// @brief Leaves value-constructed elements uninitialized.
+    template <typename U> void construct(U *) noexcept {}
+    template <typename U, typename... Args>
+    void construct(U *ptr, Args &&...args) {
+        ::new (static_cast<void *>(ptr)) U(std::forward<Args>(args)...);
+    }
+};
+
 /// @brief Invokes @c f for each element of the iterator, parallelized across
 /// all available cores.
 template <class ForwardIt, class UnaryFunction>
@@ -30,13 +94,14 @@ void for_each_parallel(ForwardIt first, ForwardIt last, UnaryFunction f) {
 
     std::mutex m_lock;
 
-    const int numThreads = std::thread::hardware_concurrency();
+    const int numThreads = threadCount();
     std::vector<std::thread> m_threads;
     m_threads.reserve(numThreads);
 
     // build a thread pool
     for (int i = 0; i < numThreads; i++) {
-        m_threads.emplace_back([&]() {
+        m_threads.emplace_back([&, i]() {
+            initializeWorkerThread(i);
             while (true) {
                 m_lock.lock();
                 if (!(first != last)) {
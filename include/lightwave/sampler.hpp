@@ -10,6 +10,8 @@
 #include <lightwave/math.hpp>
 #include <lightwave/properties.hpp>
 
+#include <span>
+
 namespace lightwave {
 
 /**
@@ -36,6 +38,16 @@ public:
         return { next(), next() };
     }
 
+    /**
+     * @brief Fills the given span with the next random numbers in the interval [0,1), which are identical to those
+     * generated by calling @ref next for each of them. Samplers can override this to generate multiple numbers at
+     * once (e.g., with SIMD instructions), which is useful to draw all random numbers of a path vertex in one call.
+     */
+    virtual void nextBatch(std::span<float> values) {
+        for (float &value : values)
+            value = next();
+    }
+
     /**
      * @brief Initiates a random number sequence characterized by the given number.
      * @note When identical samplers are given the same seed, they are expected to produce the same sequence
@@ -48,6 +60,15 @@ public:
      * of random numbers. For different seeds, they are expected to give different random sequences.
      */
     virtual void seed(const Point2i &pixel, int sampleIndex) = 0;
+    /**
+     * @brief Skips ahead in the current random number sequence, as if @ref next had been called @c count times.
+     * This allows integrators that interleave the processing of many paths (e.g., wavefront integrators) to give
+     * each stage of a path its own part of the sequence.
+     */
+    virtual void skip(int count) {
+        for (int i = 0; i < count; i++)
+            next();
+    }
     /// @brief Returns an identical copy of the sampler, e.g., for use in different threads. 
     virtual ref<Sampler> clone() const = 0;
 
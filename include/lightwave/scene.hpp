@@ -1,11 +1,13 @@
 /**
- * @file sampler.hpp
+ * @file scene.hpp
  * @brief Contains the Scene interface and related structures.
  */
 
 #pragma once
 
 #include <lightwave/core.hpp>
+#include <lightwave/alias.hpp>
+#include <unordered_map>
 #include <vector>
 
 namespace lightwave {
@@ -16,6 +18,23 @@ struct LightSample {
     const Light *light;
     /// @brief The probability of this light source having been picked.
     float probability;
+
+    /// @brief Tests whether the sample is invalid (i.e., no light source contributes to the query point).
+    bool isInvalid() const { return light == nullptr; }
+};
+
+class LightBVH;
+struct MediumCrossing;
+struct EmissionSample;
+
+/// @brief How the scene picks light sources in @ref Scene::sampleLight .
+enum class LightSelection {
+    /// @brief All light sources are equally likely.
+    Uniform,
+    /// @brief Light sources are picked proportionally to their estimated power.
+    Power,
+    /// @brief Light sources are picked by their estimated contribution to the query point, using a light BVH.
+    BVH,
 };
 
 /// @brief Scenes are the input to rendering algorithms: They contain all geometry, materials, lights and the camera.
@@ -31,6 +50,26 @@ class Scene : public Object {
      * @note Emissive objects will only be part of this list if explicitly requested (i.e., an AreaLight has been created for them).
      */
     std::vector<ref<Light>> m_lights;
+    /// @brief The index of each light source within @ref m_lights .
+    std::unordered_map<const Light *, int> m_lightIndices;
+    /// @brief How light sources are picked.
+    LightSelection m_lightSelection;
+    /// @brief Picks light sources proportionally to their power (for @ref LightSelection::Power ).
+    AliasTable m_lightPowers;
+    /// @brief Picks light sources by their contribution to a point (for @ref LightSelection::BVH ).
+    ref<LightBVH> m_lightBvh;
+    /// @brief The light sources at infinity, which are not part of @ref m_lightBvh .
+    std::vector<int> m_infiniteLights;
+    /// @brief The probability of picking one of the light sources at infinity (for @ref LightSelection::BVH ).
+    float m_infiniteProbability;
+    /// @brief Picks light sources to emit light from proportionally to their power (for @ref sampleEmission ).
+    AliasTable m_emissionPowers;
+    /// @brief The bounding box of the scene geometry (or a unit box for empty scenes), which light sources at
+    /// infinity cover with their emission.
+    Bounds m_lightSceneBounds;
+
+    /// @brief Prepares the data structures for picking light sources.
+    void buildLightSelection();
 
 public:
     Scene(const Properties &properties);
@@ -43,6 +82,13 @@ public:
     Intersection intersect(const Ray &ray, Sampler &rng, const int maxForwards = std::numeric_limits<int>::max()) const;
     /// @brief Reports whether any intersection up to a given maximal distance exists (used for testing visibility of light sources).
     bool intersect(const Ray &ray, float tMax, Sampler &rng) const;
+    /**
+     * @brief Finds the crossings of a ray with the boundaries of media up to a given distance in a single traversal
+     * (used for computing the transmittance of shadow rays).
+     * @param crossings Receives the crossings ordered by distance (cleared first, so that it can be reused).
+     * @return False if an opaque surface blocks the ray before the maximal distance.
+     */
+    bool intersectCrossings(const Ray &ray, float tMax, std::vector<MediumCrossing> &crossings, Sampler &rng) const;
     /// @brief Evaluates the background illumination for a given direction pointing away from the scene.
     BackgroundLightEval evaluateBackground(const Vector &direction) const;
 
@@ -50,10 +96,24 @@ public:
     bool hasLights() const { return !m_lights.empty(); }
     /// @brief Reports whether a background light exists. 
     bool hasBackground() const { return m_background != nullptr; }
-    /// @brief Randomly picks a light from the list of sampleable light sources. 
-    LightSample sampleLight(Sampler &rng) const;
-    /// @brief Returns the probability of randomly picking a light source via @ref sampleLight .
-    float lightSelectionProbability(const Light *light) const;
+    /// @brief Returns the background light (or null if no background light exists).
+    const BackgroundLight *background() const { return m_background.get(); }
+    /**
+     * @brief Randomly picks a light from the list of sampleable light sources.
+     * @param origin The point that is to be illuminated, which steers the choice when using a light BVH.
+     * @param rng A random number generator used to steer the choice.
+     */
+    LightSample sampleLight(const Point &origin, Sampler &rng) const;
+    /// @brief Returns the probability of randomly picking a light source via @ref sampleLight for a given point.
+    float lightSelectionProbability(const Light *light, const Point &origin) const;
+    /**
+     * @brief Samples a ray of light leaving one of the light sources, which are picked proportionally to their power
+     * (used to trace paths starting at the light sources, e.g., for photon mapping).
+     * @return The sampled ray, whose weight includes the probability of having picked its light source.
+     */
+    EmissionSample sampleEmission(Sampler &rng) const;
+    /// @brief Returns the probability of @ref sampleEmission picking a given light source to emit light from.
+    float emissionProbability(const Light *light) const;
     /// @brief Returns the bounding box of the scene geometry.
     Bounds getBoundingBox() const;
 };
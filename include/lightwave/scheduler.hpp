@@ -0,0 +1,104 @@
+/**
+ * @file scheduler.hpp
+ * @brief Contains the TileScheduler, which distributes the tiles of an image to
+ * worker threads.
+ */
+
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/math.hpp>
+
+#include <deque>
+#include <vector>
+
+namespace lightwave {
+
+/**
+ * @brief Hands out the tiles of an image to worker threads, splitting
+ * expensive tiles when the queue runs dry.
+ *
+ * Tiles are handed out in the spiral order of @ref BlockSpiral . The image is
+ * additionally divided into a grid of small cells, for which an estimate of the
+ * render cost can be supplied (e.g., from a quick probe pass via
+ * @ref setCellCost ). Once fewer tiles than twice the number of worker threads
+ * remain, the most expensive remaining tile is split into quadrants (down to
+ * the size of a cell). This avoids the long tail at the end of a frame where
+ * a single expensive tile keeps one core busy while all others sit idle.
+ *
+ * @note The iterator interface is meant to be used with
+ * @ref for_each_parallel , which serializes access to it.
+ */
+class TileScheduler {
+    struct Tile {
+        Bounds2i bounds;
+        float cost;
+    };
+
+public:
+    struct iterator {
+        Bounds2i operator*() const { return m_scheduler->m_queue.front().bounds; }
+        bool operator!=(const iterator &other) const { return atEnd() != other.atEnd(); }
+        iterator &operator++() {
+            m_scheduler->pop();
+            return *this;
+        }
+
+    private:
+        friend class TileScheduler;
+        iterator(TileScheduler *scheduler) : m_scheduler(scheduler) {}
+        bool atEnd() const { return !m_scheduler || m_scheduler->m_queue.empty(); }
+        TileScheduler *m_scheduler;
+    };
+
+    /**
+     * @brief Creates a scheduler for an image of the given resolution.
+     * @param tileSize The edge length of tiles before splitting.
+     * @param cellSize The edge length of cells used for cost estimation, which
+     * is also the smallest size tiles will be split into.
+     */
+    TileScheduler(const Vector2i &resolution, int tileSize = 64, int cellSize = 16);
+
+    /// @brief The number of cells used for cost estimation.
+    int cellCount() const { return int(m_cellCost.size()); }
+    /// @brief The pixel bounds of a given cell.
+    Bounds2i cellBounds(int cell) const;
+    /// @brief Sets the estimated render cost (e.g., in seconds per pixel) of a
+    /// cell. Cells without estimate are assumed to be equally expensive.
+    void setCellCost(int cell, float costPerPixel) { m_cellCost[cell] = costPerPixel; }
+
+    /// @brief Queues all tiles of the image again (e.g., for the next pass of a
+    /// progressive render), keeping the cell costs.
+    void restart() { restart(Bounds2i(Vector2i(0), m_resolution)); }
+    /// @brief Queues the tiles of the image again, clipped to a given region.
+    void restart(const Bounds2i &region);
+
+    /// @brief The number of tiles that have not been handed out yet.
+    int remaining() const { return int(m_queue.size()); }
+
+    /// @brief Starts handing out tiles, cell costs must be set before calling this.
+    iterator begin() {
+        balance();
+        return { this };
+    }
+    iterator end() { return { nullptr }; }
+
+private:
+    /// @brief Estimates the cost of a region from the costs of the cells it overlaps.
+    float cost(const Bounds2i &bounds) const;
+    /// @brief Removes the front tile from the queue.
+    void pop();
+    /// @brief Splits the most expensive tiles while only few tiles remain.
+    void balance();
+
+    Vector2i m_resolution;
+    int m_tileSize;
+    int m_cellSize;
+    Vector2i m_cellCount;
+    std::vector<float> m_cellCost;
+    std::deque<Tile> m_queue;
+    /// @brief Whether the costs of the queued tiles are up to date.
+    bool m_costsValid = false;
+};
+
+}
@@ -29,6 +29,17 @@ struct AreaSample : public SurfaceEvent {
     }
 };
 
+/// @brief A point at which a ray crosses the boundary of an instance that contains a medium (see
+/// @ref Scene::intersectCrossings ).
+struct MediumCrossing {
+    /// @brief The instance whose boundary is crossed.
+    const Instance *instance;
+    /// @brief The distance along the ray at which the boundary is crossed.
+    float t;
+    /// @brief Whether the ray enters the instance (as opposed to leaving it).
+    bool entering;
+};
+
 /// @brief A shape represents a geometrical object that can be intersected by rays.
 class Shape : public Object {
 public:
@@ -37,6 +48,19 @@ public:
      * @note Intersections farther away than the previous value of @c its.t will be dismissed.
      */
     virtual bool intersect(const Ray &ray, Intersection &its, Sampler &rng) const = 0;
+    /**
+     * @brief Finds all crossings of a ray with the boundaries of media (i.e., instances without BSDF that contain a
+     * medium) up to a given distance, in a single traversal of the shape.
+     * @param crossings The list the crossings are appended to, in no particular order.
+     * @return False if the ray is blocked by any other surface before the maximal distance, in which case the
+     * traversal ends early and the crossings are incomplete.
+     * @note Shapes that are not made of instances are opaque.
+     */
+    virtual bool intersectCrossings(const Ray &ray, float tMax, std::vector<MediumCrossing> &crossings,
+                                    Sampler &rng) const {
+        Intersection its(-ray.direction, tMax);
+        return !intersect(ray, its, rng);
+    }
     /// @brief Returns a bounding box that tightly encapsulates the shape. 
     virtual Bounds getBoundingBox() const = 0;
     /**
@@ -50,6 +74,23 @@ public:
     virtual AreaSample sampleArea(Sampler &rng) const {
         NOT_IMPLEMENTED
     }
+    /**
+     * @brief Samples a random point on the surface of this shape that is to illuminate a given point (both in object
+     * coordinates), preferably proportionally to the solid angle the shape covers when seen from that point.
+     * @note The density of the sample is still given with respect to area. Shapes that cannot sample by solid angle
+     * fall back to @ref sampleArea .
+     */
+    virtual AreaSample sampleAreaFrom(const Point &origin, Sampler &rng) const {
+        return sampleArea(rng);
+    }
+    /**
+     * @brief Returns the density of @ref sampleAreaFrom sampling a given point on the surface (both in object
+     * coordinates), relative to the density of @ref sampleArea (which @ref intersect reports for that point).
+     * @note As transforms change both densities by the same factor, the ratio also holds in world coordinates.
+     */
+    virtual float pdfRatioFrom(const Point &origin, const Point &position) const {
+        return 1;
+    }
 
     /**
      * @brief Marks that the shape is part of the scene geometry, i.e., can be hit through @ref Scene::intersect .
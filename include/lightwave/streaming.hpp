@@ -20,7 +20,12 @@ class Streaming {
 
     const std::vector<std::string> m_channels = { "r", "g", "b" };
     const Image &m_image;
+    /// @brief The identifier of the image in tev.
+    const std::string m_id;
     std::mutex m_mutex;
+    /// @brief The buffer into which the channels of a block are copied before sending them, which is reused across
+    /// blocks to avoid allocations.
+    std::vector<float> m_blockData;
     float m_normalization = 1;
 
     std::unique_ptr<Stream> m_stream;
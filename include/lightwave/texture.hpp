@@ -30,6 +30,11 @@ public:
         // we would ideally have a separate texture interface for scalar values)
         return evaluate(uv).r();
     }
+    /**
+     * @brief Returns the resolution at which the texture stores its values (e.g., the size of an image), which
+     * guides precomputations over the texture, or zero if the texture has no natural resolution.
+     */
+    virtual Point2i resolution() const { return Point2i(0); }
 };
 
 }
@@ -79,4 +79,19 @@ inline float cosineHemispherePdf(const Vector &vector) {
     return InvPi * std::max(vector.z(), float(0));
 }
 
+/**
+ * @brief Weights a sample drawn with density @c pdf against another sampling technique that could have produced the
+ * same sample with density @c otherPdf (multiple importance sampling using the power heuristic). Samples from Dirac
+ * delta distributions (i.e., infinite density) cannot be produced by other techniques and receive the full weight.
+ */
+inline float powerHeuristic(float pdf, float otherPdf) {
+    if (pdf <= 0)
+        return 0;
+    if (std::isinf(pdf))
+        return 1;
+    // computed from the ratio of the densities to avoid overflowing for very peaked distributions
+    const float ratio = otherPdf / pdf;
+    return 1 / (1 + ratio * ratio);
+}
+
 }
@@ -26,7 +26,8 @@ public:
 
         return BsdfSample{
             .wi = wi,
-            .weight = weight
+            .weight = weight,
+            .pdf = Infinity,
         };
     }
 
@@ -58,12 +58,14 @@ public:
         if (rng.next() < fresnel) {
             return BsdfSample{
                 .wi = vecReflected,
-                .weight = this->m_reflectance->evaluate(uv)
+                .weight = this->m_reflectance->evaluate(uv),
+                .pdf = Infinity,
             };
         } else {
             return BsdfSample{
                 .wi = vecRefracted,
-                .weight = this->m_transmittance->evaluate(uv) / sqr(eta)
+                .weight = this->m_transmittance->evaluate(uv) / sqr(eta),
+                .pdf = Infinity,
             };
         }
     }
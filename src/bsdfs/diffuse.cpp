@@ -18,14 +18,17 @@ public:
 
         if (foreshortening < 0) {
             return BsdfEval{
-                .value = Color(0.f)
+                .value = Color(0.f),
+                .pdf = 0,
             }; 
         }
 
         const Color weight = (this->m_albedo->evaluate(uv) / Pi) * foreshortening;
 
         return BsdfEval{
-            .value = weight
+            .value = weight,
+            // sample only produces directions on the side of wo
+            .pdf = Frame::cosTheta(wo) >= 0 ? cosineHemispherePdf(wi) : 0,
         };
     }
 
@@ -43,7 +46,8 @@ public:
 
         return BsdfSample{
             .wi = wi,
-            .weight = weight
+            .weight = weight,
+            .pdf = cosineHemispherePdf(wi * sign(Frame::cosTheta(wo))),
         };
     }
 
@@ -57,6 +61,8 @@ public:
     Color getAlbedo(const Point2 &uv) const override {
         return m_albedo->evaluate(uv);
     }
+
+    bool isDiffuse() const override { return true; }
 };
 
 } // namespace lightwave
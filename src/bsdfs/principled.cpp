@@ -8,12 +8,20 @@ namespace lightwave {
 struct DiffuseLobe {
     Color color;
 
+    /// @brief The probability density of @ref sample sampling @c wi (directions on the side of @c wo ).
+    float pdf(const Vector &wo, const Vector &wi) const {
+        if (Frame::cosTheta(wo) * Frame::cosTheta(wi) <= 0)
+            return 0;
+        return InvPi * Frame::absCosTheta(wi);
+    }
+
     BsdfEval evaluate(const Vector &wo, const Vector &wi) const {
         const float foreshortening = Frame::cosTheta(wi);
         const Color weight = (this->color / Pi) * foreshortening;
 
         return BsdfEval{
-            .value = weight
+            .value = weight,
+            .pdf = pdf(wo, wi),
         };
 
         // hints:
@@ -26,7 +34,8 @@ struct DiffuseLobe {
 
         return BsdfSample{
             .wi = wi,
-            .weight = this->color
+            .weight = this->color,
+            .pdf = pdf(wo, wi),
         };
 
         // hints:
@@ -39,6 +48,12 @@ struct MetallicLobe {
     float alpha;
     Color color;
 
+    /// @brief The probability density of @ref sample sampling @c wi .
+    float pdf(const Vector &wo, const Vector &wi) const {
+        const Vector halfvector = (wo + wi).normalized();
+        return microfacet::pdfGGXVNDF(this->alpha, halfvector, wo) * microfacet::detReflection(halfvector, wo);
+    }
+
     BsdfEval evaluate(const Vector &wo, const Vector &wi) const {
         Vector halfvector = (wo + wi).normalized();
   
@@ -50,7 +65,8 @@ struct MetallicLobe {
         float denominator = 4*Frame::absCosTheta(wo);
         
         return BsdfEval{
-            .value = (numerator/denominator)
+            .value = (numerator/denominator),
+            .pdf = pdf(wo, wi),
         };
         // hints:
         // * copy your roughconductor bsdf evaluate here
@@ -70,6 +86,7 @@ struct MetallicLobe {
         return BsdfSample{
             .wi = wi,
             .weight = weight,
+            .pdf = pdf(wo, wi),
         };
         // hints:
         // * copy your roughconductor bsdf sample here
@@ -89,6 +106,13 @@ class Principled : public Bsdf {
         float diffuseSelectionProb;
         DiffuseLobe diffuse;
         MetallicLobe metallic;
+
+        /// @brief The probability density of sampling @c wi with either lobe, weighted by their selection
+        /// probabilities.
+        float pdf(const Vector &wo, const Vector &wi) const {
+            return diffuseSelectionProb * diffuse.pdf(wo, wi) +
+                   (1 - diffuseSelectionProb) * metallic.pdf(wo, wi);
+        }
     };
 
     Combination combine(const Point2 &uv, const Vector &wo) const {
@@ -134,7 +158,8 @@ public:
         Color metallicWeight = combination.metallic.evaluate(wo, wi).value;
         
         return BsdfEval{
-            .value = diffuseWeight + metallicWeight
+            .value = diffuseWeight + metallicWeight,
+            .pdf = combination.pdf(wo, wi),
         };
         // hint: evaluate `combination.diffuse` and `combination.metallic` and
         // combine their results
@@ -149,13 +174,15 @@ public:
             BsdfSample diffuseSample = combination.diffuse.sample(wo, rng);
             return BsdfSample{
                 .wi = diffuseSample.wi,
-                .weight = diffuseSample.weight / combination.diffuseSelectionProb
+                .weight = diffuseSample.weight / combination.diffuseSelectionProb,
+                .pdf = combination.pdf(wo, diffuseSample.wi),
             };
         } else {
             BsdfSample metallicSample = combination.metallic.sample(wo, rng);
             return BsdfSample{
                 .wi = metallicSample.wi,
-                .weight = metallicSample.weight / (1-combination.diffuseSelectionProb)
+                .weight = metallicSample.weight / (1-combination.diffuseSelectionProb),
+                .pdf = combination.pdf(wo, metallicSample.wi),
             };
         }
         // hint: sample either `combination.diffuse` (probability
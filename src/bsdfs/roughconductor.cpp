@@ -33,7 +33,8 @@ public:
         const Color weight = (a / b);
         
         return BsdfEval{
-            .value = weight
+            .value = weight,
+            .pdf = microfacet::pdfGGXVNDF(alpha, n, wo) * microfacet::detReflection(n, wo),
         };
 
         // hints:
@@ -56,7 +57,8 @@ public:
 
         return BsdfSample{
             .wi = wi,
-            .weight = weight
+            .weight = weight,
+            .pdf = microfacet::pdfGGXVNDF(alpha, n, wo) * microfacet::detReflection(n, wo),
         };
 
         // hints:
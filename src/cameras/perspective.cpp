@@ -15,6 +15,16 @@ private:
     float lengthOfImagePlaneX;
     float lengthOfImagePlaneY;
 
+    /**
+     * @brief Returns the density (in solid angle) of sampling a direction with a given cosine to the viewing
+     * direction, as positions on the image plane are sampled uniformly and the area of the plane seen under a solid
+     * angle grows with the inverse cube of the cosine.
+     */
+    float directionDensity(float cosTheta) const {
+        const float imagePlaneArea = 4 * lengthOfImagePlaneX * lengthOfImagePlaneY;
+        return 1 / (imagePlaneArea * cosTheta * sqr(cosTheta));
+    }
+
 public:
     Perspective(const Properties &properties)
     : Camera(properties) {
@@ -72,6 +82,44 @@ public:
         // * use m_transform to transform the local camera coordinate system into the world coordinate system
     }
 
+    CameraConnection connect(const Point &point) const override {
+        const Point origin = m_transform->apply(Point(0));
+        const Vector direction = point - origin;
+        const float distance = direction.length();
+
+        // find the position on the image plane (at distance one in local coordinates) the point projects to
+        const Vector local = m_transform->inverse(direction);
+        if (!(local.z() > 0) || !(distance > 0)) {
+            return CameraConnection::invalid();
+        }
+        const Point2 normalized(local.x() / (local.z() * lengthOfImagePlaneX),
+                                local.y() / (local.z() * lengthOfImagePlaneY));
+        if (std::abs(normalized.x()) > 1 || std::abs(normalized.y()) > 1) {
+            return CameraConnection::invalid();
+        }
+
+        // the importance equals the density of sampling the direction, divided by the cosine to the viewing direction
+        const float cosTheta = local.z() / local.length();
+        const float importance = directionDensity(cosTheta) / cosTheta;
+        return CameraConnection{
+            .pixel = Point2((normalized.x() + 1) / 2 * m_resolution.x(), (normalized.y() + 1) / 2 * m_resolution.y()),
+            .wi = -direction / distance,
+            .distance = distance,
+            .weight = Color(importance * cosTheta / sqr(distance)),
+        };
+    }
+
+    float pdfDirection(const Vector &direction) const override {
+        const Vector local = m_transform->inverse(direction);
+        if (!(local.z() > 0) || std::abs(local.x()) > local.z() * lengthOfImagePlaneX ||
+            std::abs(local.y()) > local.z() * lengthOfImagePlaneY) {
+            return 0;
+        }
+        return directionDensity(local.z() / local.length());
+    }
+
+    bool canBeConnected() const override { return true; }
+
     std::string toString() const override {
         return tfm::format(
             "Perspective[\n"
@@ -0,0 +1,44 @@
+#include <lightwave/alias.hpp>
+
+#include <numeric>
+
+namespace lightwave {
+
+AliasTable::AliasTable(std::span<const float> weights) : m_bins(weights.size()) {
+    if (weights.empty())
+        return;
+
+    const double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+    const int n = int(weights.size());
+    for (int i = 0; i < n; i++) {
+        m_bins[i].pmf = total > 0 ? float(weights[i] / total) : float(1) / n;
+        m_bins[i].alias = i;
+    }
+
+    // split the bins into those with less and more than their fair share, and fill each under-full bin with the
+    // remainder of an over-full bin (computed in double precision to avoid drift over many bins)
+    std::vector<std::pair<int, double>> under, over;
+    for (int i = 0; i < n; i++) {
+        const double scaled = double(m_bins[i].pmf) * n;
+        (scaled < 1 ? under : over).emplace_back(i, scaled);
+    }
+    while (!under.empty() && !over.empty()) {
+        const auto [small, smallScaled] = under.back();
+        under.pop_back();
+        auto [large, largeScaled] = over.back();
+        over.pop_back();
+
+        m_bins[small].threshold = float(smallScaled);
+        m_bins[small].alias = large;
+
+        largeScaled -= 1 - smallScaled;
+        (largeScaled < 1 ? under : over).emplace_back(large, largeScaled);
+    }
+    // the remaining bins are full up to rounding errors
+    for (const auto &[index, scaled] : under)
+        m_bins[index].threshold = 1;
+    for (const auto &[index, scaled] : over)
+        m_bins[index].threshold = 1;
+}
+
+}
@@ -0,0 +1,80 @@
+#include <lightwave/allocations.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef LW_COUNT_ALLOCATIONS
+
+namespace lightwave {
+
+static std::atomic<int64_t> s_allocationCount = 0;
+static std::atomic<int64_t> s_allocatedBytes = 0;
+static thread_local int64_t s_threadAllocationCount = 0;
+
+/// @brief Counts an allocation and performs it with the C allocator.
+static void *countedAllocate(std::size_t size, std::size_t alignment = 0) {
+    s_allocationCount.fetch_add(1, std::memory_order_relaxed);
+    s_allocatedBytes.fetch_add(int64_t(size), std::memory_order_relaxed);
+    s_threadAllocationCount++;
+
+    if (size == 0)
+        size = 1;
+#ifdef LW_OS_WINDOWS
+    void *ptr = alignment ? _aligned_malloc(size, alignment) : std::malloc(size);
+#else
+    // aligned_alloc requires the size to be a multiple of the alignment
+    void *ptr = alignment ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+                          : std::malloc(size);
+#endif
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+static void countedFree(void *ptr, bool aligned = false) {
+#ifdef LW_OS_WINDOWS
+    if (aligned) {
+        _aligned_free(ptr);
+        return;
+    }
+#endif
+    std::free(ptr);
+}
+
+int64_t allocationCount() { return s_allocationCount.load(std::memory_order_relaxed); }
+int64_t allocatedBytes() { return s_allocatedBytes.load(std::memory_order_relaxed); }
+int64_t threadAllocationCount() { return s_threadAllocationCount; }
+
+}
+
+// replacements of the global allocation functions, the remaining variants (e.g., arrays and nothrow) are implemented
+// by the standard library in terms of these
+void *operator new(std::size_t size) { return lightwave::countedAllocate(size); }
+void *operator new[](std::size_t size) { return lightwave::countedAllocate(size); }
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    return lightwave::countedAllocate(size, std::size_t(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+    return lightwave::countedAllocate(size, std::size_t(alignment));
+}
+void operator delete(void *ptr) noexcept { lightwave::countedFree(ptr); }
+void operator delete[](void *ptr) noexcept { lightwave::countedFree(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { lightwave::countedFree(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { lightwave::countedFree(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { lightwave::countedFree(ptr, true); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { lightwave::countedFree(ptr, true); }
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept { lightwave::countedFree(ptr, true); }
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept { lightwave::countedFree(ptr, true); }
+
+#else
+
+namespace lightwave {
+
+int64_t allocationCount() { return 0; }
+int64_t allocatedBytes() { return 0; }
+int64_t threadAllocationCount() { return 0; }
+
+}
+
+#endif
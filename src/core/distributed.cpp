@@ -0,0 +1,240 @@
+#include <lightwave/distributed.hpp>
+#include <lightwave/iterators.hpp>
+#include <lightwave/logger.hpp>
+
+#include <deque>
+#include <sstream>
+#include <vector>
+
+#ifndef LW_OS_WINDOWS
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+namespace lightwave {
+
+#ifndef LW_OS_WINDOWS
+
+/// @brief Builds the address of a Unix socket at the given path.
+static sockaddr_un socketAddress(const std::filesystem::path &path) {
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    const std::string name = path.string();
+    if (name.size() >= sizeof(address.sun_path)) {
+        lightwave_throw("socket path %s is too long", path);
+    }
+    std::copy(name.begin(), name.end(), address.sun_path);
+    return address;
+}
+
+CoordinatorClient::CoordinatorClient(const std::filesystem::path &socketPath) {
+    const sockaddr_un address = socketAddress(socketPath);
+    m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_socket < 0 || connect(m_socket, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0) {
+        lightwave_throw("could not connect to coordinator at %s", socketPath);
+    }
+}
+
+CoordinatorClient::~CoordinatorClient() {
+    if (m_socket >= 0)
+        close(m_socket);
+}
+
+void CoordinatorClient::send(const std::string &message) {
+    const std::string line = message + "\n";
+    for (size_t offset = 0; offset < line.size();) {
+        const ssize_t written = ::send(m_socket, line.data() + offset, line.size() - offset, MSG_NOSIGNAL);
+        if (written <= 0) {
+            lightwave_throw("lost connection to coordinator");
+        }
+        offset += written;
+    }
+}
+
+std::string CoordinatorClient::receive() {
+    std::string line;
+    char c;
+    while (true) {
+        if (read(m_socket, &c, 1) != 1) {
+            lightwave_throw("lost connection to coordinator");
+        }
+        if (c == '\n')
+            return line;
+        line += c;
+    }
+}
+
+bool CoordinatorClient::request(const Vector2i &resolution, int samplesPerPixel, WorkUnit &unit) {
+    send(tfm::format("request %d %d %d", resolution.x(), resolution.y(), samplesPerPixel));
+
+    std::istringstream reply { receive() };
+    std::string command;
+    reply >> command;
+    if (command == "done")
+        return false;
+    if (command != "work") {
+        lightwave_throw("coordinator refused request: %s", reply.str());
+    }
+
+    Point2i min, max;
+    reply >> min.x() >> min.y() >> max.x() >> max.y() >> unit.sampleStart >> unit.sampleEnd;
+    unit.region = Bounds2i(min, max);
+    return true;
+}
+
+void CoordinatorClient::finish() {
+    send("finish");
+    receive();
+}
+
+int runCoordinator(const std::filesystem::path &socketPath, int tileSize, int sampleChunk) {
+    /// @brief The state of a connected rendering process.
+    struct Client {
+        int socket;
+        std::string buffer;
+        /// @brief The units handed out to this client, which are handed out again if the client disconnects
+        /// without storing its results.
+        std::vector<WorkUnit> units;
+    };
+
+    std::deque<WorkUnit> pending;
+    Vector2i resolution;
+    int samplesPerPixel = 0;
+    int totalUnits = 0, completedUnits = 0;
+    std::vector<Client> clients;
+
+    std::filesystem::remove(socketPath);
+    const sockaddr_un address = socketAddress(socketPath);
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(listener, 64) != 0) {
+        logger(EError, "could not listen on %s", socketPath);
+        return 1;
+    }
+    logger(EInfo, "coordinator listening on %s", socketPath);
+
+    const auto handle = [&](Client &client, const std::string &line) {
+        std::istringstream message { line };
+        std::string command;
+        message >> command;
+
+        std::string reply;
+        if (command == "request") {
+            Vector2i requestedResolution;
+            int requestedSamples;
+            message >> requestedResolution.x() >> requestedResolution.y() >> requestedSamples;
+
+            if (samplesPerPixel == 0) {
+                // the first request defines the job
+                resolution = requestedResolution;
+                samplesPerPixel = requestedSamples;
+                for (int sample = 0; sample < samplesPerPixel; sample += sampleChunk) {
+                    for (auto tile : BlockSpiral(resolution, Vector2i(tileSize)))
+                        pending.push_back({ tile, sample, std::min(sample + sampleChunk, samplesPerPixel) });
+                }
+                totalUnits = int(pending.size());
+                logger(EInfo, "distributing %dx%d pixels at %d samples in %d units", resolution.x(),
+                       resolution.y(), samplesPerPixel, totalUnits);
+            }
+
+            if (requestedResolution != resolution || requestedSamples != samplesPerPixel) {
+                reply = "error mismatching resolution or sample count";
+            } else if (pending.empty()) {
+                reply = "done";
+            } else {
+                const WorkUnit unit = pending.front();
+                pending.pop_front();
+                client.units.push_back(unit);
+                reply = tfm::format("work %d %d %d %d %d %d", unit.region.min().x(), unit.region.min().y(),
+                                    unit.region.max().x(), unit.region.max().y(), unit.sampleStart,
+                                    unit.sampleEnd);
+            }
+        } else if (command == "finish") {
+            completedUnits += int(client.units.size());
+            client.units.clear();
+            logger(EInfo, "%d of %d units stored", completedUnits, totalUnits);
+            reply = "ok";
+        } else {
+            reply = "error unknown command";
+        }
+
+        reply += "\n";
+        return ::send(client.socket, reply.data(), reply.size(), MSG_NOSIGNAL) == ssize_t(reply.size());
+    };
+
+    while (samplesPerPixel == 0 || completedUnits < totalUnits) {
+        std::vector<pollfd> descriptors { { listener, POLLIN, 0 } };
+        for (const auto &client : clients)
+            descriptors.push_back({ client.socket, POLLIN, 0 });
+        if (poll(descriptors.data(), descriptors.size(), -1) < 0)
+            continue;
+
+        if (descriptors[0].revents & POLLIN) {
+            const int socket = accept(listener, nullptr, nullptr);
+            if (socket >= 0)
+                clients.push_back({ socket, "", {} });
+        }
+
+        for (size_t i = 1; i < descriptors.size(); i++) {
+            if (!descriptors[i].revents)
+                continue;
+            Client &client = clients[i - 1];
+
+            char data[256];
+            const ssize_t size = read(client.socket, data, sizeof(data));
+            bool connected = size > 0;
+            client.buffer.append(data, std::max(size, ssize_t(0)));
+
+            for (size_t end; connected && (end = client.buffer.find('\n')) != std::string::npos;) {
+                connected = handle(client, client.buffer.substr(0, end));
+                client.buffer.erase(0, end + 1);
+            }
+
+            if (!connected) {
+                if (!client.units.empty()) {
+                    logger(EWarn, "a client disconnected before storing its results, handing out its %d units again",
+                           client.units.size());
+                    pending.insert(pending.begin(), client.units.begin(), client.units.end());
+                    client.units.clear();
+                }
+                close(client.socket);
+                client.socket = -1;
+            }
+        }
+
+        std::erase_if(clients, [](const Client &client) { return client.socket < 0; });
+    }
+
+    for (const auto &client : clients)
+        close(client.socket);
+    close(listener);
+    std::filesystem::remove(socketPath);
+    logger(EInfo, "all units have been rendered");
+    return 0;
+}
+
+#else
+
+CoordinatorClient::CoordinatorClient(const std::filesystem::path &socketPath) {
+    lightwave_throw("distributed rendering is not supported on this platform");
+}
+CoordinatorClient::~CoordinatorClient() {}
+void CoordinatorClient::send(const std::string &message) {}
+std::string CoordinatorClient::receive() { return ""; }
+bool CoordinatorClient::request(const Vector2i &resolution, int samplesPerPixel, WorkUnit &unit) { return false; }
+void CoordinatorClient::finish() {}
+
+int runCoordinator(const std::filesystem::path &socketPath, int tileSize, int sampleChunk) {
+    logger(EError, "distributed rendering is not supported on this platform");
+    return 1;
+}
+
+#endif
+
+}
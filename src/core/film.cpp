@@ -0,0 +1,97 @@
+#include <lightwave/film.hpp>
+
+#include <miniz.h>
+
+#include <cstring>
+#include <fstream>
+
+namespace lightwave {
+
+/// @brief The header of a film file, which is followed by the compressed pixel states.
+struct FilmHeader {
+    char magic[4] = { 'L', 'W', 'F', 'M' };
+    uint32_t version = 1;
+    int32_t width = 0;
+    int32_t height = 0;
+    float elapsedTime = 0;
+    uint32_t pixelSize = sizeof(Film::Pixel);
+    uint64_t compressedSize = 0;
+};
+
+void Film::save(const std::filesystem::path &path, float elapsedTime) const {
+    std::vector<Pixel> snapshot;
+    {
+        std::unique_lock lock { m_snapshotMutex };
+        snapshot.assign(m_pixels.begin(), m_pixels.end());
+    }
+
+    const auto *source = reinterpret_cast<const unsigned char *>(snapshot.data());
+    const mz_ulong sourceSize = snapshot.size() * sizeof(Pixel);
+    mz_ulong compressedSize = mz_compressBound(sourceSize);
+    std::vector<unsigned char> compressed(compressedSize);
+    if (mz_compress2(compressed.data(), &compressedSize, source, sourceSize, MZ_BEST_SPEED) != MZ_OK) {
+        logger(EError, "could not compress film for %s", path);
+        return;
+    }
+
+    FilmHeader header;
+    header.width = m_resolution.x();
+    header.height = m_resolution.y();
+    header.elapsedTime = elapsedTime;
+    header.compressedSize = compressedSize;
+
+    auto temporaryPath = path;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file { temporaryPath, std::ios::binary };
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(compressed.data()), compressedSize);
+        if (!file) {
+            logger(EError, "could not write film to %s", temporaryPath);
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        logger(EError, "could not move film to %s: %s", path, error.message());
+    }
+}
+
+float Film::load(const std::filesystem::path &path) {
+    std::ifstream file { path, std::ios::binary };
+    if (!file) {
+        lightwave_throw("could not open film %s", path);
+    }
+
+    FilmHeader header, expected;
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!file || std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+        header.version != expected.version || header.pixelSize != expected.pixelSize) {
+        lightwave_throw("%s is not a compatible film file", path);
+    }
+    if (m_resolution.isZero()) {
+        initialize({ header.width, header.height });
+    } else if (header.width != m_resolution.x() || header.height != m_resolution.y()) {
+        lightwave_throw("film %s has resolution %dx%d, but %dx%d was expected", path, header.width, header.height,
+                        m_resolution.x(), m_resolution.y());
+    }
+
+    std::vector<unsigned char> compressed(header.compressedSize);
+    file.read(reinterpret_cast<char *>(compressed.data()), compressed.size());
+    if (!file) {
+        lightwave_throw("film %s is truncated", path);
+    }
+
+    mz_ulong size = m_pixels.size() * sizeof(Pixel);
+    if (mz_uncompress(reinterpret_cast<unsigned char *>(m_pixels.data()), &size, compressed.data(),
+                      compressed.size()) != MZ_OK ||
+        size != m_pixels.size() * sizeof(Pixel)) {
+        lightwave_throw("film %s is corrupt", path);
+    }
+
+    return header.elapsedTime;
+}
+
+} // namespace lightwave
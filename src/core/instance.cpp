@@ -15,6 +15,11 @@ void Instance::transformFrame(SurfaceEvent &surf) const {
 
     surf.position = this->m_transform->apply(surf.position);
 
+    // convert the area density from object to world coordinates, using a frame built from the normal of the shape, as
+    // some shapes provide degenerate tangents (e.g., at the poles of spheres)
+    const Frame localFrame(surf.frame.normal);
+    surf.pdf /= this->m_transform->apply(localFrame.tangent).cross(this->m_transform->apply(localFrame.bitangent)).length();
+
     // Apply normal map if requested
     if (this->m_normal != nullptr) {
         // Read normal vector from normal map texture
@@ -77,6 +82,9 @@ bool Instance::intersect(const Ray &worldRay, Intersection &its, Sampler &rng) c
     // so that comparison in shape intersect methods works as expected
     if (its) {
         its.t = (localRay.origin - this->m_transform->inverse(its.position)).length();
+    } else if (its.t < Infinity) {
+        // the same holds for the maximal distance of rays without previous hit (e.g., shadow rays)
+        its.t = (localRay.origin - this->m_transform->inverse(worldRay(its.t))).length();
     }
 
     const bool wasIntersected = m_shape->intersect(localRay, its, rng);
@@ -118,6 +126,33 @@ bool Instance::intersect(const Ray &worldRay, Intersection &its, Sampler &rng) c
     }
 }
 
+bool Instance::intersectCrossings(const Ray &ray, float tMax, std::vector<MediumCrossing> &crossings,
+                                  Sampler &rng) const {
+    // only boundaries of media let rays pass (portals are opaque, as rays continue elsewhere behind them)
+    if (m_bsdf || !m_medium || m_link) {
+        Intersection its(-ray.direction, tMax);
+        return !intersect(ray, its, rng);
+    }
+
+    // the crossings with the boundary are found by intersecting only this instance repeatedly
+    Ray currentRay = ray;
+    float t = 0;
+    while (true) {
+        Intersection its(-currentRay.direction, tMax - t);
+        if (!intersect(currentRay, its, rng) || !(its.t > 0)) {
+            return true;
+        }
+
+        t += its.t;
+        crossings.push_back({
+            .instance = this,
+            .t = t,
+            .entering = its.frame.normal.dot(currentRay.direction) < 0,
+        });
+        currentRay = Ray(its.position, currentRay.direction, currentRay.depth);
+    }
+}
+
 Bounds Instance::getBoundingBox() const {
     if (!m_transform) {
         // fast path
@@ -152,8 +187,10 @@ Point Instance::getCentroid() const {
     return m_transform->apply(m_shape->getCentroid());
 }
 
-AreaSample Instance::sampleArea(Sampler &rng) const {
-    AreaSample sample = m_shape->sampleArea(rng);
+void Instance::transformSample(AreaSample &sample) const {
+    if (!m_transform) {
+        return;
+    }
 
     // calculate how the area changes
     Vector tangent = m_transform->apply(sample.frame.tangent);
@@ -163,9 +200,27 @@ AreaSample Instance::sampleArea(Sampler &rng) const {
     // scale the 
     sample.area *= crossProductLength;
     transformFrame(sample);
+}
+
+AreaSample Instance::sampleArea(Sampler &rng) const {
+    AreaSample sample = m_shape->sampleArea(rng);
+    transformSample(sample);
+    return sample;
+}
+
+AreaSample Instance::sampleAreaFrom(const Point &origin, Sampler &rng) const {
+    AreaSample sample = m_shape->sampleAreaFrom(m_transform ? m_transform->inverse(origin) : origin, rng);
+    transformSample(sample);
     return sample;
 }
 
+float Instance::pdfRatioFrom(const Point &origin, const Point &position) const {
+    if (!m_transform) {
+        return m_shape->pdfRatioFrom(origin, position);
+    }
+    return m_shape->pdfRatioFrom(m_transform->inverse(origin), m_transform->inverse(position));
+}
+
 }
 
 REGISTER_CLASS(Instance, "instance", "default")
\ No newline at end of file
@@ -1,9 +1,13 @@
 #include <lightwave/integrator.hpp>
+#include <lightwave/allocations.hpp>
 #include <lightwave/camera.hpp>
+#include <lightwave/distributed.hpp>
 #include <lightwave/parallel.hpp>
+#include <lightwave/scheduler.hpp>
 
 #include <algorithm>
 #include <chrono>
+#include <optional>
 
 #include <lightwave/streaming.hpp>
 #include <lightwave/iterators.hpp>
@@ -14,6 +18,41 @@ namespace lightwave {
 t_debugPixel debugPixel;
 #endif
 
+RenderSettings renderSettings;
+
+/**
+ * @brief The state of a worker thread, which is reused across tiles so that rendering performs no heap allocations
+ * once all buffers have reached their final size.
+ */
+struct WorkerState {
+    /// @brief The sampler used by this thread.
+    ref<Sampler> sampler;
+    /// @brief The states of the pixels of the current tile that receive samples.
+    std::vector<Film::Pixel> states;
+    /// @brief The positions of the pixels in @ref states .
+    std::vector<Point2i> statePixels;
+    /// @brief The samples of the current batch.
+    std::vector<PixelSample> batch;
+    /// @brief The index of the pixel state within @ref states that each sample of the batch belongs to.
+    std::vector<int> batchStates;
+    /// @brief The results of the samples of the batch.
+    std::vector<Color> results;
+};
+
+void SamplingIntegrator::estimate(std::span<const PixelSample> samples, std::span<Color> results, Sampler &rng) {
+    for (size_t i = 0; i < samples.size(); i++) {
+#ifdef DEBUG_PIXEL
+        if (debugPixel.active) {
+            debugPixel.sample = samples[i].sampleIndex;
+            logger(EDebug, "Debug Sample #%d:", debugPixel.sample);
+        }
+#endif
+        rng.seed(samples[i].pixel, samples[i].sampleIndex);
+        auto cameraSample = m_scene->camera()->sample(samples[i].pixel, rng);
+        results[i] = cameraSample.weight * Li(cameraSample.ray, rng);
+    }
+}
+
 void SamplingIntegrator::execute() {
     if (!m_image) {
         lightwave_throw("<integrator /> needs an <image /> child to render into!");
@@ -21,50 +60,286 @@ void SamplingIntegrator::execute() {
 
     const Vector2i resolution = m_scene->camera()->resolution();
     m_image->initialize(resolution);
+    m_film.initialize(resolution);
+
+    const int samplesPerPixel = m_sampler->samplesPerPixel();
+
+    // renders can be restricted to a region and a range of sample indices, or receive
+    // these from a coordinator, which allows splitting them across several processes
+    const bool distributed = !renderSettings.coordinator.empty();
+    const bool partial = distributed || !renderSettings.region.isEmpty() || renderSettings.sampleStart > 0 ||
+                         renderSettings.sampleEnd > 0;
+    const Bounds2i region = renderSettings.region.isEmpty() ? m_image->bounds()
+                                                            : m_image->bounds().clip(renderSettings.region);
+    const int firstSample = std::clamp(renderSettings.sampleStart, 0, samplesPerPixel);
+    const int lastSample = renderSettings.sampleEnd > 0 ? std::clamp(renderSettings.sampleEnd, firstSample, samplesPerPixel)
+                                                        : samplesPerPixel;
+
+    // adaptive sampling would take samples beyond the sample range, which other processes might already use
+    bool adaptive = m_adaptive;
+    if (adaptive && (distributed || firstSample > 0 || lastSample < samplesPerPixel)) {
+        logger(EWarn, "adaptive sampling is not supported when rendering sample ranges and will be disabled");
+        adaptive = false;
+    }
+
+    // continue from a previous checkpoint, which includes the time already spent rendering
+    const bool checkpointing = renderSettings.checkpointInterval > 0 && !distributed;
+    const auto filmPath = renderSettings.filmPath.empty() ? m_image->basePath() / (m_image->id() + ".film")
+                                                          : renderSettings.filmPath;
+    float resumedTime = 0;
+    if (renderSettings.resume && distributed) {
+        logger(EWarn, "renders distributed by a coordinator cannot be resumed");
+    } else if (renderSettings.resume) {
+        if (std::filesystem::exists(filmPath)) {
+            resumedTime = m_film.load(filmPath);
+            m_film.develop(*m_image, m_image->bounds());
+            logger(EInfo, "resuming from checkpoint %s with %.1f samples per pixel", filmPath,
+                   m_film.totalSamples() / float(region.diagonal().product()));
+        } else {
+            logger(EWarn, "no checkpoint to resume from at %s, starting from scratch", filmPath);
+        }
+    }
+
+    const auto startTime = std::chrono::steady_clock::now();
+    const auto elapsedTime = [&]() {
+        const std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - startTime;
+        return resumedTime + elapsed.count();
+    };
+    const auto budgetExceeded = [&]() {
+        return renderSettings.interrupted || (m_timeBudget > 0 && elapsedTime() >= m_timeBudget);
+    };
 
-    const float norm = 1.0f / m_sampler->samplesPerPixel();
-    
+    std::atomic<float> lastCheckpoint = elapsedTime();
+    std::atomic<bool> checkpointInProgress = false;
+    const auto checkpointIfDue = [&]() {
+        if (!checkpointing || elapsedTime() - lastCheckpoint < renderSettings.checkpointInterval)
+            return;
+        // only one thread writes the checkpoint, all others continue rendering
+        if (checkpointInProgress.exchange(true))
+            return;
+        m_film.save(filmPath, elapsedTime());
+        lastCheckpoint = elapsedTime();
+        checkpointInProgress = false;
+    };
+
+    std::vector<WorkerState> workers(threadCount());
+    for (auto &worker : workers) {
+        worker.sampler = m_sampler->clone();
+        worker.batch.reserve(m_batchSize);
+        worker.batchStates.reserve(m_batchSize);
+        worker.results.resize(m_batchSize);
+    }
+
+    // estimate the cost of each region of the image by timing a few samples,
+    // which allows the scheduler to split expensive tiles at the end of the frame
+    TileScheduler scheduler { resolution };
+    std::optional<AllocationPhase> allocations { "probing" };
+    m_previewing = true;
+    for_each_parallel(ChunkedRange(scheduler.cellCount(), 64), [&](const Range &cells) {
+        constexpr int ProbesPerCell = 4;
+        Sampler *sampler = workers[threadIndex()].sampler.get();
+        for (int cell : cells) {
+            const Bounds2i bounds = scheduler.cellBounds(cell);
+            if (region.clip(bounds).isEmpty())
+                continue;
+
+            const auto start = std::chrono::steady_clock::now();
+            for (int probe = 0; probe < ProbesPerCell; probe++) {
+                const Vector2i offset = bounds.diagonal() * Vector2i(2 * (probe % 2) + 1, 2 * (probe / 2) + 1) / 4;
+                const Point2i pixel = bounds.min() + offset;
+                sampler->seed(pixel, 0);
+                auto cameraSample = m_scene->camera()->sample(pixel, *sampler);
+                Li(cameraSample.ray, *sampler);
+            }
+            const std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+            scheduler.setCellCost(cell, elapsed.count() / ProbesPerCell);
+        }
+    });
+
+    allocations.emplace("rendering");
     Streaming stream { *m_image };
-    ProgressReporter progress { resolution.product() };
-    for_each_parallel(BlockSpiral(resolution, Vector2i(64)), [&](auto block) {
-        auto sampler = m_sampler->clone();
+    if (m_progressive) {
+        stream.startRegularUpdates();
+
+        if (m_previewScale > 1 && !partial) {
+            // quick preview at reduced resolution, which is overwritten by the first pass
+            for_each_parallel(BlockSpiral(resolution, Vector2i(64)), [&](auto block) {
+                Sampler *sampler = workers[threadIndex()].sampler.get();
+                for (int y = block.min().y(); y < block.max().y(); y += m_previewScale) {
+                    for (int x = block.min().x(); x < block.max().x(); x += m_previewScale) {
+                        const Bounds2i superPixel = block.clip(Bounds2i(
+                            Point2i(x, y), Point2i(x + m_previewScale, y + m_previewScale)));
+                        const Point2i pixel = superPixel.center();
+                        sampler->seed(pixel, 0);
+                        auto cameraSample = m_scene->camera()->sample(pixel, *sampler);
+                        const Color value = cameraSample.weight * Li(cameraSample.ray, *sampler);
+                        for (auto p : superPixel)
+                            m_image->get(p) = value;
+                    }
+                }
+            });
+        }
+    }
+    m_previewing = false;
+
+    // renders the sample indices [rangeStart, rangeEnd) of all pixels within a region into a film,
+    // where the sample counts stored in the film are relative to rangeStart
+    const auto renderRange = [&](Film &film, const Bounds2i &rangeRegion, int rangeStart, int rangeEnd) {
+        const int64_t regionPixels = rangeRegion.diagonal().product();
+
+        // the number of samples to take for each pixel in the current pass, where
+        // adaptive sampling first takes the minimum number of samples for every pixel
+        const bool renderInPasses = m_progressive || adaptive;
+        const int maxSamples = adaptive ? m_maxSamples : rangeEnd - rangeStart;
+        const int64_t sampleBudget = regionPixels * (rangeEnd - rangeStart);
+        int samplesInPass = !renderInPasses ? rangeEnd - rangeStart
+                            : adaptive      ? std::max(m_minSamples, m_samplesPerPass)
+                                            : m_samplesPerPass;
+
+        int64_t samplesBefore = 0;
+        for (auto pixel : rangeRegion)
+            samplesBefore += film(pixel).sampleCount;
+        ProgressReporter progress { sampleBudget };
+        progress += samplesBefore;
+        bool pixelsRemaining = true;
+        while (pixelsRemaining && progress.unitsCompleted() < sampleBudget && !budgetExceeded()) {
+            std::atomic<bool> samplesTaken = false;
+
+            scheduler.restart(rangeRegion);
+            for_each_parallel(scheduler.begin(), scheduler.end(), [&](auto block) {
+                if (budgetExceeded() || progress.unitsCompleted() >= sampleBudget)
+                    return;
+
+                auto &[sampler, states, statePixels, batch, batchStates, results] = workers[threadIndex()];
+                int64_t blockSamples = 0;
+
+                // the samples of the block are gathered into batches, where each entry refers to the state of its
+                // pixel, to which its result is added once the batch has been estimated
+                states.clear();
+                statePixels.clear();
+                const auto estimateBatch = [&]() {
+                    estimate(batch, std::span(results).first(batch.size()), *sampler);
+                    for (size_t i = 0; i < batch.size(); i++)
+                        states[batchStates[i]].add(results[i]);
+                    batch.clear();
+                    batchStates.clear();
+                };
+
+                for (auto pixel : MortonOrder(block)) {
+                    const Film::Pixel &state = film(pixel);
+                    const int countStart = state.sampleCount;
+                    if (adaptive && countStart >= m_minSamples && state.relativeError() < m_errorThreshold)
+                        continue;
+                    const int countEnd = std::min(countStart + samplesInPass, maxSamples);
 
 #ifdef DEBUG_PIXEL
-        debugPixel.active = false;
+                    if (pixel == DEBUG_PIXEL_POS)
+                        debugPixel.active = true;
 #endif
+                    DEBUG_PIXEL_LOG("Debug Pixel at %s:", DEBUG_PIXEL_POS);
+
+                    states.push_back(state);
+                    statePixels.push_back(pixel);
+                    for (int sample = rangeStart + countStart; sample < rangeStart + countEnd; sample++) {
+                        batch.push_back({ pixel, sample });
+                        batchStates.push_back(int(states.size()) - 1);
+                        if (int(batch.size()) == m_batchSize)
+                            estimateBatch();
+                    }
+                    blockSamples += std::max(countEnd - countStart, 0);
 
-        for (auto pixel : block) {
 #ifdef DEBUG_PIXEL
-            if (pixel == DEBUG_PIXEL_POS)
-                debugPixel.active = true;
+                    debugPixel.active = false;
 #endif
-            DEBUG_PIXEL_LOG("Debug Pixel at %s:", DEBUG_PIXEL_POS);
-            
-            Color sum;
-            for (int sample = 0; sample < m_sampler->samplesPerPixel(); sample++) {
-#ifdef DEBUG_PIXEL
-                if (debugPixel.active) {
-                    debugPixel.sample = sample;
-                    logger(EDebug, "Debug Sample #%d:", debugPixel.sample);
                 }
-#endif
-                sampler->seed(pixel, sample);
-                auto cameraSample = m_scene->camera()->sample(pixel, *sampler);
-                sum += cameraSample.weight * Li(cameraSample.ray, *sampler);
+                estimateBatch();
+
+                for (size_t i = 0; i < states.size(); i++)
+                    film.update(statePixels[i], states[i]);
+
+                if (blockSamples > 0) {
+                    samplesTaken = true;
+                    film.develop(*m_image, block);
+                    progress += blockSamples;
+                }
+                if (!m_progressive)
+                    stream.updateBlock(block);
+                checkpointIfDue();
+            });
+
+            pixelsRemaining = renderInPasses && samplesTaken;
+            samplesInPass = m_samplesPerPass;
+        }
+        progress.finish();
+
+        const float averageSamples = progress.unitsCompleted() / float(regionPixels);
+        if (renderSettings.interrupted) {
+            logger(EWarn, "render interrupted after %.1f of %d samples per pixel", averageSamples,
+                   rangeEnd - rangeStart);
+        } else if (budgetExceeded()) {
+            logger(EInfo, "time budget of %.1fs exhausted after %.1f of %d samples per pixel", m_timeBudget,
+                   averageSamples, rangeEnd - rangeStart);
+        }
+
+        if (adaptive) {
+            int minCount = maxSamples, maxCount = 0;
+            for (auto pixel : rangeRegion) {
+                minCount = std::min(minCount, film(pixel).sampleCount);
+                maxCount = std::max(maxCount, film(pixel).sampleCount);
             }
-            m_image->get(pixel) = norm * sum;
-            
-#ifdef DEBUG_PIXEL
-            debugPixel.active = false;
-#endif
+            logger(EInfo, "adaptive sampling took %d to %d samples per pixel (%.1f on average)", minCount,
+                   maxCount, averageSamples);
         }
+    };
 
-        progress += block.diagonal().product();
-        stream.updateBlock(block);
-    });
-    progress.finish();
+    if (distributed) {
+        // units are rendered separately and then merged, since their sample ranges differ
+        CoordinatorClient client { renderSettings.coordinator };
+        Film unitFilm;
+        unitFilm.initialize(resolution);
+
+        WorkUnit unit;
+        while (!renderSettings.interrupted && client.request(resolution, samplesPerPixel, unit)) {
+            logger(EInfo, "rendering samples %d to %d of region %s to %s", unit.sampleStart, unit.sampleEnd,
+                   unit.region.min(), unit.region.max());
+            unitFilm.clear(unit.region);
+            renderRange(unitFilm, unit.region, unit.sampleStart, unit.sampleEnd);
+            m_film.merge(unitFilm, unit.region);
+            m_film.develop(*m_image, unit.region);
+        }
+
+        // without storing the film, the coordinator hands out the units of this process again
+        if (!renderSettings.interrupted) {
+            logger(EInfo, "saving film %s", filmPath);
+            m_film.save(filmPath, elapsedTime());
+            client.finish();
+        }
+    } else {
+        renderRange(m_film, region, firstSample, lastSample);
+
+        if (checkpointing || partial) {
+            // the final film allows continuing the render later on (e.g., with a larger time budget) or merging it
+            // with the results of other processes
+            logger(EInfo, "saving film %s", filmPath);
+            m_film.save(filmPath, elapsedTime());
+        }
+    }
+
+    allocations.emplace("saving");
+    finishImage();
+    if (m_progressive) {
+        stream.stopRegularUpdates();
+        stream.update();
+    }
 
     m_image->save();
+
+    if (m_sampleCountImage) {
+        m_sampleCountImage->initialize(resolution);
+        for (auto pixel : m_image->bounds())
+            m_sampleCountImage->get(pixel) = Color(float(m_film(pixel).sampleCount));
+        m_sampleCountImage->save();
+    }
 }
 
 }
@@ -0,0 +1,263 @@
+#include "lightbvh.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+namespace lightwave {
+
+/// @brief Computes cos(a - b) from the sines and cosines of two angles, which is one if a is smaller than b.
+static float cosSubClamped(float sinA, float cosA, float sinB, float cosB) {
+    if (cosA > cosB)
+        return 1;
+    return cosA * cosB + sinA * sinB;
+}
+
+/// @brief Computes sin(a - b) from the sines and cosines of two angles, which is zero if a is smaller than b.
+static float sinSubClamped(float sinA, float cosA, float sinB, float cosB) {
+    if (cosA > cosB)
+        return 0;
+    return sinA * cosB - cosA * sinB;
+}
+
+/// @brief Estimates the contribution of the light sources within the bounds to a point.
+static float importance(const LightBounds &light, const Point &origin) {
+    // clamp the distance to the size of the bounds, so that points close to or within the bounds are not overly
+    // favored
+    const Point center = light.bounds.center();
+    const Vector toOrigin = origin - center;
+    const float radius2 = light.bounds.diagonal().lengthSquared() / 4;
+    const float distance2 = std::max(toOrigin.lengthSquared(), light.bounds.diagonal().length() / 2);
+
+    // the angle between the axis and the direction towards the point
+    float cosThetaW = toOrigin.lengthSquared() > 0 ? light.axis.dot(toOrigin) / toOrigin.length() : 1;
+    if (light.twoSided)
+        cosThetaW = abs(cosThetaW);
+    const float sinThetaW = safe_sqrt(1 - sqr(cosThetaW));
+
+    // the angle the bounds subtend when seen from the point (all directions if the point is within its bounding
+    // sphere)
+    const float cosThetaB = toOrigin.lengthSquared() > radius2 ? safe_sqrt(1 - radius2 / toOrigin.lengthSquared()) : -1;
+    const float sinThetaB = safe_sqrt(1 - sqr(cosThetaB));
+
+    // the smallest angle between the normals and the direction towards the point, first considering the cone of
+    // normals and then the extent of the bounds
+    const float sinThetaO = safe_sqrt(1 - sqr(light.cosThetaO));
+    const float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, light.cosThetaO);
+    const float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, light.cosThetaO);
+    const float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+    if (cosThetaP <= light.cosThetaE)
+        return 0;
+
+    return std::max(light.power * cosThetaP / distance2, 0.f);
+}
+
+/// @brief Computes the smallest cone that contains two cones given by their axis and cosine of their opening angle.
+static std::pair<Vector, float> mergeCones(const Vector &axisA, float cosA, const Vector &axisB, float cosB) {
+    const float thetaA = safe_acos(cosA);
+    const float thetaB = safe_acos(cosB);
+    const float thetaD = safe_acos(axisA.dot(axisB));
+    if (std::min(thetaD + thetaB, Pi) <= thetaA)
+        return { axisA, cosA };
+    if (std::min(thetaD + thetaA, Pi) <= thetaB)
+        return { axisB, cosB };
+
+    // rotate the first axis towards the second, such that the merged cone touches the outer edges of both cones
+    const float thetaO = (thetaA + thetaD + thetaB) / 2;
+    const Vector rotationAxis = axisA.cross(axisB);
+    if (thetaO >= Pi || rotationAxis.lengthSquared() == 0)
+        return { axisA, -1 };
+    const float thetaR = thetaO - thetaA;
+    const Vector orthogonal = rotationAxis.normalized().cross(axisA);
+    return { (axisA * cos(thetaR) + orthogonal * sin(thetaR)).normalized(), cos(thetaO) };
+}
+
+/// @brief Computes bounds that contain the light sources of two bounds.
+static LightBounds merge(const LightBounds &a, const LightBounds &b) {
+    if (a.power == 0)
+        return b;
+    if (b.power == 0)
+        return a;
+
+    LightBounds result = a;
+    result.bounds.extend(b.bounds);
+    result.power = a.power + b.power;
+    std::tie(result.axis, result.cosThetaO) = mergeCones(a.axis, a.cosThetaO, b.axis, b.cosThetaO);
+    result.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+    result.twoSided = a.twoSided || b.twoSided;
+    return result;
+}
+
+/// @brief Estimates the cost of a node with the given bounds (see pbrt-v4), which grows with the power of the
+/// light sources, their extent and the solid angle they emit into.
+static float cost(const LightBounds &light, const Bounds &parent, int axis) {
+    const float thetaO = safe_acos(light.cosThetaO);
+    const float thetaE = safe_acos(light.cosThetaE);
+    const float thetaW = std::min(thetaO + thetaE, Pi);
+    const float sinThetaO = safe_sqrt(1 - sqr(light.cosThetaO));
+    const float solidAngle = 2 * Pi * (1 - light.cosThetaO) +
+                             Pi / 2 *
+                                 (2 * thetaW * sinThetaO - cos(thetaO - 2 * thetaW) - 2 * thetaO * sinThetaO +
+                                  light.cosThetaO);
+
+    // prefer splitting along the longest axis of the parent
+    const Vector parentExtent = parent.diagonal();
+    const float aspect = parentExtent[axis] > 0 ? parentExtent.maxComponent() / parentExtent[axis] : 1;
+
+    // light sources without extent (e.g., point lights) are treated as small boxes, so that their distribution
+    // still matters for the cost
+    const auto surfaceArea = [](const Vector &extent) {
+        return 2 * (extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+    };
+    const float area = std::max(surfaceArea(light.bounds.diagonal()), 1e-4f * surfaceArea(parentExtent));
+    return light.power * solidAngle * aspect * area;
+}
+
+LightBVH::LightBVH(std::vector<std::pair<int, LightBounds>> lights, int lightCount) : m_bitTrails(lightCount, 0) {
+    std::erase_if(lights, [](const auto &light) { return !(light.second.power > 0); });
+    if (lights.empty())
+        return;
+    m_nodes.reserve(2 * lights.size() - 1);
+    build(lights, 0, 0);
+}
+
+int LightBVH::build(std::span<std::pair<int, LightBounds>> lights, uint64_t bitTrail, int depth) {
+    const int nodeIndex = int(m_nodes.size());
+    if (lights.size() == 1) {
+        m_nodes.push_back({ .bounds = lights[0].second, .index = lights[0].first, .isLeaf = true });
+        m_bitTrails[lights[0].first] = bitTrail;
+        return nodeIndex;
+    }
+
+    Bounds bounds, centroidBounds;
+    for (const auto &[index, light] : lights) {
+        bounds.extend(light.bounds);
+        centroidBounds.extend(Bounds(light.bounds.center(), light.bounds.center()));
+    }
+
+    // find the cheapest split among a fixed number of buckets per axis
+    constexpr int BucketCount = 12;
+    float bestCost = Infinity;
+    int bestAxis = -1, bestBucket = -1;
+    for (int axis = 0; axis < 3; axis++) {
+        const float minimum = centroidBounds.min()[axis];
+        const float extent = centroidBounds.max()[axis] - minimum;
+        if (!(extent > 0))
+            continue;
+
+        LightBounds buckets[BucketCount] = {};
+        const auto bucketOf = [&](const LightBounds &light) {
+            return std::clamp(int(BucketCount * (light.bounds.center()[axis] - minimum) / extent), 0, BucketCount - 1);
+        };
+        for (const auto &[index, light] : lights) {
+            LightBounds &bucket = buckets[bucketOf(light)];
+            bucket = merge(bucket, light);
+        }
+
+        // sweep from the right to compute the bounds of all suffixes of buckets
+        LightBounds suffixes[BucketCount] = {};
+        suffixes[BucketCount - 1] = buckets[BucketCount - 1];
+        for (int i = BucketCount - 2; i >= 0; i--)
+            suffixes[i] = merge(buckets[i], suffixes[i + 1]);
+
+        LightBounds prefix = {};
+        for (int i = 0; i < BucketCount - 1; i++) {
+            prefix = merge(prefix, buckets[i]);
+            if (prefix.power == 0 || suffixes[i + 1].power == 0)
+                continue;
+            const float splitCost = cost(prefix, bounds, axis) + cost(suffixes[i + 1], bounds, axis);
+            if (splitCost < bestCost) {
+                bestCost = splitCost;
+                bestAxis = axis;
+                bestBucket = i;
+            }
+        }
+    }
+
+    // fall back to splitting in the middle of the list if all light sources are at the same position (or the tree
+    // becomes too deep for the bit trails)
+    size_t middle = lights.size() / 2;
+    if (bestAxis >= 0 && depth < 48) {
+        const float minimum = centroidBounds.min()[bestAxis];
+        const float extent = centroidBounds.max()[bestAxis] - minimum;
+        const auto it = std::partition(lights.begin(), lights.end(), [&](const auto &light) {
+            const int bucket = std::clamp(
+                int(BucketCount * (light.second.bounds.center()[bestAxis] - minimum) / extent), 0, BucketCount - 1);
+            return bucket <= bestBucket;
+        });
+        middle = size_t(it - lights.begin());
+    }
+    if (middle == 0 || middle == lights.size()) {
+        middle = lights.size() / 2;
+    }
+
+    m_nodes.push_back({ .bounds = {}, .index = -1, .isLeaf = false });
+    const int first = build(lights.subspan(0, middle), bitTrail, depth + 1);
+    const int second = build(lights.subspan(middle), bitTrail | (uint64_t(1) << depth), depth + 1);
+    m_nodes[nodeIndex].bounds = merge(m_nodes[first].bounds, m_nodes[second].bounds);
+    m_nodes[nodeIndex].index = second;
+    return nodeIndex;
+}
+
+std::pair<int, float> LightBVH::sample(const Point &origin, float u) const {
+    if (m_nodes.empty())
+        return { -1, 0 };
+
+    int nodeIndex = 0;
+    float pmf = 1;
+    while (!m_nodes[nodeIndex].isLeaf) {
+        const float first = importance(m_nodes[nodeIndex + 1].bounds, origin);
+        const float second = importance(m_nodes[m_nodes[nodeIndex].index].bounds, origin);
+        if (first == 0 && second == 0)
+            return { -1, 0 };
+
+        // pick a child and reuse the random number for the next level
+        const float probability = first / (first + second);
+        if (u < probability) {
+            nodeIndex = nodeIndex + 1;
+            u = std::min(u / probability, 1 - Epsilon);
+            pmf *= probability;
+        } else {
+            nodeIndex = m_nodes[nodeIndex].index;
+            u = std::min((u - probability) / (1 - probability), 1 - Epsilon);
+            pmf *= 1 - probability;
+        }
+    }
+
+    // the tree might consist of a single light source that does not contribute to the point
+    if (nodeIndex == 0 && importance(m_nodes[0].bounds, origin) == 0)
+        return { -1, 0 };
+    return { m_nodes[nodeIndex].index, pmf };
+}
+
+float LightBVH::pmf(const Point &origin, int light) const {
+    if (m_nodes.empty())
+        return 0;
+
+    uint64_t bitTrail = m_bitTrails[light];
+    int nodeIndex = 0;
+    float pmf = 1;
+    while (!m_nodes[nodeIndex].isLeaf) {
+        const float first = importance(m_nodes[nodeIndex + 1].bounds, origin);
+        const float second = importance(m_nodes[m_nodes[nodeIndex].index].bounds, origin);
+        if (first == 0 && second == 0)
+            return 0;
+
+        if (bitTrail & 1) {
+            nodeIndex = m_nodes[nodeIndex].index;
+            pmf *= second / (first + second);
+        } else {
+            nodeIndex = nodeIndex + 1;
+            pmf *= first / (first + second);
+        }
+        bitTrail >>= 1;
+    }
+
+    // light sources without power are not part of the tree
+    if (m_nodes[nodeIndex].index != light)
+        return 0;
+    if (nodeIndex == 0 && importance(m_nodes[0].bounds, origin) == 0)
+        return 0;
+    return pmf;
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/light.hpp>
+
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace lightwave {
+
+/**
+ * @brief A bounding volume hierarchy over the light sources of a scene, which picks light sources proportionally
+ * to an estimate of their contribution to a given point (see "Importance Sampling of Many Lights with Adaptive Tree
+ * Splitting", Conty Estevez and Kulla 2018).
+ *
+ * Each node bounds the region, power and emission directions of the light sources below it. Sampling descends the
+ * tree from the root, picking each child proportionally to its estimated contribution, which is computed from the
+ * distance to the region and the smallest angle between the directions the region emits into and the direction
+ * towards the point. Light sources at infinity are not part of the hierarchy.
+ */
+class LightBVH {
+    struct Node {
+        /// @brief The bounds of all light sources below this node.
+        LightBounds bounds;
+        /// @brief The index of the second child for interior nodes (the first child directly follows its parent),
+        /// or the index of the light source for leaves.
+        int index;
+        bool isLeaf;
+    };
+
+    std::vector<Node> m_nodes;
+    /// @brief The path from the root to the leaf of each light source, where bit i is set if the second child is
+    /// taken at depth i (indexed by light source, zero for light sources that are not part of the hierarchy).
+    std::vector<uint64_t> m_bitTrails;
+
+    /// @brief Builds the subtree over the given light sources and returns the index of its root.
+    int build(std::span<std::pair<int, LightBounds>> lights, uint64_t bitTrail, int depth);
+
+public:
+    /**
+     * @brief Builds the hierarchy over the given light sources.
+     * @param lights The index of each light source (e.g., within the scene) along with its bounds.
+     * @param lightCount The number of light sources that can be referred to by their index.
+     */
+    LightBVH(std::vector<std::pair<int, LightBounds>> lights, int lightCount);
+
+    /// @brief Reports whether the hierarchy does not contain any light sources.
+    bool empty() const { return m_nodes.empty(); }
+
+    /**
+     * @brief Picks a light source for the given point.
+     * @param u A uniformly distributed random number in [0,1).
+     * @return The index of the light source along with the probability of picking it, or an index of -1 if no light
+     * source of the hierarchy contributes to the point.
+     */
+    std::pair<int, float> sample(const Point &origin, float u) const;
+    /// @brief Returns the probability of @ref sample picking the light source with the given index.
+    float pmf(const Point &origin, int light) const;
+};
+
+}
@@ -1,5 +1,184 @@
 #include <lightwave/logger.hpp>
 
+#include <chrono>
+#include <csignal>
+
 namespace lightwave {
+
 Logger logger;
+
+/// @brief Writes a message with the prefix of its level, clearing the status line that might currently be shown.
+static void writeMessage(LogLevel level, const std::string &message) {
+    std::cout << "\033[2K\r";
+
+    switch (level) {
+        case EDebug:
+            std::cout << "\033[90m[debug] \033[0m";
+            break;
+        case EInfo:
+            std::cout << "\033[32m[info] \033[0m";
+            break;
+        case EWarn:
+            std::cout << "\033[33m[warn] \033[0m";
+            break;
+        case EError:
+            std::cout << "\033[31m[error] \033[0m";
+            break;
+    }
+    if (level >= EError) {
+        std::cout << std::flush;
+        std::cerr << message << std::endl;
+    } else {
+        std::cout << message << '\n';
+    }
+}
+
+/// @brief Writes pending log messages before the process is terminated by a signal.
+static void crashHandler(int signal) {
+    logger.flushOnCrash();
+    // let the default handler terminate the process (e.g., to produce a core dump)
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+}
+
+Logger::Logger() : m_slots(new Slot[Capacity]), m_tail(0), m_head(0), m_stopped(false) {
+    for (uint64_t i = 0; i < Capacity; i++)
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+
+    for (int signal : { SIGSEGV, SIGABRT, SIGFPE, SIGILL
+#ifndef LW_OS_WINDOWS
+                        , SIGBUS
+#endif
+         }) {
+        std::signal(signal, crashHandler);
+    }
+
+    m_thread = std::thread([this]() {
+        std::unique_lock wakeLock{ m_wakeMutex };
+        while (!m_stopped.load(std::memory_order_acquire)) {
+            wakeLock.unlock();
+            {
+                std::unique_lock lock{ m_outputMutex };
+                drain();
+            }
+            wakeLock.lock();
+            m_wake.wait_for(wakeLock, std::chrono::milliseconds(StatusInterval));
+        }
+    });
+}
+
+Logger::~Logger() {
+    {
+        std::unique_lock wakeLock{ m_wakeMutex };
+        m_stopped.store(true, std::memory_order_release);
+    }
+    m_wake.notify_one();
+    m_thread.join();
+
+    std::unique_lock lock{ m_outputMutex };
+    drain();
+}
+
+void Logger::log(LogLevel level, std::string &&message) {
+    if (m_stopped.load(std::memory_order_acquire)) {
+        // messages logged during shutdown are written directly, after those still queued
+        std::unique_lock lock{ m_outputMutex };
+        drain();
+        writeMessage(level, message);
+        std::cout << std::flush;
+        return;
+    }
+
+    uint64_t position = m_tail.load(std::memory_order_relaxed);
+    while (true) {
+        Slot &slot = m_slots[position % Capacity];
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence == position) {
+            // the slot is free, try to claim it
+            if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        } else if (sequence < position) {
+            // the buffer is full, wait for the background thread to catch up
+            m_wake.notify_one();
+            std::this_thread::yield();
+            position = m_tail.load(std::memory_order_relaxed);
+        } else {
+            // another thread has claimed the slot
+            position = m_tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    Slot &slot   = m_slots[position % Capacity];
+    slot.level   = level;
+    slot.message = std::move(message);
+    slot.sequence.store(position + 1, std::memory_order_release);
+
+    if (level >= EWarn)
+        m_wake.notify_one();
+}
+
+bool Logger::dequeue(LogLevel &level, std::string &message) {
+    // only one thread dequeues at a time (guarded by the output mutex)
+    const uint64_t position = m_head.load(std::memory_order_relaxed);
+    Slot &slot              = m_slots[position % Capacity];
+    if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+        return false;
+
+    level = slot.level;
+    std::swap(message, slot.message);
+    m_head.store(position + 1, std::memory_order_relaxed);
+    slot.sequence.store(position + Capacity, std::memory_order_release);
+    return true;
+}
+
+void Logger::drain() {
+    LogLevel level;
+    std::string message;
+    bool written = false;
+    while (dequeue(level, message)) {
+        writeMessage(level, message);
+        written = true;
+    }
+
+    std::unique_lock lock{ m_statusMutex };
+    if (m_progress) {
+        std::string status = m_progress->status();
+        if (status != m_status) {
+            m_status        = std::move(status);
+            m_statusChanged = true;
+        }
+    }
+    if (written || m_statusChanged) {
+        std::cout << "\033[2K\r" << m_status << std::flush;
+        m_statusChanged = false;
+    }
 }
+
+void Logger::setProgress(const ProgressReporter *progress) {
+    {
+        // wait until the status of a previous reporter is no longer being drawn
+        std::unique_lock lock{ m_statusMutex };
+        m_progress = progress;
+    }
+    m_wake.notify_one();
+}
+
+void Logger::flush() {
+    std::unique_lock lock{ m_outputMutex };
+    drain();
+}
+
+void Logger::flushOnCrash() {
+    // the crashing thread might hold the console itself, so we only wait for a bounded time
+    std::unique_lock lock{ m_outputMutex, std::defer_lock };
+    for (int attempt = 0; attempt < 1000 && !lock.try_lock(); attempt++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    LogLevel level;
+    std::string message;
+    while (dequeue(level, message))
+        writeMessage(level, message);
+    std::cout << std::endl;
+}
+
+} // namespace lightwave
@@ -1,10 +1,19 @@
 #include <lightwave/core.hpp>
 #include <lightwave/registry.hpp>
 #include <lightwave/logger.hpp>
+#include <lightwave/allocations.hpp>
+#include <lightwave/distributed.hpp>
+#include <lightwave/film.hpp>
+#include <lightwave/integrator.hpp>
+#include <lightwave/parallel.hpp>
 
 #include "parser.hpp"
 
+#include <csignal>
+#include <cstdio>
 #include <fstream>
+#include <optional>
+#include <string_view>
 
 #ifdef LW_OS_WINDOWS
 #include <cstdlib>
@@ -21,6 +30,51 @@ void print_exception(const std::exception &e, int level = 0) {
     } catch(...) {}
 }
 
+void print_usage(const char *executable) {
+    logger(EInfo, "usage: %s [options] <scene.xml>\n"
+                  "       %s merge <output.exr|output.film> <input.film>...\n"
+                  "       %s coordinate <socket> [--tile-size <pixels>] [--sample-chunk <samples>]\n"
+                  "options:\n"
+                  "  -t, --threads <count>    number of worker threads (default: one per core)\n"
+                  "  --pin                    pin worker threads to cores\n"
+                  "  --numa                   interleave scene data across NUMA nodes\n"
+                  "  --checkpoint <seconds>   periodically save the render state next to the output image\n"
+                  "  --resume                 continue renders from their checkpoints\n"
+                  "  --region <x0,y0,x1,y1>   only render the given region of the image\n"
+                  "  --samples <start,end>    only take the given range of sample indices\n"
+                  "  --connect <socket>       render the work handed out by a coordinator (requires --film)\n"
+                  "  --film <path>            where to store the film of checkpoints and partial renders",
+           executable, executable, executable);
+}
+
+/// @brief Combines the samples of several film files and stores them as film or as image.
+int merge_films(const std::filesystem::path &output, const std::vector<std::filesystem::path> &inputs) {
+    Film merged;
+    float elapsedTime = 0;
+    for (const auto &input : inputs) {
+        Film part;
+        elapsedTime += part.load(input);
+        if (merged.resolution().isZero()) {
+            merged.initialize(part.resolution());
+        } else if (merged.resolution() != part.resolution()) {
+            logger(EError, "film %s does not match the resolution of the other films", input);
+            return 1;
+        }
+        merged.merge(part, merged.bounds());
+    }
+
+    logger(EInfo, "merged %d films with %.1f samples per pixel on average", inputs.size(),
+           merged.totalSamples() / float(merged.bounds().diagonal().product()));
+    if (output.extension() == ".film") {
+        merged.save(output, elapsedTime);
+    } else {
+        Image image { merged.resolution() };
+        merged.develop(image, merged.bounds());
+        image.saveAt(output);
+    }
+    return 0;
+}
+
 int main(int argc, const char *argv[]) {
 #ifdef LW_DEBUG
     logger(EWarn, "lightwave was compiled in Debug mode, expect rendering to be much slower");
@@ -35,19 +89,132 @@ int main(int argc, const char *argv[]) {
 #endif
 
     try {
-        if (argc <= 1) {
+        const auto next_value = [&](int &i) -> std::string {
+            if (i + 1 >= argc) {
+                lightwave_throw("missing value for option %s", argv[i]);
+            }
+            return argv[++i];
+        };
+
+        if (argc >= 2 && std::string_view(argv[1]) == "merge") {
+            if (argc < 4) {
+                print_usage(argv[0]);
+                return -1;
+            }
+            return merge_films(argv[2], std::vector<std::filesystem::path>(argv + 3, argv + argc));
+        }
+
+        if (argc >= 2 && std::string_view(argv[1]) == "coordinate") {
+            if (argc < 3) {
+                print_usage(argv[0]);
+                return -1;
+            }
+            int tileSize = 128, sampleChunk = 64;
+            for (int i = 3; i < argc; i++) {
+                const std::string_view arg = argv[i];
+                if (arg == "--tile-size") {
+                    tileSize = std::stoi(next_value(i));
+                } else if (arg == "--sample-chunk") {
+                    sampleChunk = std::stoi(next_value(i));
+                } else {
+                    logger(EError, "unexpected argument %s", arg);
+                    return -1;
+                }
+            }
+            if (tileSize <= 0 || sampleChunk <= 0) {
+                logger(EError, "tile size and sample chunk must be positive");
+                return -1;
+            }
+            return runCoordinator(argv[2], tileSize, sampleChunk);
+        }
+
+        std::filesystem::path scenePath;
+        bool numaInterleaving = false;
+
+        for (int i = 1; i < argc; i++) {
+            const std::string_view arg = argv[i];
+            if (arg == "-t" || arg == "--threads") {
+                setThreadCount(std::stoi(next_value(i)));
+            } else if (arg == "--pin") {
+                setThreadPinning(true);
+            } else if (arg == "--numa") {
+                numaInterleaving = true;
+            } else if (arg == "--checkpoint") {
+                renderSettings.checkpointInterval = std::stof(next_value(i));
+            } else if (arg == "--resume") {
+                renderSettings.resume = true;
+            } else if (arg == "--region") {
+                Point2i min, max;
+                if (std::sscanf(next_value(i).c_str(), "%d,%d,%d,%d", &min.x(), &min.y(), &max.x(), &max.y()) != 4) {
+                    lightwave_throw("invalid region %s, expected x0,y0,x1,y1", argv[i]);
+                }
+                renderSettings.region = Bounds2i(min, max);
+            } else if (arg == "--samples") {
+                if (std::sscanf(next_value(i).c_str(), "%d,%d", &renderSettings.sampleStart,
+                                &renderSettings.sampleEnd) != 2) {
+                    lightwave_throw("invalid sample range %s, expected start,end", argv[i]);
+                }
+            } else if (arg == "--connect") {
+                renderSettings.coordinator = next_value(i);
+            } else if (arg == "--film") {
+                renderSettings.filmPath = next_value(i);
+            } else if (arg == "-h" || arg == "--help") {
+                print_usage(argv[0]);
+                return 0;
+            } else if (arg.starts_with("-") || !scenePath.empty()) {
+                logger(EError, "unexpected argument %s", arg);
+                print_usage(argv[0]);
+                return -1;
+            } else {
+                scenePath = arg;
+            }
+        }
+
+        if (scenePath.empty()) {
             logger(EError, "please specify path to scene");
             return -1;
         }
-        
-        std::filesystem::path scenePath = argv[1];
 
+        if (!renderSettings.coordinator.empty() && renderSettings.filmPath.empty()) {
+            // every process connected to a coordinator stores its own film, which would otherwise share one path
+            logger(EError, "please specify a distinct --film path for each process connected to a coordinator");
+            return -1;
+        }
+
+        if (renderSettings.checkpointInterval > 0) {
+            // stop gracefully and write a final checkpoint when asked to terminate (e.g., on preemption),
+            // a second signal terminates immediately
+            const auto handler = [](int signal) {
+                renderSettings.interrupted = true;
+                std::signal(signal, SIG_DFL);
+            };
+            std::signal(SIGINT, handler);
+            std::signal(SIGTERM, handler);
+        }
+
+        logger(EInfo, "rendering with %d threads (%d NUMA nodes)",
+               threadCount(), numaNodeCount());
+
+        // only data allocated while parsing (i.e., the scene) is interleaved,
+        // buffers written during rendering are first-touched by the workers
+        if (numaInterleaving)
+            setNumaInterleaving(true);
+        std::optional<AllocationPhase> allocations { "loading the scene" };
         SceneParser parser { scenePath };
+        allocations.reset();
+        if (numaInterleaving)
+            setNumaInterleaving(false);
+
         for (auto &object : parser.objects()) {
             if (auto executable = dynamic_cast<Executable *>(object.get())) {
                 executable->execute();
             }
         }
+
+        if (renderSettings.interrupted) {
+            logger(EWarn, "rendering was interrupted, use --resume to continue");
+            return 1;
+        }
     } catch(const std::exception &e) {
         print_exception(e);
         return 1;
@@ -149,6 +149,7 @@ BsdfSample Intersection::sampleBsdf(Sampler &rng) const {
     if (!instance->bsdf()) return{
             .wi     = -1*wo,
             .weight = Color(1),
+            .pdf    = Infinity,
         };
     assert_normalized(wo, {});
     auto bsdfSample = instance->bsdf()->sample(uv, frame.toLocal(wo), rng);
@@ -167,9 +168,11 @@ BsdfSample Intersection::sampleBsdf(Sampler &rng) const {
 BsdfEval Intersection::evaluateBsdf(const Vector &wi) const {
     if (!instance) return {
             .value = Color(1),
+            .pdf   = 0,
         };
     if (!instance->bsdf()) return{
             .value = Color(1),
+            .pdf   = 0,
         };
     return instance->bsdf()->evaluate(uv, frame.toLocal(wo), frame.toLocal(wi));
 }
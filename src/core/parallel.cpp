@@ -0,0 +1,139 @@
+#include <lightwave/parallel.hpp>
+
+#include <atomic>
+#include <cctype>
+#include <filesystem>
+#include <vector>
+
+#ifdef LW_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace lightwave {
+
+/// @brief The number of threads requested by the user, or zero for the default.
+static std::atomic<int> s_threadCount = 0;
+/// @brief Whether worker threads should be pinned to cores.
+static std::atomic<bool> s_pinThreads = false;
+/// @brief The index of the worker the calling thread acts as.
+static thread_local int s_threadIndex = 0;
+
+#ifdef LW_OS_LINUX
+/// @brief Returns the cores the process is allowed to run on, in ascending
+/// order (this respects restrictions imposed by taskset, cgroups and similar).
+static const std::vector<int> &availableCores() {
+    static const std::vector<int> cores = []() {
+        std::vector<int> result;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &set))
+                    result.push_back(cpu);
+            }
+        }
+        return result;
+    }();
+    return cores;
+}
+#endif
+
+int threadCount() {
+    if (const int count = s_threadCount; count > 0)
+        return count;
+
+#ifdef LW_OS_LINUX
+    if (const int cores = int(availableCores().size()); cores > 0)
+        return cores;
+#endif
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void setThreadCount(int count) { s_threadCount = std::max(count, 0); }
+
+void setThreadPinning(bool enabled) {
+#ifndef LW_OS_LINUX
+    if (enabled) {
+        logger(EWarn, "thread pinning is not supported on this platform");
+        return;
+    }
+#endif
+    s_pinThreads = enabled;
+}
+
+int threadIndex() { return s_threadIndex; }
+
+void initializeWorkerThread(int index) {
+    s_threadIndex = index;
+
+#ifdef LW_OS_LINUX
+    if (!s_pinThreads)
+        return;
+
+    const auto &cores = availableCores();
+    if (cores.empty())
+        return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cores[index % cores.size()], &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        logger(EWarn, "could not pin worker thread %d to core %d", index,
+               cores[index % cores.size()]);
+    }
+#endif
+}
+
+int numaNodeCount() {
+#ifdef LW_OS_LINUX
+    static const int count = []() {
+        int nodes = 0;
+        std::error_code error;
+        for (const auto &entry : std::filesystem::directory_iterator(
+                 "/sys/devices/system/node", error)) {
+            const auto name = entry.path().filename().string();
+            if (name.rfind("node", 0) == 0 && name.size() > 4 &&
+                std::isdigit(name[4]))
+                nodes++;
+        }
+        return std::max(nodes, 1);
+    }();
+    return count;
+#else
+    return 1;
+#endif
+}
+
+void setNumaInterleaving(bool enabled) {
+    const int nodes = numaNodeCount();
+    if (nodes <= 1)
+        return;
+
+#if defined(LW_OS_LINUX) && defined(SYS_set_mempolicy)
+    // values from <linux/mempolicy.h>, which we avoid to not depend on libnuma
+    constexpr int MPOL_DEFAULT    = 0;
+    constexpr int MPOL_INTERLEAVE = 3;
+
+    constexpr int BitsPerWord = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask((nodes + BitsPerWord - 1) / BitsPerWord);
+    for (int node = 0; node < nodes; node++)
+        mask[node / BitsPerWord] |= 1ul << (node % BitsPerWord);
+
+    const long result =
+        enabled ? syscall(SYS_set_mempolicy, MPOL_INTERLEAVE, mask.data(),
+                          mask.size() * BitsPerWord)
+                : syscall(SYS_set_mempolicy, MPOL_DEFAULT, nullptr, 0);
+    if (result != 0) {
+        logger(EWarn, "could not %s NUMA interleaving",
+               enabled ? "enable" : "disable");
+    }
+#else
+    if (enabled)
+        logger(EWarn, "NUMA interleaving is not supported on this platform");
+#endif
+}
+
+} // namespace lightwave
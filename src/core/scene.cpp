@@ -6,12 +6,20 @@
 #include <lightwave/light.hpp>
 #include <lightwave/instance.hpp>
 
+#include "lightbvh.hpp"
+
 namespace lightwave {
 
 Scene::Scene(const Properties &properties) {
     m_camera = properties.getChild<Camera>();
     m_background = properties.getOptionalChild<BackgroundLight>();
     m_lights = properties.getChildren<Light>();
+    m_lightSelection = properties.getEnum<LightSelection>("lightSelection", LightSelection::Power,
+        {
+            { "uniform", LightSelection::Uniform },
+            { "power", LightSelection::Power },
+            { "bvh", LightSelection::BVH },
+        });
     
     const std::vector<ref<Shape>> entities = properties.getChildren<Shape>();
     if (entities.size() == 1) {
@@ -21,6 +29,48 @@ Scene::Scene(const Properties &properties) {
     }
 
     m_shape->markAsVisible();
+    buildLightSelection();
+}
+
+void Scene::buildLightSelection() {
+    for (int i = 0; i < int(m_lights.size()); i++) {
+        m_lightIndices[m_lights[i].get()] = i;
+    }
+
+    // light sources at infinity need the extent of the scene to estimate their power
+    Bounds sceneBounds = m_shape->getBoundingBox();
+    if (sceneBounds.isEmpty() || sceneBounds.isUnbounded()) {
+        sceneBounds = Bounds(Point(-1), Point(+1));
+    }
+    m_lightSceneBounds = sceneBounds;
+
+    // emitting light always follows the power of the light sources, as no point is illuminated
+    std::vector<float> powers;
+    for (const auto &light : m_lights) {
+        const float power = light->power(sceneBounds);
+        powers.push_back(std::isfinite(power) ? std::max(power, 0.f) : 0);
+    }
+    m_emissionPowers = AliasTable(powers);
+
+    if (m_lightSelection == LightSelection::Power) {
+        m_lightPowers = m_emissionPowers;
+    }
+
+    if (m_lightSelection == LightSelection::BVH) {
+        std::vector<std::pair<int, LightBounds>> bounds;
+        for (int i = 0; i < int(m_lights.size()); i++) {
+            if (const auto lightBounds = m_lights[i]->bounds()) {
+                bounds.emplace_back(i, *lightBounds);
+            } else {
+                m_infiniteLights.push_back(i);
+            }
+        }
+        m_lightBvh = std::make_shared<LightBVH>(std::move(bounds), int(m_lights.size()));
+
+        // like the light sources at infinity, the whole hierarchy counts as one option
+        const int options = int(m_infiniteLights.size()) + (m_lightBvh->empty() ? 0 : 1);
+        m_infiniteProbability = options ? float(m_infiniteLights.size()) / options : 0;
+    }
 }
 
 std::string Scene::toString() const {
@@ -28,9 +78,11 @@ std::string Scene::toString() const {
         "Scene[\n"
         "  camera = %s,\n"
         "  shape = %s,\n"
+        "  lights = %d,\n"
         "]",
         indent(m_camera),
-        indent(m_shape)
+        indent(m_shape),
+        m_lights.size()
     );
 }
 
@@ -63,6 +115,18 @@ bool Scene::intersect(const Ray &ray, float tMax, Sampler &rng) const {
     return m_shape->intersect(ray, its, rng);
 }
 
+bool Scene::intersectCrossings(const Ray &ray, float tMax, std::vector<MediumCrossing> &crossings,
+                               Sampler &rng) const {
+    crossings.clear();
+    if (!m_shape->intersectCrossings(ray, tMax * (1 - Epsilon), crossings, rng)) {
+        return false;
+    }
+    std::sort(crossings.begin(), crossings.end(), [](const MediumCrossing &a, const MediumCrossing &b) {
+        return a.t < b.t;
+    });
+    return true;
+}
+
 BackgroundLightEval Scene::evaluateBackground(const Vector &direction) const {
     if (!m_background) return {
         .value = Color(0),
@@ -70,17 +134,89 @@ BackgroundLightEval Scene::evaluateBackground(const Vector &direction) const {
     return m_background->evaluate(direction);
 }
 
-LightSample Scene::sampleLight(Sampler &rng) const {
-    int lightIndex = int(rng.next() * m_lights.size());
-    lightIndex = std::min(lightIndex, int(m_lights.size()) - 1);
-    return {
-        .light = m_lights[lightIndex].get(),
-        .probability = float(1) / m_lights.size(),
-    };
+LightSample Scene::sampleLight(const Point &origin, Sampler &rng) const {
+    const float u = rng.next();
+    switch (m_lightSelection) {
+    case LightSelection::Power: {
+        const int lightIndex = m_lightPowers.sample(u);
+        return {
+            .light = m_lights[lightIndex].get(),
+            .probability = m_lightPowers.pmf(lightIndex),
+        };
+    }
+    case LightSelection::BVH: {
+        if (u < m_infiniteProbability) {
+            int index = int(u / m_infiniteProbability * m_infiniteLights.size());
+            index = std::min(index, int(m_infiniteLights.size()) - 1);
+            return {
+                .light = m_lights[m_infiniteLights[index]].get(),
+                .probability = m_infiniteProbability / m_infiniteLights.size(),
+            };
+        }
+
+        const float remapped = std::min((u - m_infiniteProbability) / (1 - m_infiniteProbability), 1 - Epsilon);
+        const auto [lightIndex, pmf] = m_lightBvh->sample(origin, remapped);
+        if (lightIndex < 0) {
+            return { .light = nullptr, .probability = 0 };
+        }
+        return {
+            .light = m_lights[lightIndex].get(),
+            .probability = (1 - m_infiniteProbability) * pmf,
+        };
+    }
+    default: {
+        int lightIndex = int(u * m_lights.size());
+        lightIndex = std::min(lightIndex, int(m_lights.size()) - 1);
+        return {
+            .light = m_lights[lightIndex].get(),
+            .probability = float(1) / m_lights.size(),
+        };
+    }
+    }
 }
 
-float Scene::lightSelectionProbability(const Light *light) const {
-    return float(1) / m_lights.size();
+float Scene::lightSelectionProbability(const Light *light, const Point &origin) const {
+    const auto it = m_lightIndices.find(light);
+    if (it == m_lightIndices.end()) {
+        return 0;
+    }
+
+    switch (m_lightSelection) {
+    case LightSelection::Power:
+        return m_lightPowers.pmf(it->second);
+    case LightSelection::BVH:
+        if (std::find(m_infiniteLights.begin(), m_infiniteLights.end(), it->second) != m_infiniteLights.end()) {
+            return m_infiniteProbability / m_infiniteLights.size();
+        }
+        return (1 - m_infiniteProbability) * m_lightBvh->pmf(origin, it->second);
+    default:
+        return float(1) / m_lights.size();
+    }
+}
+
+EmissionSample Scene::sampleEmission(Sampler &rng) const {
+    if (m_lights.empty()) {
+        return EmissionSample::invalid();
+    }
+
+    const int lightIndex = m_emissionPowers.sample(rng.next());
+    const float probability = m_emissionPowers.pmf(lightIndex);
+    if (!(probability > 0)) {
+        return EmissionSample::invalid();
+    }
+
+    EmissionSample sample = m_lights[lightIndex]->sampleEmission(m_lightSceneBounds, rng);
+    sample.weight /= probability;
+    sample.light = m_lights[lightIndex].get();
+    return sample;
+}
+
+float Scene::emissionProbability(const Light *light) const {
+    const auto it = m_lightIndices.find(light);
+    if (it == m_lightIndices.end()) {
+        return 0;
+    }
+    return m_emissionPowers.pmf(it->second);
 }
 
 Bounds Scene::getBoundingBox() const {
@@ -0,0 +1,94 @@
+#include <lightwave/scheduler.hpp>
+#include <lightwave/iterators.hpp>
+#include <lightwave/parallel.hpp>
+
+namespace lightwave {
+
+TileScheduler::TileScheduler(const Vector2i &resolution, int tileSize, int cellSize)
+: m_resolution(resolution), m_tileSize(tileSize), m_cellSize(cellSize) {
+    m_cellCount = (resolution + Vector2i(cellSize - 1)) / cellSize;
+    m_cellCost.resize(m_cellCount.product(), 1);
+    restart();
+}
+
+void TileScheduler::restart(const Bounds2i &region) {
+    m_queue.clear();
+    for (auto block : BlockSpiral(m_resolution, Vector2i(m_tileSize))) {
+        const Bounds2i tile = region.clip(block);
+        if (!tile.isEmpty())
+            m_queue.push_back({ tile, 0 });
+    }
+    m_costsValid = false;
+}
+
+Bounds2i TileScheduler::cellBounds(int cell) const {
+    const Vector2i min = m_cellSize * Vector2i(cell % m_cellCount.x(), cell / m_cellCount.x());
+    return Bounds2i(Vector2i(0), m_resolution).clip(Bounds2i(min, min + Vector2i(m_cellSize)));
+}
+
+float TileScheduler::cost(const Bounds2i &bounds) const {
+    const Vector2i minCell = Vector2i(bounds.min()) / m_cellSize;
+    const Vector2i maxCell = Vector2i(bounds.max() - Vector2i(1)) / m_cellSize;
+
+    float sum = 0;
+    for (int y = minCell.y(); y <= maxCell.y(); y++) {
+        for (int x = minCell.x(); x <= maxCell.x(); x++) {
+            const int cell = y * m_cellCount.x() + x;
+            const Bounds2i overlap = bounds.clip(cellBounds(cell));
+            if (!overlap.isEmpty())
+                sum += m_cellCost[cell] * overlap.diagonal().product();
+        }
+    }
+    return sum;
+}
+
+void TileScheduler::pop() {
+    m_queue.pop_front();
+    balance();
+}
+
+void TileScheduler::balance() {
+    const int threshold = 2 * threadCount();
+    if (int(m_queue.size()) >= threshold)
+        return;
+
+    if (!m_costsValid) {
+        for (auto &tile : m_queue)
+            tile.cost = cost(tile.bounds);
+        m_costsValid = true;
+    }
+
+    while (int(m_queue.size()) < threshold) {
+        // find the most expensive tile that can still be split
+        auto candidate = m_queue.end();
+        for (auto it = m_queue.begin(); it != m_queue.end(); ++it) {
+            const Vector2i size = it->bounds.diagonal();
+            if (size.x() <= m_cellSize && size.y() <= m_cellSize)
+                continue;
+            if (candidate == m_queue.end() || it->cost > candidate->cost)
+                candidate = it;
+        }
+        if (candidate == m_queue.end())
+            break;
+
+        // split it into (up to) four quadrants, which take its place in the queue
+        const Bounds2i bounds = candidate->bounds;
+        const Vector2i size = bounds.diagonal();
+        const Vector2i half = Vector2i(
+            size.x() > m_cellSize ? (size.x() + 1) / 2 : size.x(),
+            size.y() > m_cellSize ? (size.y() + 1) / 2 : size.y());
+
+        auto position = m_queue.erase(candidate);
+        for (int y = 0; y < 2; y++) {
+            for (int x = 0; x < 2; x++) {
+                const Point2i min = bounds.min() + Vector2i(x, y) * half;
+                const Bounds2i quadrant = bounds.clip(Bounds2i(min, min + half));
+                if (quadrant.isEmpty())
+                    continue;
+                position = m_queue.insert(position, { quadrant, cost(quadrant) }) + 1;
+            }
+        }
+    }
+}
+
+}
@@ -588,18 +588,18 @@ void Streaming::Stream::reset() {
     m_index = 4;
 }
 
-Streaming::Streaming(const Image &image) : m_image(image) {
+Streaming::Streaming(const Image &image) : m_image(image), m_id(image.id()) {
     m_stream = std::make_unique<Stream>();
     *m_stream
         // close existing image
         << char(2)      // type
-        << m_image.id() // filename
+        << m_id         // filename
         << Stream::flush()
 
         // create image
         << char(4)      // type
         << bool(true)   // grab focus
-        << m_image.id() // filename
+        << m_id         // filename
         << m_image.resolution() << int32_t(m_channels.size()) << m_channels
         << Stream::flush();
 }
@@ -607,18 +607,16 @@ Streaming::Streaming(const Image &image) : m_image(image) {
 void Streaming::updateBlock(const Bounds2i &block) {
     std::unique_lock lock{ m_mutex };
 
-    std::vector<float> data;
     for (int channel = 0; channel < Color::NumComponents; channel++) {
-        data.clear();
-        data.reserve(block.diagonal().product());
+        m_blockData.clear();
         for (auto pixel : block)
-            data.push_back(m_image(pixel)[channel] * m_normalization);
+            m_blockData.push_back(m_image(pixel)[channel] * m_normalization);
 
         *m_stream
             // update channel
-            << char(3) << bool(false) << m_image.id() << m_channels[channel]
+            << char(3) << bool(false) << m_id << m_channels[channel]
             << block.min() << block.diagonal()
-            << Stream::binary(data.data(), data.size()) << Stream::flush();
+            << Stream::binary(m_blockData.data(), m_blockData.size()) << Stream::flush();
     }
 }
 
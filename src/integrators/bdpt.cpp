@@ -0,0 +1,511 @@
+#include <lightwave.hpp>
+
+#include <atomic>
+
+namespace lightwave {
+
+/**
+ * @brief A bidirectional path tracer: Each sample traces a subpath from the camera and one from a light source, and
+ * connects every vertex of the one to every vertex of the other. The resulting estimates of the same path are combined
+ * by multiple importance sampling (power heuristic), so that light which is hard to find from the camera (e.g., light
+ * sources enclosed by fixtures or behind glass) is found by tracing from the light sources instead.
+ * Connections of light subpaths to the camera contribute to other pixels than the one being sampled, and are splatted
+ * onto the image once rendering is complete.
+ */
+class Bdpt : public SamplingIntegrator {
+    /// @brief The maximal number of segments of the paths.
+    int m_depth;
+    /// @brief The number of segments after which subpaths are terminated randomly based on their throughput (Russian
+    /// roulette).
+    int m_rouletteDepth;
+
+    /// @brief Whether the camera supports connections, without which light subpaths cannot reach the image directly.
+    bool m_cameraConnections = false;
+    /// @brief The light subpaths connected to the camera, accumulated for each pixel (which many threads add to).
+    std::vector<Color> m_splats;
+    /// @brief The number of light subpaths that have been traced, by which the splats are normalized.
+    std::atomic<int64_t> m_lightPaths = 0;
+
+    /// @brief A vertex of a camera or light subpath.
+    struct Vertex {
+        enum class Type { Camera, Light, Surface };
+        Type type;
+        /// @brief The position of the vertex, and the surface and direction towards the previous vertex for surface
+        /// vertices (and the area density of points on area lights).
+        Intersection its;
+        /// @brief The surface normal, or zero for vertices without a surface (e.g., the camera or point lights).
+        Vector normal;
+        /// @brief The throughput of the subpath up to the vertex.
+        Color weight;
+        /// @brief The light source emitting from the vertex, if any.
+        const Light *light = nullptr;
+        /// @brief The density (in area) of the subpath having sampled this vertex.
+        float pdfForward = 0;
+        /// @brief The density (in area) of sampling this vertex when tracing the path in the opposite direction,
+        /// which is known once the two following vertices have been sampled.
+        float pdfReverse = 0;
+        /// @brief Whether the subpath continued from this vertex in a specular direction or the vertex lies on a surface
+        /// that rays pass through (i.e., without a BSDF), which prevents connections.
+        bool delta = false;
+
+        const Point &position() const { return its.position; }
+
+        /// @brief Returns the cosine between the normal and a direction, which is one for vertices without a surface.
+        float cosine(const Vector &direction) const {
+            return normal.isZero() ? 1 : std::abs(normal.dot(direction));
+        }
+    };
+
+    /// @brief Converts a density in solid angle at one vertex into a density in area at another vertex.
+    static float toArea(float pdf, const Vertex &from, const Vertex &to) {
+        const Vector direction = to.position() - from.position();
+        const float distanceSquared = direction.lengthSquared();
+        if (!(distanceSquared > 0)) {
+            return 0;
+        }
+        return pdf * to.cosine(direction / std::sqrt(distanceSquared)) / distanceSquared;
+    }
+
+    /**
+     * @brief Returns the density (in area) of sampling @c next from @c current , where @c current has been reached
+     * from @c previous , or starts the path if @c previous is null (i.e., is the camera or a point on a light source).
+     */
+    float pdfArea(const Vertex *previous, const Vertex &current, const Vertex &next) const {
+        const Vector wi = (next.position() - current.position()).normalized();
+        float pdf;
+        if (!previous) {
+            if (current.type == Vertex::Type::Camera) {
+                pdf = m_cameraConnections ? m_scene->camera()->pdfDirection(wi) : 1;
+            } else {
+                pdf = current.light ? current.light->pdfEmission(current.its, wi).direction : 0;
+            }
+        } else if (current.delta) {
+            pdf = 1;
+        } else {
+            Intersection its = current.its;
+            its.wo = (previous->position() - current.position()).normalized();
+            pdf = its.evaluateBsdf(wi).pdf;
+        }
+        return toArea(pdf, current, next);
+    }
+
+    /**
+     * @brief Returns the density (in area) of sampling a point on a light source by direct light sampling (i.e.,
+     * @ref Light::sampleDirect ) from another vertex, or zero if the light source cannot be reached this way.
+     */
+    float pdfDirect(const Vertex &light, const Vertex &origin) const {
+        if (!light.light) {
+            return 0;
+        }
+        const float selection = m_scene->lightSelectionProbability(light.light, origin.position());
+        if (light.normal.isZero()) {
+            // light sources that emit from a single point are sampled with certainty once picked
+            return selection;
+        }
+        if (!light.light->canBeIntersected()) {
+            return 0;
+        }
+        return toArea(selection * light.light->pdfDirect(origin.position(), light.its), origin, light);
+    }
+
+    /**
+     * @brief Computes the weight of connecting the first @c s vertices of a light subpath to the first @c t vertices
+     * of a camera subpath, relative to all other ways of sampling the resulting path (power heuristic).
+     * The densities of the other strategies are found from the densities of sampling each vertex from the light and
+     * from the camera, of which only those next to the connection need to be computed.
+     */
+    float misWeight(std::span<const Vertex> lightPath, std::span<const Vertex> cameraPath) const {
+        const int s = int(lightPath.size());
+        const int n = s + int(cameraPath.size());
+        const auto vertex = [&](int i) -> const Vertex & { return i < s ? lightPath[i] : cameraPath[n - 1 - i]; };
+
+        // emissive surfaces without a light source can only be found by hitting them
+        const Light *light = vertex(0).light;
+        if (!light) {
+            return 1;
+        }
+
+        // the densities of sampling each vertex when tracing from the light source and from the camera, where
+        // paths starting on a light source that has been hit are weighted against emitting them from the light
+        thread_local std::vector<double> fromLight, fromCamera;
+        fromLight.resize(n);
+        fromCamera.resize(n);
+        for (int i = 0; i < n; i++) {
+            if (i < s) {
+                fromLight[i] = vertex(i).pdfForward;
+            } else if (i == 0) {
+                const Vector direction = (vertex(1).position() - vertex(0).position()).normalized();
+                fromLight[i] = m_scene->emissionProbability(light) * light->pdfEmission(vertex(0).its, direction).position;
+            } else if (i <= s + 1) {
+                fromLight[i] = pdfArea(i >= 2 ? &vertex(i - 2) : nullptr, vertex(i - 1), vertex(i));
+            } else {
+                fromLight[i] = vertex(i).pdfReverse;
+            }
+
+            if (i >= s) {
+                fromCamera[i] = vertex(i).pdfForward;
+            } else if (i >= s - 2) {
+                fromCamera[i] = pdfArea(i + 2 < n ? &vertex(i + 2) : nullptr, vertex(i + 1), vertex(i));
+            } else {
+                fromCamera[i] = vertex(i).pdfReverse;
+            }
+        }
+        const double direct = pdfDirect(vertex(0), vertex(1));
+
+        // light sources at infinity do not emit light subpaths
+        const bool emits = light->bounds().has_value();
+
+        // the density of each strategy is the product of the densities of its light and camera vertices, which are
+        // accumulated from both ends
+        thread_local std::vector<double> suffix;
+        suffix.resize(n + 1);
+        suffix[n] = 1;
+        for (int i = n - 1; i >= 0; i--) {
+            suffix[i] = suffix[i + 1] * fromCamera[i];
+        }
+
+        double prefix = 1, sum = 0, current = 0;
+        for (int r = 0; r < n; r++) {
+            double pdf = 0;
+            if (r == 0) {
+                pdf = light->canBeIntersected() ? suffix[0] : 0;
+            } else if (r == 1) {
+                pdf = n > 2 && !vertex(1).delta ? direct * suffix[1] : 0;
+            } else if (emits && !vertex(r - 1).delta && !vertex(r).delta &&
+                       (r < n - 1 || m_cameraConnections)) {
+                pdf = prefix * suffix[r];
+            }
+            if (r == s) {
+                current = pdf;
+            }
+            // squared in double precision, as the products of area densities of close vertices exceed the range of
+            // floats when squared
+            sum += pdf * pdf;
+            prefix *= fromLight[r];
+        }
+        return sum > 0 ? float(current * current / sum) : 0;
+    }
+
+    /**
+     * @brief Extends a subpath by tracing a ray and continuing from the surfaces it hits by sampling their BSDFs,
+     * until the subpath has reached a given number of vertices or is terminated.
+     * @param ray The ray leaving the last vertex of the subpath.
+     * @param weight The throughput of the subpath along the ray, which is updated as the subpath is extended.
+     * @param pdf The density (in solid angle) of having sampled the direction of the ray.
+     * @return Whether the subpath has left the scene, in which case @c ray holds the ray that escaped.
+     */
+    bool randomWalk(Ray &ray, Color &weight, float pdf, std::vector<Vertex> &path, int maxVertices, Sampler &rng) {
+        const float initialWeight = weight.maxComponent();
+        while (int(path.size()) < maxVertices) {
+            const Intersection its = m_scene->intersect(ray, rng);
+            if (!its) {
+                return true;
+            }
+
+            path.push_back({
+                .type = Vertex::Type::Surface,
+                .its = its,
+                .normal = its.frame.normal,
+                .weight = weight,
+                .light = its.instance->light(),
+                .delta = !its.instance->bsdf(),
+            });
+            Vertex &current = path.back();
+            Vertex &previous = path[path.size() - 2];
+            current.pdfForward = toArea(pdf, previous, current);
+            if (int(path.size()) == maxVertices) {
+                break;
+            }
+
+            const BsdfSample sample = its.sampleBsdf(rng);
+            if (sample.isInvalid()) {
+                break;
+            }
+
+            // the density of sampling the previous vertex when tracing in the opposite direction, where specular
+            // directions are assigned a density of one, as they appear in all strategies that sample them
+            current.delta = sample.pdf == Infinity;
+            float pdfReverse = 1;
+            if (!current.delta) {
+                Intersection reversed = its;
+                reversed.wo = sample.wi;
+                pdfReverse = reversed.evaluateBsdf(its.wo).pdf;
+            }
+            previous.pdfReverse = toArea(pdfReverse, current, previous);
+
+            weight *= sample.weight;
+            pdf = current.delta ? 1 : sample.pdf;
+
+            // Russian roulette, relative to the throughput the subpath started with
+            if (int(path.size()) > m_rouletteDepth) {
+                const float survivalProbability = std::min(weight.maxComponent() / initialWeight, 0.95f);
+                if (!(rng.next() < survivalProbability)) {
+                    break;
+                }
+                weight /= survivalProbability;
+            }
+
+            ray = Ray(its.position, sample.wi, int(path.size()) - 1);
+        }
+        return false;
+    }
+
+    /// @brief Computes the light a light subpath vertex sends to a camera subpath vertex (without weighting).
+    Color connect(const Vertex &lightVertex, const Vertex &cameraVertex, Sampler &rng) const {
+        const Vector direction = cameraVertex.position() - lightVertex.position();
+        const float distance = direction.length();
+        if (!(distance > 0)) {
+            return Color(0);
+        }
+        const Vector wi = direction / distance;
+
+        const BsdfEval lightBsdf = lightVertex.its.evaluateBsdf(wi);
+        if (lightBsdf.isInvalid()) {
+            return Color(0);
+        }
+        const BsdfEval cameraBsdf = cameraVertex.its.evaluateBsdf(-wi);
+        if (cameraBsdf.isInvalid()) {
+            return Color(0);
+        }
+        if (m_scene->intersect(Ray(lightVertex.position(), wi), distance, rng)) {
+            return Color(0);
+        }
+        // the BSDF values include the cosines, which leaves the inverse squared distance of the geometry term
+        return lightVertex.weight * lightBsdf.value * cameraBsdf.value * cameraVertex.weight / sqr(distance);
+    }
+
+    /**
+     * @brief Computes the light arriving at the last vertex of a camera subpath from a randomly sampled light source
+     * (i.e., a light subpath consisting of a single vertex), weighted against all other strategies.
+     */
+    Color connectLight(std::span<const Vertex> cameraPath, Sampler &rng) const {
+        if (!m_scene->hasLights()) {
+            return Color(0);
+        }
+        const Vertex &cameraVertex = cameraPath.back();
+        const LightSample ls = m_scene->sampleLight(cameraVertex.position(), rng);
+        if (ls.isInvalid()) {
+            return Color(0);
+        }
+        const DirectLightSample dls = ls.light->sampleDirect(cameraVertex.position(), rng);
+        if (dls.isInvalid()) {
+            return Color(0);
+        }
+        const BsdfEval bsdf = cameraVertex.its.evaluateBsdf(dls.wi);
+        if (bsdf.isInvalid()) {
+            return Color(0);
+        }
+        const Color contribution = cameraVertex.weight * bsdf.value * dls.weight / ls.probability;
+        const Ray ray(cameraVertex.position(), dls.wi);
+
+        if (!ls.light->bounds()) {
+            // light sources at infinity cannot emit light subpaths, which leaves hitting them as the only other strategy
+            if (m_scene->intersect(ray, dls.distance, rng)) {
+                return Color(0);
+            }
+            const float weight = ls.light->canBeIntersected()
+                ? powerHeuristic(ls.probability * dls.pdf, bsdf.pdf) : 1;
+            return weight * contribution;
+        }
+
+        Vertex lightVertex = {
+            .type = Vertex::Type::Light,
+            .its = Intersection(),
+            .normal = Vector(0),
+            .weight = Color(0),
+            .light = ls.light,
+        };
+        if (dls.pdf == Infinity) {
+            if (m_scene->intersect(ray, dls.distance, rng)) {
+                return Color(0);
+            }
+            lightVertex.its.position = ray(dls.distance);
+        } else if (ls.light->canBeIntersected()) {
+            // the point on the light source is found by intersecting it, which also tests its visibility
+            const Intersection its = m_scene->intersect(ray, rng);
+            if (!its || its.instance->light() != ls.light || its.t < dls.distance * (1 - 1e-3f)) {
+                return Color(0);
+            }
+            lightVertex.its = its;
+            lightVertex.normal = its.frame.normal;
+        } else {
+            // invisible area lights are only reached by emitting light subpaths from them
+            return Color(0);
+        }
+        lightVertex.pdfForward = m_scene->emissionProbability(ls.light) *
+                                 ls.light->pdfEmission(lightVertex.its, -dls.wi).position;
+
+        return misWeight(std::span(&lightVertex, 1), cameraPath) * contribution;
+    }
+
+    /// @brief Connects the last vertex of a light subpath to the camera, and splats its contribution onto the image.
+    void splat(std::span<const Vertex> lightPath, const Vertex &camera, Sampler &rng) {
+        const Vertex &lightVertex = lightPath.back();
+        const CameraConnection connection = m_scene->camera()->connect(lightVertex.position());
+        if (connection.isInvalid()) {
+            return;
+        }
+        const BsdfEval bsdf = lightVertex.its.evaluateBsdf(connection.wi);
+        if (bsdf.isInvalid()) {
+            return;
+        }
+        if (m_scene->intersect(Ray(lightVertex.position(), connection.wi), connection.distance, rng)) {
+            return;
+        }
+
+        const Color contribution = lightVertex.weight * bsdf.value * connection.weight *
+                                   misWeight(lightPath, std::span(&camera, 1));
+        const Vector2i &resolution = m_scene->camera()->resolution();
+        const Point2i pixel(std::clamp(int(connection.pixel.x()), 0, resolution.x() - 1),
+                            std::clamp(int(connection.pixel.y()), 0, resolution.y() - 1));
+        atomicAdd(m_splats[pixel.y() * resolution.x() + pixel.x()], contribution);
+    }
+
+public:
+    Bdpt(const Properties &properties)
+    : SamplingIntegrator(properties) {
+        m_depth = properties.get<int>("depth", 2);
+        m_rouletteDepth = properties.get<int>("rouletteDepth", 3);
+    }
+
+    void execute() override {
+        const Vector2i resolution = m_scene->camera()->resolution();
+        m_cameraConnections = m_scene->camera()->canBeConnected();
+        if (!m_cameraConnections) {
+            logger(EWarn, "the camera does not support connections, light subpaths will only be connected to camera "
+                          "subpaths");
+        }
+        const int samplesPerPixel = m_sampler->samplesPerPixel();
+        if (!renderSettings.coordinator.empty() || !renderSettings.region.isEmpty() || renderSettings.resume ||
+            renderSettings.sampleStart > 0 || (renderSettings.sampleEnd > 0 && renderSettings.sampleEnd < samplesPerPixel)) {
+            logger(EWarn, "light subpaths connected to the camera are not stored in films, which hence miss some "
+                          "light when renders are split up or resumed");
+        }
+        m_splats.assign(resolution.product(), Color(0));
+        m_lightPaths = 0;
+        SamplingIntegrator::execute();
+    }
+
+    void finishImage() override {
+        // every light subpath contributes to the entire image, whose importance is normalized over all pixels
+        if (m_lightPaths == 0) {
+            return;
+        }
+        const Vector2i resolution = m_scene->camera()->resolution();
+        const float scale = float(resolution.product()) / float(m_lightPaths);
+        for (auto pixel : m_image->bounds()) {
+            m_image->get(pixel) += scale * m_splats[pixel.y() * resolution.x() + pixel.x()];
+        }
+    }
+
+    Color Li(const Ray &ray, Sampler &rng) override {
+        thread_local std::vector<Vertex> cameraPath, lightPath;
+
+        // the camera subpath has up to one vertex more than the paths have segments
+        cameraPath.clear();
+        cameraPath.push_back({
+            .type = Vertex::Type::Camera,
+            .its = Intersection(-ray.direction),
+            .normal = Vector(0),
+            .weight = Color(1),
+            .pdfForward = 1,
+        });
+        cameraPath.back().its.position = ray.origin;
+        Ray cameraRay = ray;
+        const float cameraPdf = m_cameraConnections ? m_scene->camera()->pdfDirection(ray.direction) : 1;
+        Color cameraWeight(1);
+        const bool escaped = randomWalk(cameraRay, cameraWeight, cameraPdf, cameraPath, m_depth + 1, rng);
+
+        // the light subpath needs one segment less, as it is connected to the camera subpath
+        lightPath.clear();
+        const EmissionSample emission = m_scene->sampleEmission(rng);
+        if (!m_previewing) {
+            m_lightPaths++;
+        }
+        if (!emission.isInvalid() && emission.light->bounds()) {
+            // the throughput of light vertices is not needed, as their connections are handled by light sampling
+            Vertex lightVertex = {
+                .type = Vertex::Type::Light,
+                .its = Intersection(),
+                .normal = emission.normal,
+                .weight = Color(0),
+                .light = emission.light,
+                .pdfForward = m_scene->emissionProbability(emission.light) * emission.pdf.position,
+            };
+            lightVertex.its.position = emission.ray.origin;
+            lightVertex.its.pdf = emission.pdf.position;
+            if (!emission.normal.isZero()) {
+                lightVertex.its.frame = Frame(emission.normal);
+            }
+            lightPath.push_back(lightVertex);
+            Ray lightRay = emission.ray;
+            Color lightWeight = emission.weight;
+            randomWalk(lightRay, lightWeight, emission.pdf.direction, lightPath, m_depth, rng);
+        }
+
+        Color result(0);
+        for (int t = 1; t <= int(cameraPath.size()); t++) {
+            const std::span<const Vertex> cameraVertices = std::span(cameraPath).first(t);
+            const Vertex &cameraVertex = cameraPath[t - 1];
+            // light sampling (s = 1) does not need the light subpath, which is empty for light sources at infinity
+            for (int s = 0; s <= std::max(int(lightPath.size()), 1) && s + t - 1 <= m_depth; s++) {
+                if (t == 1) {
+                    // the camera can only be reached by connecting to it
+                    // (light subpaths of previews are not splatted, as they repeat those of the first sample)
+                    if (s >= 2 && m_cameraConnections && !m_previewing && !lightPath[s - 1].delta) {
+                        splat(std::span(lightPath).first(s), cameraVertex, rng);
+                    }
+                } else if (s == 0) {
+                    // the camera subpath has hit a light source
+                    const Color emission = cameraVertex.its.evaluateEmission();
+                    if (emission != Color(0)) {
+                        result += cameraVertex.weight * emission * misWeight({}, cameraVertices);
+                    }
+                } else if (cameraVertex.delta) {
+                    continue;
+                } else if (s == 1) {
+                    result += connectLight(cameraVertices, rng);
+                } else if (!lightPath[s - 1].delta) {
+                    const Color contribution = connect(lightPath[s - 1], cameraVertex, rng);
+                    if (contribution != Color(0)) {
+                        result += contribution * misWeight(std::span(lightPath).first(s), cameraVertices);
+                    }
+                }
+            }
+        }
+
+        // light sources at infinity are found by camera subpaths leaving the scene or by light sampling
+        if (escaped && int(cameraPath.size()) <= m_depth) {
+            const Vertex &last = cameraPath.back();
+            Color background = m_scene->evaluateBackground(cameraRay.direction).value;
+            const BackgroundLight *light = m_scene->background();
+            if (light && m_scene->hasLights() && last.type == Vertex::Type::Surface && !last.delta) {
+                const float bsdfPdf = last.its.evaluateBsdf(cameraRay.direction).pdf;
+                background *= powerHeuristic(bsdfPdf, m_scene->lightSelectionProbability(light, last.position()) *
+                                                          light->pdfDirect(cameraRay.direction));
+            }
+            result += cameraWeight * background;
+        }
+
+        return result;
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "Bdpt[\n"
+            "  sampler = %s,\n"
+            "  image = %s,\n"
+            "  depth = %d,\n"
+            "  rouletteDepth = %d,\n"
+            "]",
+            indent(m_sampler),
+            indent(m_image),
+            m_depth,
+            m_rouletteDepth
+        );
+    }
+};
+
+}
+
+REGISTER_INTEGRATOR(Bdpt, "bdpt")
@@ -9,10 +9,10 @@ class DirectIntegretor : public SamplingIntegrator {
         }
 
         // Sample random light source in the scene and sample point on selected light source
-        const LightSample ls = this->m_scene->sampleLight(rng);
+        const LightSample ls = this->m_scene->sampleLight(its.position, rng);
 
         // If light can be intersected, don't count it (since it will be hit by the ray already)
-        if (ls.light->canBeIntersected()) {
+        if (ls.isInvalid() || ls.light->canBeIntersected()) {
             return Color(0.0f);
         }
 
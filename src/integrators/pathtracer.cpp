@@ -1,43 +1,272 @@
 #include <lightwave.hpp>
 
+#include "radiancecache.hpp"
+#include "sdtree.hpp"
+
 namespace lightwave {
 class Pathtracer : public SamplingIntegrator {
 
     int m_depth;
-    
-    Color calculateLight(Intersection &its, Sampler &rng) {
+    /// @brief The number of bounces after which paths are terminated randomly based on their throughput (Russian roulette).
+    int m_rouletteDepth;
+
+    /// @brief Whether directions are also sampled from a distribution of incident light learned before rendering
+    /// (path guiding), combined with BSDF sampling by one-sample MIS.
+    bool m_guiding;
+    /// @brief The number of training passes for path guiding, which take one, two, four, ... samples per pixel.
+    int m_trainingPasses;
+    /// @brief The probability of sampling the BSDF instead of the learned distribution when guiding.
+    float m_bsdfSamplingFraction;
+    /// @brief The number of samples (scaled by the square root of the samples per pass) above which regions of
+    /// space are split.
+    float m_spatialThreshold;
+    /// @brief The fraction of the energy of a directional distribution above which its cells are refined.
+    float m_energyThreshold;
+    /// @brief The learned distributions of incident light, if path guiding is enabled.
+    ref<SDTree> m_guide;
+    /// @brief Whether paths record the light they find into @ref m_guide (during training).
+    bool m_recording = false;
+
+    /// @brief Whether paths are terminated at diffuse surfaces after their first non-specular bounce, using the light
+    /// cached there by a pre-pass instead of tracing it.
+    bool m_radianceCache;
+    /// @brief The number of samples per pixel of the pre-pass that fills the radiance cache.
+    int m_cachePasses;
+    /// @brief The number of cells of the radiance cache along the longest axis of the scene, where coarser cells
+    /// blur the cached light further (bias) but receive more samples (noise).
+    int m_cacheResolution;
+    /// @brief The number of samples a cell of the radiance cache needs before it is used.
+    int m_cacheMinSamples;
+    /// @brief The memory of the radiance cache in megabytes.
+    int m_cacheMemory;
+    /// @brief The radiance cache, if enabled.
+    ref<RadianceCache> m_cache;
+    /// @brief Whether paths record the light they find into @ref m_cache (during the pre-pass), in which case the
+    /// cache is not used to terminate them.
+    bool m_fillingCache = false;
+
+    /// @brief The index of the next sample that has not been taken by the image or any pre-pass, so that the
+    /// samples of pre-passes are independent of those of the image.
+    int m_nextSampleIndex;
+
+    /// @brief A vertex of a path whose incident light is recorded for path guiding.
+    struct GuidingVertex {
+        Point position;
+        /// @brief The direction that has been sampled at the vertex.
+        Vector wi;
+        /// @brief The density of having sampled @c wi .
+        float pdf;
+        /// @brief The throughput of the path after the vertex, by which the light found later on is divided.
+        Color weight;
+        /// @brief The light found before continuing the path from the vertex.
+        Color lightBefore;
+    };
+
+    /// @brief A vertex of a path on a diffuse surface whose reflected light is recorded into the radiance cache.
+    struct CacheVertex {
+        Point position;
+        /// @brief The surface normal, facing the side the vertex is seen from.
+        Vector normal;
+        /// @brief The throughput of the path up to the vertex times the albedo, by which the light found later on is
+        /// divided.
+        Color weight;
+        /// @brief The light found before light sampling at the vertex.
+        Color lightBefore;
+    };
+
+    /// @brief Combines the density of sampling a direction from the BSDF and from the learned distribution.
+    float guidedPdf(const DTree *guide, float bsdfPdf, const Vector &wi) const {
+        if (!guide) {
+            return bsdfPdf;
+        }
+        return m_bsdfSamplingFraction * bsdfPdf + (1 - m_bsdfSamplingFraction) * guide->pdf(wi);
+    }
+
+    /**
+     * @brief Samples the direction a path continues in, which is taken from the BSDF or (if guiding) from the
+     * learned distribution, and weighted by the density of the mixture of both (one-sample MIS).
+     * Specular BSDFs cannot be guided and are always sampled directly.
+     */
+    BsdfSample sampleDirection(const Intersection &its, const DTree *guide, Sampler &rng) const {
+        BsdfSample sample = its.sampleBsdf(rng);
+        if (!guide || sample.pdf == Infinity) {
+            return sample;
+        }
+
+        if (rng.next() < m_bsdfSamplingFraction) {
+            const float pdf = sample.isInvalid() ? 0 : guidedPdf(guide, sample.pdf, sample.wi);
+            if (!(pdf > 0)) {
+                return BsdfSample::invalid();
+            }
+            sample.weight *= sample.pdf / pdf;
+            sample.pdf = pdf;
+            return sample;
+        }
+
+        // the learned distribution covers the whole sphere, while the BSDFs that can be guided only reflect light
+        // (some of which do not check that both directions lie on the same side)
+        const Vector wi = guide->sample(rng);
+        if (its.frame.normal.dot(wi) <= 0) {
+            return BsdfSample::invalid();
+        }
+        const BsdfEval bsdf = its.evaluateBsdf(wi);
+        const float pdf = guidedPdf(guide, bsdf.pdf, wi);
+        if (bsdf.isInvalid() || !(pdf > 0)) {
+            return BsdfSample::invalid();
+        }
+        return {
+            .wi = wi,
+            .weight = bsdf.value / pdf,
+            .pdf = pdf,
+        };
+    }
+
+    /// @brief Traces paths over the whole image whose results are discarded, which is used by pre-passes that
+    /// learn from the light the paths find.
+    void tracePass(int samples) {
+        const Vector2i resolution = m_scene->camera()->resolution();
+        std::vector<ref<Sampler>> samplers(threadCount());
+        for (auto &sampler : samplers) {
+            sampler = m_sampler->clone();
+        }
+
+        const int sampleIndex = m_nextSampleIndex;
+        for_each_parallel(BlockSpiral(resolution, Vector2i(64)), [&](auto block) {
+            Sampler &rng = *samplers[threadIndex()];
+            for (auto pixel : block) {
+                for (int sample = 0; sample < samples; sample++) {
+                    rng.seed(pixel, sampleIndex + sample);
+                    const CameraSample cameraSample = m_scene->camera()->sample(pixel, rng);
+                    Li(cameraSample.ray, rng);
+                }
+            }
+        });
+        m_nextSampleIndex += samples;
+    }
+
+    /// @brief Trains the distributions used for path guiding in passes over the whole image, whose samples are
+    /// only used for learning.
+    void trainGuiding() {
+        m_guide = std::make_shared<SDTree>(m_scene->getBoundingBox());
+
+        m_recording = true;
+        for (int pass = 0; pass < m_trainingPasses && !renderSettings.interrupted; pass++) {
+            const int samples = 1 << pass;
+            logger(EInfo, "training path guiding with %d samples per pixel (%d regions)", samples,
+                   m_guide->leafCount());
+            tracePass(samples);
+            m_guide->refine(pass, m_spatialThreshold, m_energyThreshold);
+        }
+        m_recording = false;
+    }
+
+    /// @brief Fills the radiance cache with the light reflected at the diffuse surfaces that paths of a pre-pass
+    /// visit, which (unlike the paths of the image) are not terminated by the cache.
+    void fillRadianceCache() {
+        m_cache = std::make_shared<RadianceCache>(m_scene->getBoundingBox(), m_cacheResolution,
+                                                  size_t(m_cacheMemory) << 20);
+        logger(EInfo, "filling radiance cache with %d samples per pixel (%d MB)", m_cachePasses,
+               int(m_cache->memory() >> 20));
+
+        m_fillingCache = true;
+        tracePass(m_cachePasses);
+        m_fillingCache = false;
+        logger(EInfo, "radiance cache holds %d cells", m_cache->cellCount());
+    }
+
+    /// @brief Returns whether the BSDF at an intersection is diffuse, so that its reflected light can be cached.
+    static bool isDiffuse(const Intersection &its) {
+        return its.instance->bsdf() && its.instance->bsdf()->isDiffuse();
+    }
+
+    /**
+     * @brief Computes the light arriving at the intersection from a randomly sampled light source, weighted against
+     * hitting the light source through BSDF sampling (multiple importance sampling).
+     */
+    Color calculateLight(Intersection &its, const DTree *guide, Sampler &rng) {
         if (not this->m_scene->hasLights()) {
             return Color(0.0f);
         }
 
-        // Sample random light source in the scene and sample point on selected light source
-        const LightSample ls = this->m_scene->sampleLight(rng);
-
-        // If light can be intersected, don't count it (since it will be hit by the ray already)
-        if (ls.light->canBeIntersected()) {
+        // surfaces without a BSDF pass rays straight through, so light arriving there is found by continuing the path
+        if (its.instance->bsdf() == nullptr) {
             return Color(0.0f);
         }
 
+        // Sample random light source in the scene and sample point on selected light source
+        const LightSample ls = this->m_scene->sampleLight(its.position, rng);
+        if (ls.isInvalid()) {
+            return Color(0.0f);
+        }
         const DirectLightSample dls = ls.light->sampleDirect(its.position, rng);
+        if (dls.isInvalid()) {
+            return Color(0.0f);
+        }
+
+        const BsdfEval bsdf_sample = its.evaluateBsdf(dls.wi);
+        if (bsdf_sample.isInvalid()) {
+            return Color(0.0f);
+        }
 
         // Check if light source is blocked for intersection
         if (this->m_scene->intersect(Ray(its.position, dls.wi), dls.distance, rng)) {
             return Color(0.0f);
         }
 
-        const BsdfEval bsdf_sample = its.evaluateBsdf(dls.wi);
+        // Light sources that cannot be hit by rays are only found by light sampling, and receive the full weight
+        const float weight = ls.light->canBeIntersected()
+            ? powerHeuristic(ls.probability * dls.pdf, guidedPdf(guide, bsdf_sample.pdf, dls.wi)) : 1;
 
-        Color contribution = (dls.weight * bsdf_sample.value) / ls.probability;
+        Color contribution = weight * (dls.weight * bsdf_sample.value) / ls.probability;
 
         return contribution;
     }
 
+    /**
+     * @brief Computes the weight of light emitted by a light source that has been hit by a ray sampled from a BSDF,
+     * which could also have been found by light sampling.
+     * @param light The light source that has been hit (or null if the emitting surface is not a light source).
+     * @param origin The origin of the ray that hit the light source.
+     * @param lightPdf The density of sampling the hit point on the light source, given the light has been selected.
+     * @param bsdfPdf The density of the BSDF sample that hit the light source.
+     */
+    float emissionWeight(const Light *light, const Point &origin, float lightPdf, float bsdfPdf) const {
+        if (!light) {
+            return 1;
+        }
+        return powerHeuristic(bsdfPdf, m_scene->lightSelectionProbability(light, origin) * lightPdf);
+    }
+
 public:
     Pathtracer(const Properties &properties)
     : SamplingIntegrator(properties) {
         // to parse properties from the scene description, use properties.get(name, default_value)
         // you can also omit the default value if you want to require the user to specify a value
         m_depth = properties.get<int>("depth", 2);
+        m_rouletteDepth = properties.get<int>("rouletteDepth", 3);
+        m_guiding = properties.get<bool>("guiding", false);
+        m_trainingPasses = properties.get<int>("trainingPasses", 5);
+        m_bsdfSamplingFraction = std::clamp(properties.get<float>("bsdfSamplingFraction", 0.5f), 0.f, 1.f);
+        m_spatialThreshold = properties.get<float>("spatialThreshold", 12000);
+        m_energyThreshold = properties.get<float>("energyThreshold", 0.01f);
+        m_radianceCache = properties.get<bool>("radianceCache", false);
+        m_cachePasses = properties.get<int>("cachePasses", 4);
+        m_cacheResolution = properties.get<int>("cacheResolution", 32);
+        m_cacheMinSamples = properties.get<int>("cacheMinSamples", 16);
+        m_cacheMemory = properties.get<int>("cacheMemory", 64);
+    }
+
+    void execute() override {
+        // the samples of pre-passes follow those of the final image, so that both are independent
+        m_nextSampleIndex = m_sampler->samplesPerPixel();
+        if (m_guiding) {
+            trainGuiding();
+        }
+        // the cache is filled after training, so that its paths already benefit from guiding
+        if (m_radianceCache && !renderSettings.interrupted) {
+            fillRadianceCache();
+        }
+        SamplingIntegrator::execute();
     }
 
     /**
@@ -51,64 +280,167 @@ public:
         Color accumulatedWeight = Color(1.f);
         Ray currentRay = ray;
 
+        // the density of the BSDF sample that generated the current ray, where camera rays can only be found by
+        // following the path and hence are treated like samples of specular BSDFs
+        float bsdfPdf = Infinity;
+        // the origin of the current ray, for which the density of light sampling is computed when a light is hit
+        Point previousPosition = ray.origin;
+
+        // the vertices whose incident light is recorded once the path is complete (while training path guiding)
+        thread_local std::vector<GuidingVertex> guidingVertices;
+        guidingVertices.clear();
+        // the vertex whose reflected light is recorded once the path is complete (while filling the radiance cache)
+        std::optional<CacheVertex> cacheVertex;
+
         for (int i = 0; i < m_depth; i++) {
             DEBUG_PIXEL_LOG("[Pathtracer](i=%d) ray=(o=%s d=%s)", i, currentRay.origin, currentRay.direction);
-            
+
             // intersect the ray with the scene
             Intersection its = m_scene->intersect(currentRay, rng, this->m_depth);
 
             // if no intersection occured
             if (!its) {
                 Color backgroundLight = (m_scene->evaluateBackground(currentRay.direction)).value;
+                if (const BackgroundLight *background = m_scene->background(); background && m_scene->hasLights()) {
+                    backgroundLight *= emissionWeight(background, previousPosition, background->pdfDirect(currentRay.direction), bsdfPdf);
+                }
                 accumulatedLight += accumulatedWeight * backgroundLight;
                 break;
             }
 
             DEBUG_PIXEL_LOG("[Pathtracer](i=%d) Intersection: pos=%s wo=%s t=%f object=%s", i, its.position, its.wo, its.t, its.instance->id());
-            
-            // sample the bsdf for a new bounce and weight
-            BsdfSample sample = its.sampleBsdf(rng);
 
-            // get emissions of intersection
+            // get emissions of intersection, weighted against having sampled it through next event estimation
             Color emissions = its.evaluateEmission();
+            if (emissions != Color(0.f) && its.instance->light()) {
+                const Light *light = its.instance->light();
+                emissions *= emissionWeight(light, previousPosition, light->pdfDirect(previousPosition, its), bsdfPdf);
+            }
+            accumulatedLight += accumulatedWeight * emissions;
 
-            // next event estimation to evaluate light
-            Color lightContribution = calculateLight(its, rng);
-
-            // update accumulated light and weigt
+            // the path ends here, so neither light sampling nor bsdf sampling are needed
             if (i == m_depth-1) {
-                lightContribution = Color(0.f);
+                break;
             }
-            accumulatedLight += accumulatedWeight * (emissions + lightContribution);
-            accumulatedWeight *= sample.weight;   
-            
+
+            // diffuse surfaces reflect the light cached for them once the path has bounced off a non-specular
+            // surface (which blurs the error of the cache), while purely specular paths keep sharp reflections.
+            // The pre-pass records the same vertices (only the first of each path, where paths are terminated), so
+            // that cached light has been found with as many remaining bounces as the paths it replaces
+            if (m_cache && i > 0 && bsdfPdf < Infinity && isDiffuse(its)) {
+                const Vector normal = its.frame.normal.dot(its.wo) >= 0 ? its.frame.normal : -its.frame.normal;
+                const Color albedo = its.getAlbedo();
+                if (m_fillingCache) {
+                    if (!cacheVertex) {
+                        cacheVertex = CacheVertex {
+                            .position = its.position,
+                            .normal = normal,
+                            .weight = accumulatedWeight * albedo,
+                            .lightBefore = accumulatedLight,
+                        };
+                    }
+                } else if (const auto cached = m_cache->lookup(its.position, normal, m_cacheMinSamples)) {
+                    accumulatedLight += accumulatedWeight * albedo * *cached;
+                    break;
+                }
+            }
+
+            // guiding is limited to the front side of surfaces, as some BSDFs sample but do not evaluate the back side
+            const DTree *guide = m_guide && its.frame.normal.dot(its.wo) > 0 ? m_guide->samplingTree(its.position)
+                                                                            : nullptr;
+
+            // next event estimation to evaluate light
+            accumulatedLight += accumulatedWeight * calculateLight(its, guide, rng);
+
+            // sample the bsdf (or the learned incident light) for a new bounce and weight
+            BsdfSample sample = sampleDirection(its, guide, rng);
+
             // If we get an invalid sample, simply break out of loop
             if (sample.isInvalid()) {
                 break;
-            }      
+            }
+
+            accumulatedWeight *= sample.weight;
+            bsdfPdf = sample.pdf;
+            previousPosition = its.position;
+
+            // vertices are recorded before Russian roulette (with the weight before boosting), as recording only
+            // surviving paths would underweight the directions that guiding favors (due to their lower throughput)
+            if (m_recording && sample.pdf < Infinity) {
+                guidingVertices.push_back({
+                    .position = its.position,
+                    .wi = sample.wi,
+                    .pdf = sample.pdf,
+                    .weight = accumulatedWeight,
+                    .lightBefore = accumulatedLight,
+                });
+            }
+
+            // Russian roulette: terminate paths with low throughput randomly, and boost the surviving ones accordingly
+            if (i + 1 >= m_rouletteDepth) {
+                const float survivalProbability = std::min(accumulatedWeight.maxComponent(), 0.95f);
+                if (rng.next() >= survivalProbability) {
+                    break;
+                }
+                accumulatedWeight /= survivalProbability;
+            }
 
             // update variables for next iteration
             currentRay = Ray(its.position, sample.wi, i+1);
-        }  
+        }
+
+        // the light arriving at a vertex from the sampled direction is the light found afterwards, relative to the
+        // throughput after the vertex
+        for (const GuidingVertex &vertex : guidingVertices) {
+            const Color light = accumulatedLight - vertex.lightBefore;
+            float radiance = 0;
+            for (int channel = 0; channel < light.NumComponents; channel++) {
+                if (vertex.weight[channel] > 0) {
+                    radiance += light[channel] / vertex.weight[channel] / light.NumComponents;
+                }
+            }
+            // vertices that found no light are recorded as well, as they count towards the samples of their region
+            m_guide->record(vertex.position, vertex.wi, std::isfinite(radiance) ? radiance / vertex.pdf : 0);
+        }
+
+        // the light reflected at a vertex is the light found afterwards, relative to the throughput and albedo there.
+        // Paths that carry no light in some channel (e.g., after a colored wall) would record darkness for it, while
+        // the light a diffuse surface reflects does not depend on the path that reached it, so they are skipped
+        if (cacheVertex) {
+            bool carriesAllChannels = true;
+            for (int channel = 0; channel < cacheVertex->weight.NumComponents; channel++) {
+                carriesAllChannels &= cacheVertex->weight[channel] > 0;
+            }
+            const Color radiance = (accumulatedLight - cacheVertex->lightBefore) / cacheVertex->weight;
+            if (carriesAllChannels && std::isfinite(radiance.mean())) {
+                m_cache->record(cacheVertex->position, cacheVertex->normal, radiance);
+            }
+        }
 
         return accumulatedLight;
     }
 
-    /// @brief An optional textual representation of this class, which can be useful for debugging. 
+    /// @brief An optional textual representation of this class, which can be useful for debugging.
     std::string toString() const override {
         return tfm::format(
             "Pathtracer[\n"
             "  sampler = %s,\n"
             "  image = %s,\n"
             "  depth = %s,\n"
+            "  rouletteDepth = %s,\n"
+            "  guiding = %s,\n"
+            "  radianceCache = %s,\n"
             "]",
             indent(m_sampler),
             indent(m_image),
-            indent(m_depth)
+            indent(m_depth),
+            indent(m_rouletteDepth),
+            indent(m_guiding),
+            indent(m_radianceCache)
         );
     }
 };
 
 }
 
-REGISTER_INTEGRATOR(Pathtracer, "pathtracer")
\ No newline at end of file
+REGISTER_INTEGRATOR(Pathtracer, "pathtracer")
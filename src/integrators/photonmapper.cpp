@@ -0,0 +1,415 @@
+#include <lightwave.hpp>
+
+#include <bit>
+#include <chrono>
+#include <numeric>
+
+namespace lightwave {
+
+/**
+ * @brief Renders caustics and other indirect light using stochastic progressive photon mapping (Hachisuka and Jensen
+ * 2009), which converges to the correct result with an increasing number of passes.
+ *
+ * Each pass traces a fixed number of photons from the light sources and a single camera path per pixel. Camera paths
+ * follow specular surfaces (i.e., BSDFs that sample Dirac delta lobes) until they reach a non-specular surface, the
+ * visible point of the pixel. Direct light at the visible point is found by light sampling, while indirect light is
+ * estimated from the photons within a radius around it. The radius of each pixel shrinks with every pass in which it
+ * receives photons, and the photons of a pass are discarded once it has been gathered, so that the memory used is
+ * bounded by the number of photons per pass.
+ *
+ * The photons of a pass are stored in a hashed grid, which is built using a parallel counting sort of the photons by
+ * their cell, so that the photons of each cell lie next to each other in memory.
+ *
+ * @example
+ * @code
+ *   <integrator type="photonmapper" depth="8" photons="200000" radius="0.01" alpha="0.7">
+ * @endcode
+ * where the number of passes is given by the sample count of the sampler.
+ */
+class PhotonMapper : public SamplingIntegrator {
+    /// @brief A photon that has arrived at a non-specular surface.
+    struct Photon {
+        /// @brief The position at which the photon has arrived.
+        Point position;
+        /// @brief The direction the photon came from, pointing away from the surface.
+        Vector wi;
+        /// @brief The power carried by the photon.
+        Color power;
+    };
+
+    /// @brief The statistics of a pixel that are accumulated over all passes.
+    struct PixelState {
+        /// @brief The radius within which photons are gathered around the visible points of the pixel.
+        float radius;
+        /// @brief The (fractional) number of photons that the current estimate is based on.
+        float photonCount = 0;
+        /// @brief The flux of the photons that have been gathered, scaled to the current radius.
+        Color flux = Color(0);
+        /// @brief The sum of the light found by the camera paths of all passes (emission and direct light).
+        Color direct = Color(0);
+    };
+
+    /// @brief The maximum number of bounces of camera paths through specular surfaces, where photons bounce one time
+    /// less, so that paths via diffuse surfaces have the same maximum length as with the path tracer.
+    int m_depth;
+    /// @brief The number of bounces after which photons are terminated randomly based on their throughput.
+    int m_rouletteDepth;
+    /// @brief The number of photons emitted in each pass.
+    int m_photonsPerPass;
+    /// @brief The radius within which photons are gathered in the first pass, or zero to derive it from the size of
+    /// the scene.
+    float m_initialRadius;
+    /// @brief The fraction of new photons that is kept in each pass, which controls how fast radii shrink.
+    float m_alpha;
+
+    /// @brief The photons stored in the current pass, in the order they have been traced.
+    std::vector<Photon> m_photons;
+    /// @brief The number of valid entries of @ref m_photons .
+    std::atomic<int> m_photonCount;
+    /// @brief The entry of the hash table that each photon of @ref m_photons belongs to.
+    std::vector<uint32_t> m_photonCells;
+    /// @brief The photons of the current pass, sorted by the entry of the hash table they belong to.
+    std::vector<Photon> m_sortedPhotons;
+    /// @brief The index of the first photon of each entry of the hash table within @ref m_sortedPhotons , followed by
+    /// the number of photons.
+    std::vector<uint32_t> m_cellStarts;
+    /// @brief The position each entry of the hash table is filled at while sorting the photons.
+    std::vector<uint32_t> m_cellCursors;
+    /// @brief The edge length of the cells of the grid, which is no smaller than the diameter of any sphere photons
+    /// are gathered within.
+    float m_cellSize;
+
+    /// @brief Returns the cell of the grid that contains a point.
+    Vector3i cellOf(const Point &point) const {
+        return Vector3i(int(std::floor(point.x() / m_cellSize)), int(std::floor(point.y() / m_cellSize)),
+                        int(std::floor(point.z() / m_cellSize)));
+    }
+
+    /// @brief Returns the entry of the hash table that a cell of the grid belongs to.
+    uint32_t cellHash(const Vector3i &cell) const {
+        const uint32_t hash = (uint32_t(cell.x()) * 73856093u) ^ (uint32_t(cell.y()) * 19349663u) ^
+                              (uint32_t(cell.z()) * 83492791u);
+        return hash & uint32_t(m_cellStarts.size() - 2);
+    }
+
+    /// @brief Traces the photons of a pass from the light sources, and stores them at every non-specular surface
+    /// they arrive at after at least one bounce (direct light is found by light sampling instead).
+    void tracePhotons(int pass, std::vector<ref<Sampler>> &samplers) {
+        m_photonCount = 0;
+        for_each_parallel(ChunkedRange(m_photonsPerPass, 1024), [&](const Range &range) {
+            Sampler &rng = *samplers[threadIndex()];
+            for (int index : range) {
+                // photons are numbered consecutively over all passes, which gives every photon its own sequence for
+                // any sampler (pixel seeds are not unique for pixels far outside of the image, e.g., for zsobol)
+                rng.seed(int(uint32_t(pass) * uint32_t(m_photonsPerPass) + uint32_t(index)));
+                const EmissionSample emission = m_scene->sampleEmission(rng);
+                if (emission.isInvalid()) {
+                    continue;
+                }
+
+                Color weight = emission.weight;
+                Ray ray = emission.ray;
+                for (int depth = 0; depth < m_depth - 1; depth++) {
+                    const Intersection its = m_scene->intersect(ray, rng, m_depth);
+                    if (!its) {
+                        break;
+                    }
+
+                    const BsdfSample sample = its.sampleBsdf(rng);
+                    if (depth > 0 && sample.pdf < Infinity) {
+                        m_photons[m_photonCount++] = {
+                            .position = its.position,
+                            .wi = its.wo,
+                            .power = weight,
+                        };
+                    }
+                    if (sample.isInvalid()) {
+                        break;
+                    }
+
+                    weight *= sample.weight;
+                    if (depth + 1 >= m_rouletteDepth) {
+                        const float survivalProbability = std::min(sample.weight.maxComponent(), 0.95f);
+                        if (rng.next() >= survivalProbability) {
+                            break;
+                        }
+                        weight /= survivalProbability;
+                    }
+                    ray = Ray(its.position, sample.wi, depth + 1);
+                }
+            }
+        });
+    }
+
+    /// @brief Sorts the photons of the current pass into the hashed grid, using a parallel counting sort.
+    void buildGrid(float cellSize) {
+        m_cellSize = cellSize;
+        const int photonCount = m_photonCount;
+        std::fill(m_cellStarts.begin(), m_cellStarts.end(), 0);
+
+        // count the photons of each entry, which are stored one entry later to be turned into offsets
+        for_each_parallel(ChunkedRange(photonCount, 4096), [&](const Range &range) {
+            for (int index : range) {
+                const uint32_t cell = cellHash(cellOf(m_photons[index].position));
+                m_photonCells[index] = cell;
+                std::atomic_ref<uint32_t>(m_cellStarts[cell + 1]).fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+        std::partial_sum(m_cellStarts.begin(), m_cellStarts.end(), m_cellStarts.begin());
+
+        // move each photon to the next free position of its entry
+        std::copy(m_cellStarts.begin(), m_cellStarts.end() - 1, m_cellCursors.begin());
+        for_each_parallel(ChunkedRange(photonCount, 4096), [&](const Range &range) {
+            for (int index : range) {
+                const uint32_t position =
+                    std::atomic_ref<uint32_t>(m_cellCursors[m_photonCells[index]]).fetch_add(1, std::memory_order_relaxed);
+                m_sortedPhotons[position] = m_photons[index];
+            }
+        });
+    }
+
+    /**
+     * @brief Sums the photons within a radius around a visible point, weighted by the BSDF of the visible point.
+     * @param photonCount Receives the number of photons that have been found.
+     */
+    Color gatherPhotons(const Intersection &its, float radius, int &photonCount) const {
+        Color flux = Color(0);
+        photonCount = 0;
+
+        // as cells are at least as large as the diameter, the photons lie in at most two cells along each axis, whose
+        // entries in the hash table might coincide (in which case they are only visited once). The last cell is
+        // clamped, so that rounding of the cell coordinates cannot exceed the eight cells that are tracked
+        const Vector3i cellMin = cellOf(its.position - Vector(radius));
+        Vector3i cellMax = cellOf(its.position + Vector(radius));
+        for (int dim = 0; dim < 3; dim++) {
+            cellMax[dim] = std::min(cellMax[dim], cellMin[dim] + 1);
+        }
+        uint32_t visited[8];
+        int visitedCount = 0;
+        for (int z = cellMin.z(); z <= cellMax.z(); z++) {
+            for (int y = cellMin.y(); y <= cellMax.y(); y++) {
+                for (int x = cellMin.x(); x <= cellMax.x(); x++) {
+                    const uint32_t cell = cellHash(Vector3i(x, y, z));
+                    if (std::find(visited, visited + visitedCount, cell) != visited + visitedCount) {
+                        continue;
+                    }
+                    visited[visitedCount++] = cell;
+
+                    for (uint32_t index = m_cellStarts[cell]; index < m_cellStarts[cell + 1]; index++) {
+                        const Photon &photon = m_sortedPhotons[index];
+                        if ((photon.position - its.position).lengthSquared() > sqr(radius)) {
+                            continue;
+                        }
+
+                        // the BSDF is evaluated without the cosine, as photons already carry the flux per area
+                        const float cosTheta = Frame::absCosTheta(its.frame.toLocal(photon.wi));
+                        const BsdfEval bsdf = its.evaluateBsdf(photon.wi);
+                        if (cosTheta > 0 && !bsdf.isInvalid()) {
+                            flux += bsdf.value / cosTheta * photon.power;
+                        }
+                        photonCount++;
+                    }
+                }
+            }
+        }
+        return flux;
+    }
+
+    /// @brief Computes the light arriving at a visible point from a randomly sampled light source.
+    Color calculateLight(const Intersection &its, Sampler &rng) const {
+        if (not m_scene->hasLights()) {
+            return Color(0.0f);
+        }
+
+        const LightSample ls = m_scene->sampleLight(its.position, rng);
+        if (ls.isInvalid()) {
+            return Color(0.0f);
+        }
+        const DirectLightSample dls = ls.light->sampleDirect(its.position, rng);
+        if (dls.isInvalid()) {
+            return Color(0.0f);
+        }
+
+        const BsdfEval bsdf = its.evaluateBsdf(dls.wi);
+        if (bsdf.isInvalid() || m_scene->intersect(Ray(its.position, dls.wi), dls.distance, rng)) {
+            return Color(0.0f);
+        }
+
+        // camera paths end at visible points, so light sampling is the only technique that finds direct light
+        return dls.weight * bsdf.value / ls.probability;
+    }
+
+    /**
+     * @brief Follows a camera ray through specular surfaces until it reaches a non-specular surface.
+     * @param visiblePoint Receives the non-specular surface that has been reached, if any.
+     * @param weight The throughput of the path, which is updated to the throughput at the visible point.
+     * @return The light found along the path (emission and direct light at the visible point).
+     */
+    Color traceCameraPath(const Ray &ray, Sampler &rng, Intersection &visiblePoint, Color &weight) const {
+        Color light = Color(0);
+        Ray currentRay = ray;
+        for (int depth = 0; depth < m_depth; depth++) {
+            const Intersection its = m_scene->intersect(currentRay, rng, m_depth);
+            if (!its) {
+                light += weight * m_scene->evaluateBackground(currentRay.direction).value;
+                break;
+            }
+            light += weight * its.evaluateEmission();
+
+            const BsdfSample sample = its.sampleBsdf(rng);
+            if (sample.pdf < Infinity) {
+                light += weight * calculateLight(its, rng);
+                visiblePoint = its;
+                break;
+            }
+            if (sample.isInvalid()) {
+                break;
+            }
+
+            weight *= sample.weight;
+            currentRay = Ray(its.position, sample.wi, depth + 1);
+        }
+        return light;
+    }
+
+public:
+    PhotonMapper(const Properties &properties)
+    : SamplingIntegrator(properties) {
+        m_depth = properties.get<int>("depth", 8);
+        m_rouletteDepth = properties.get<int>("rouletteDepth", 3);
+        m_photonsPerPass = std::max(properties.get<int>("photons", 100000), 1);
+        m_initialRadius = properties.get<float>("radius", 0);
+        m_alpha = std::clamp(properties.get<float>("alpha", 0.7f), 0.f, 1.f);
+    }
+
+    void execute() override {
+        if (!m_image) {
+            lightwave_throw("<integrator /> needs an <image /> child to render into!");
+        }
+        if (!renderSettings.coordinator.empty() || !renderSettings.region.isEmpty() || renderSettings.sampleStart > 0 ||
+            renderSettings.sampleEnd > 0 || renderSettings.resume) {
+            logger(EWarn, "photon mapping always renders all passes of the entire image, and ignores regions, sample "
+                          "ranges and checkpoints");
+        }
+
+        const Vector2i resolution = m_scene->camera()->resolution();
+        m_image->initialize(resolution);
+
+        // without a given radius, photons are gathered within a small fraction of the size of the scene
+        float radius = m_initialRadius;
+        if (radius <= 0) {
+            const Bounds sceneBounds = m_scene->getBoundingBox();
+            radius = sceneBounds.isEmpty() || sceneBounds.isUnbounded() ? 0.01f
+                                                                        : 0.01f * sceneBounds.diagonal().length();
+        }
+        std::vector<PixelState> pixels(size_t(resolution.x()) * resolution.y(), PixelState { .radius = radius });
+
+        // every photon path stores at most one photon per bounce, which bounds the memory used by each pass, and
+        // the hash table has at least as many entries as photons, so that few unrelated cells share an entry
+        const size_t capacity = size_t(m_photonsPerPass) * std::max(m_depth - 2, 1);
+        m_photons.resize(capacity);
+        m_photonCells.resize(capacity);
+        m_sortedPhotons.resize(capacity);
+        m_cellStarts.resize(std::bit_ceil(capacity) + 1);
+        m_cellCursors.resize(m_cellStarts.size() - 1);
+
+        std::vector<ref<Sampler>> samplers(threadCount());
+        for (auto &sampler : samplers) {
+            sampler = m_sampler->clone();
+        }
+
+        const auto startTime = std::chrono::steady_clock::now();
+        const auto budgetExceeded = [&]() {
+            const std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - startTime;
+            return renderSettings.interrupted || (m_timeBudget > 0 && elapsed.count() >= m_timeBudget);
+        };
+
+        Streaming stream { *m_image };
+        stream.startRegularUpdates();
+
+        const int passes = m_sampler->samplesPerPixel();
+        ProgressReporter progress { passes };
+        int pass = 0;
+        for (; pass < passes && !budgetExceeded(); pass++) {
+            tracePhotons(pass, samplers);
+            buildGrid(2 * radius);
+
+            const float emittedPhotons = float(pass + 1) * m_photonsPerPass;
+            for_each_parallel(BlockSpiral(resolution, Vector2i(64)), [&](auto block) {
+                Sampler &rng = *samplers[threadIndex()];
+                for (auto pixel : block) {
+                    PixelState &state = pixels[size_t(pixel.y()) * resolution.x() + pixel.x()];
+
+                    rng.seed(pixel, pass);
+                    const CameraSample cameraSample = m_scene->camera()->sample(pixel, rng);
+                    Intersection visiblePoint;
+                    Color weight = cameraSample.weight;
+                    state.direct += traceCameraPath(cameraSample.ray, rng, visiblePoint, weight);
+
+                    if (visiblePoint) {
+                        // only a fraction of the new photons is kept, for which the radius shrinks such that the
+                        // density of photons stays the same
+                        int photonCount;
+                        const Color flux = weight * gatherPhotons(visiblePoint, state.radius, photonCount);
+                        if (photonCount > 0) {
+                            const float newCount = state.photonCount + m_alpha * photonCount;
+                            const float newRadius = state.radius * std::sqrt(newCount / (state.photonCount + photonCount));
+                            state.flux = (state.flux + flux) * sqr(newRadius / state.radius);
+                            state.photonCount = newCount;
+                            state.radius = newRadius;
+                        }
+                    }
+
+                    m_image->get(pixel) = state.direct / float(pass + 1) +
+                                          state.flux / (emittedPhotons * Pi * sqr(state.radius));
+                }
+            });
+
+            // radii only shrink, so the cells of the next pass can become smaller as well
+            radius = 0;
+            for (const PixelState &state : pixels) {
+                radius = std::max(radius, state.radius);
+            }
+            progress += 1;
+        }
+        progress.finish();
+
+        if (pass < passes) {
+            logger(EInfo, "photon mapping stopped after %d of %d passes", pass, passes);
+        }
+
+        stream.stopRegularUpdates();
+        stream.update();
+        m_image->save();
+    }
+
+    /// @brief Returns the light found by a camera path alone (i.e., without the indirect light of photons).
+    Color Li(const Ray &ray, Sampler &rng) override {
+        Intersection visiblePoint;
+        Color weight = Color(1);
+        return traceCameraPath(ray, rng, visiblePoint, weight);
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "PhotonMapper[\n"
+            "  sampler = %s,\n"
+            "  image = %s,\n"
+            "  depth = %s,\n"
+            "  photons = %s,\n"
+            "  radius = %s,\n"
+            "  alpha = %s,\n"
+            "]",
+            indent(m_sampler),
+            indent(m_image),
+            indent(m_depth),
+            indent(m_photonsPerPass),
+            indent(m_initialRadius),
+            indent(m_alpha)
+        );
+    }
+};
+
+}
+
+REGISTER_INTEGRATOR(PhotonMapper, "photonmapper")
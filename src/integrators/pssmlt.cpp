@@ -0,0 +1,371 @@
+#include <lightwave.hpp>
+
+#include <chrono>
+
+namespace lightwave {
+
+/**
+ * @brief Feeds an integrator with random numbers from a point in primary sample space (i.e., the unit hypercube of
+ * all random numbers a path consumes), which is mutated by Metropolis-Hastings instead of being drawn anew.
+ * Mutations are applied lazily: a number that has not been used for a few iterations receives all the small steps it
+ * missed at once (which is a single normally distributed step with a larger deviation), or a fresh value if a large
+ * step has happened in the meantime.
+ */
+class PrimarySampleSpaceSampler : public Sampler {
+    struct PrimarySample {
+        float value = 0;
+        /// @brief The iteration in which the value has last been mutated.
+        int64_t lastModification = 0;
+        /// @brief The value before the mutation of the current iteration, which is restored if it is rejected.
+        float backupValue = 0;
+        int64_t backupModification = 0;
+    };
+
+    /// @brief The random numbers that drive the mutations.
+    ref<Sampler> m_rng;
+    /// @brief The standard deviation of small steps.
+    float m_sigma;
+    /// @brief The probability of an iteration being a large step, which draws all numbers independently.
+    float m_largeStepProbability;
+
+    /// @brief The current point in primary sample space, which grows as paths consume more numbers.
+    std::vector<PrimarySample> m_samples;
+    /// @brief The index of the next number handed out within the current iteration.
+    int m_sampleIndex = 0;
+    int64_t m_iteration = 0;
+    int64_t m_lastLargeStep = 0;
+    /// @brief Whether the current iteration is a large step, which is the case for the first iteration.
+    bool m_largeStep = true;
+
+    /// @brief Brings a number up to date with the current iteration, mutating it if needed.
+    void mutate(PrimarySample &sample) {
+        if (sample.lastModification < m_lastLargeStep) {
+            sample.value = m_rng->next();
+            sample.lastModification = m_lastLargeStep;
+        }
+
+        sample.backupValue = sample.value;
+        sample.backupModification = sample.lastModification;
+        if (m_largeStep) {
+            sample.value = m_rng->next();
+        } else {
+            // the small steps that the number missed add up to a single normally distributed step (Box-Muller)
+            const int64_t steps = m_iteration - sample.lastModification;
+            const Point2 u = m_rng->next2D();
+            const float normal = std::sqrt(-2 * std::log(1 - u.x())) * std::cos(2 * Pi * u.y());
+            sample.value += normal * m_sigma * std::sqrt(float(steps));
+            sample.value -= std::floor(sample.value);
+            // values that round up to one are wrapped around as well, as samplers produce numbers in [0,1)
+            if (sample.value >= 1) {
+                sample.value = 0;
+            }
+        }
+        sample.lastModification = m_iteration;
+    }
+
+public:
+    /**
+     * @param rng The sampler whose random numbers drive the mutations, which is seeded with @c seed so that the
+     * first iteration (a large step) produces the same path for the same seed.
+     */
+    PrimarySampleSpaceSampler(const ref<Sampler> &rng, int seed, float sigma, float largeStepProbability)
+    : m_rng(rng), m_sigma(sigma), m_largeStepProbability(largeStepProbability) {
+        m_rng->seed(seed);
+    }
+
+    /// @brief Starts the next iteration, proposing a mutation of the current point.
+    void startIteration() {
+        m_iteration++;
+        m_largeStep = m_rng->next() < m_largeStepProbability;
+        m_sampleIndex = 0;
+    }
+
+    /// @brief Keeps the proposed point.
+    void accept() {
+        if (m_largeStep) {
+            m_lastLargeStep = m_iteration;
+        }
+    }
+
+    /// @brief Returns to the point before the current iteration.
+    void reject() {
+        for (PrimarySample &sample : m_samples) {
+            if (sample.lastModification == m_iteration) {
+                sample.value = sample.backupValue;
+                sample.lastModification = sample.backupModification;
+            }
+        }
+        m_iteration--;
+    }
+
+    /// @brief Reseeds the numbers that drive the mutations, so that chains starting from the same point diverge.
+    void reseedMutations(int seed) { m_rng->seed(seed); }
+
+    float next() override {
+        if (m_sampleIndex >= int(m_samples.size())) {
+            m_samples.resize(m_sampleIndex + 1);
+        }
+        PrimarySample &sample = m_samples[m_sampleIndex++];
+        mutate(sample);
+        return sample.value;
+    }
+
+    // the numbers are given by the Markov chain, which integrators cannot seed
+    void seed(int index) override {}
+    void seed(const Point2i &pixel, int sampleIndex) override {}
+
+    ref<Sampler> clone() const override {
+        auto result = std::make_shared<PrimarySampleSpaceSampler>(*this);
+        result->m_rng = m_rng->clone();
+        return result;
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "PrimarySampleSpaceSampler[\n"
+            "  sigma = %s,\n"
+            "  largeStepProbability = %s,\n"
+            "]",
+            m_sigma,
+            m_largeStepProbability
+        );
+    }
+};
+
+/**
+ * @brief Renders with primary sample space Metropolis light transport (Kelemen et al. 2002): Markov chains mutate
+ * the random numbers fed to another integrator, so that paths are explored in proportion to the luminance they
+ * contribute, and rare but important paths (e.g., caustics through small openings) are found and then mutated
+ * locally instead of being lost among independent samples.
+ *
+ * The first two random numbers of each path pick its position on the image, the camera and the wrapped integrator
+ * consume the rest. A bootstrap phase traces independent paths to estimate the total luminance of the image (which
+ * normalizes the chains) and to pick the starting points of the chains in proportion to their luminance, which
+ * avoids start-up bias. The chains then run independently across threads, and splat both the proposed and the
+ * current path of every mutation onto the image, weighted by the acceptance probability (expected values).
+ * The total number of mutations is given by the sample count of the sampler times the number of pixels.
+ *
+ * @example
+ * @code
+ *   <integrator type="pssmlt" chains="1000" bootstrap="100000" sigma="0.01" largeStepProbability="0.3">
+ *     <scene id="scene"> ... </scene>
+ *     <sampler id="sampler" type="independent" count="64"/>
+ *     <integrator type="pathtracer" depth="8">
+ *       <ref id="scene"/>
+ *       <ref id="sampler"/>
+ *     </integrator>
+ *   </integrator>
+ * @endcode
+ * @note The wrapped integrator only provides @ref SamplingIntegrator::Li , its own render loop (including pre-passes
+ * such as path guiding, and light paths splatted onto the image) is not run.
+ */
+class Pssmlt : public SamplingIntegrator {
+    /// @brief The integrator whose paths are mutated.
+    ref<SamplingIntegrator> m_integrator;
+    /// @brief The number of independent paths used to normalize the chains and pick their starting points.
+    int m_bootstrapSamples;
+    /// @brief The number of Markov chains, which are distributed across threads.
+    int m_chains;
+    /// @brief The standard deviation of small steps in primary sample space.
+    float m_sigma;
+    /// @brief The probability of a mutation being a large step, which draws all random numbers independently.
+    float m_largeStepProbability;
+
+    /// @brief The weighted contributions splatted onto each pixel (which many chains add to).
+    std::vector<Color> m_splats;
+
+    /// @brief The result of tracing a path for a point in primary sample space.
+    struct PathSample {
+        /// @brief The position on the image, in pixels.
+        Point2 position;
+        /// @brief The light the path carries to the camera.
+        Color value;
+        /// @brief The luminance of @c value , which the chains sample proportionally to.
+        float luminance;
+    };
+
+    /// @brief Traces the path given by the random numbers of a sampler.
+    PathSample tracePath(Sampler &rng) const {
+        const Vector2i &resolution = m_scene->camera()->resolution();
+        const Point2 u = rng.next2D();
+        const CameraSample cameraSample = m_scene->camera()->sample(Point2(2 * u.x() - 1, 2 * u.y() - 1), rng);
+        Color value = cameraSample.weight * m_integrator->Li(cameraSample.ray, rng);
+        float luminance = value.luminance();
+        // paths with invalid or negative contributions are never visited
+        if (!std::isfinite(luminance) || !(luminance > 0)) {
+            value = Color(0);
+            luminance = 0;
+        }
+        return {
+            .position = Point2(u.x() * resolution.x(), u.y() * resolution.y()),
+            .value = value,
+            .luminance = luminance,
+        };
+    }
+
+    /// @brief Adds a weighted contribution of a path to the pixel it lies in.
+    void splat(const PathSample &path, float weight) {
+        if (!(weight > 0) || !(path.luminance > 0)) {
+            return;
+        }
+        const Vector2i &resolution = m_scene->camera()->resolution();
+        const int x = std::clamp(int(path.position.x()), 0, resolution.x() - 1);
+        const int y = std::clamp(int(path.position.y()), 0, resolution.y() - 1);
+        atomicAdd(m_splats[size_t(y) * resolution.x() + x], path.value * (weight / path.luminance));
+    }
+
+public:
+    Pssmlt(const Properties &properties)
+    : SamplingIntegrator(properties) {
+        m_integrator = properties.getChild<SamplingIntegrator>();
+        m_bootstrapSamples = std::max(properties.get<int>("bootstrap", 100000), 1);
+        m_chains = std::max(properties.get<int>("chains", 1000), 1);
+        m_sigma = properties.get<float>("sigma", 0.01f);
+        m_largeStepProbability = std::clamp(properties.get<float>("largeStepProbability", 0.3f), 0.f, 1.f);
+    }
+
+    void execute() override {
+        if (!m_image) {
+            lightwave_throw("<integrator /> needs an <image /> child to render into!");
+        }
+        if (!renderSettings.coordinator.empty() || !renderSettings.region.isEmpty() || renderSettings.sampleStart > 0 ||
+            renderSettings.sampleEnd > 0 || renderSettings.resume) {
+            logger(EWarn, "Metropolis light transport always renders the entire image, and ignores regions, sample "
+                          "ranges and checkpoints");
+        }
+
+        const Vector2i resolution = m_scene->camera()->resolution();
+        m_image->initialize(resolution);
+        m_splats.assign(size_t(resolution.x()) * resolution.y(), Color(0));
+
+        // bootstrap: the luminance of independent paths, where path i is traced from seed i, so that chains can
+        // start from it by using the same seed
+        logger(EInfo, "bootstrapping Metropolis light transport with %d paths", m_bootstrapSamples);
+        std::vector<float> luminances(m_bootstrapSamples);
+        std::vector<ref<Sampler>> samplers(threadCount());
+        for (auto &sampler : samplers) {
+            sampler = m_sampler->clone();
+        }
+        for_each_parallel(Range(0, m_bootstrapSamples), [&](int index) {
+            PrimarySampleSpaceSampler rng(samplers[threadIndex()], index, m_sigma, m_largeStepProbability);
+            luminances[index] = tracePath(rng).luminance;
+        });
+
+        double totalLuminance = 0;
+        for (float luminance : luminances) {
+            totalLuminance += luminance;
+        }
+        const float normalization = float(totalLuminance / m_bootstrapSamples);
+        if (!(normalization > 0)) {
+            logger(EWarn, "no bootstrap path carries light, the image stays black");
+            m_image->save();
+            return;
+        }
+        const AliasTable startingPoints(luminances);
+
+        Streaming stream { *m_image };
+        stream.startRegularUpdates();
+
+        const auto startTime = std::chrono::steady_clock::now();
+        const auto budgetExceeded = [&]() {
+            const std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - startTime;
+            return renderSettings.interrupted || (m_timeBudget > 0 && elapsed.count() >= m_timeBudget);
+        };
+
+        // every chain takes its share of the mutations, where the first chains take one more to match the total
+        const int64_t totalMutations = int64_t(m_sampler->samplesPerPixel()) * resolution.x() * resolution.y();
+        const int chains = int(std::min<int64_t>(m_chains, std::max<int64_t>(totalMutations, 1)));
+        std::atomic<int64_t> completedMutations = 0;
+        ProgressReporter progress { totalMutations };
+        for_each_parallel(Range(0, chains), [&](int chain) {
+            const int64_t mutations = totalMutations / chains + (chain < totalMutations % chains);
+
+            // the starting point is picked by the chain's own random number, and reproduced from the seed of its
+            // bootstrap path
+            Sampler &pick = *samplers[threadIndex()];
+            pick.seed(m_bootstrapSamples + chain);
+            const int start = startingPoints.sample(pick.next());
+
+            PrimarySampleSpaceSampler rng(m_sampler->clone(), start, m_sigma, m_largeStepProbability);
+            PathSample current = tracePath(rng);
+            // chains that start from the same point are made to diverge
+            rng.reseedMutations(m_bootstrapSamples + chains + chain);
+
+            Sampler &acceptance = pick;
+            int64_t mutation = 0;
+            for (; mutation < mutations; mutation++) {
+                if (mutation % 1024 == 0 && budgetExceeded()) {
+                    break;
+                }
+
+                rng.startIteration();
+                const PathSample proposed = tracePath(rng);
+                const float acceptProbability = current.luminance > 0
+                                                    ? std::min(1.f, proposed.luminance / current.luminance)
+                                                    : 1;
+
+                // both paths contribute with the probability of the chain being at them (expected values)
+                splat(proposed, acceptProbability);
+                splat(current, 1 - acceptProbability);
+
+                if (acceptance.next() < acceptProbability) {
+                    current = proposed;
+                    rng.accept();
+                } else {
+                    rng.reject();
+                }
+            }
+            completedMutations += mutation;
+            progress += mutation;
+        });
+        progress.finish();
+
+        if (completedMutations < totalMutations) {
+            logger(EInfo, "Metropolis light transport stopped after %d of %d mutations", int64_t(completedMutations),
+                   totalMutations);
+        }
+
+        // each mutation estimates the image with the weight of the normalization per mutation, spread over the pixels
+        const float scale = completedMutations > 0
+                                ? normalization * float(resolution.x()) * float(resolution.y()) /
+                                      float(completedMutations)
+                                : 0;
+        for (auto pixel : m_image->bounds()) {
+            m_image->get(pixel) = scale * m_splats[size_t(pixel.y()) * resolution.x() + pixel.x()];
+        }
+
+        stream.stopRegularUpdates();
+        stream.update();
+        m_image->save();
+    }
+
+    /// @brief Returns the light found by a single independent path of the wrapped integrator.
+    Color Li(const Ray &ray, Sampler &rng) override {
+        return m_integrator->Li(ray, rng);
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "Pssmlt[\n"
+            "  sampler = %s,\n"
+            "  image = %s,\n"
+            "  integrator = %s,\n"
+            "  bootstrap = %s,\n"
+            "  chains = %s,\n"
+            "  sigma = %s,\n"
+            "  largeStepProbability = %s,\n"
+            "]",
+            indent(m_sampler),
+            indent(m_image),
+            indent(m_integrator),
+            m_bootstrapSamples,
+            m_chains,
+            m_sigma,
+            m_largeStepProbability
+        );
+    }
+};
+
+}
+
+REGISTER_INTEGRATOR(Pssmlt, "pssmlt")
@@ -0,0 +1,147 @@
+/**
+ * @file radiancecache.hpp
+ * @brief Contains the world-space radiance cache used to terminate paths at diffuse surfaces.
+ */
+
+#pragma once
+
+#include <lightwave.hpp>
+
+#include <bit>
+#include <optional>
+
+namespace lightwave {
+
+/**
+ * @brief Caches the light reflected by diffuse surfaces in a hashed grid over the scene, where each cell is further
+ * split by the orientation of the surfaces within it (so that both sides of thin walls are kept apart).
+ * Cells store the reflected radiance per unit of albedo, which multiplied by the albedo at a point gives the light a
+ * diffuse surface reflects there, so that textures stay sharp even though cells are much larger than texels.
+ * The table has a fixed number of entries, and cells that do not find a free entry within a few probes are dropped.
+ */
+class RadianceCache {
+    /// @brief The number of consecutive entries that are probed for a cell before giving up.
+    static constexpr int MaxProbes = 8;
+    /// @brief The number of bits used for each coordinate of a cell in its key.
+    static constexpr int CoordinateBits = 20;
+
+    struct Entry {
+        /// @brief The key of the cell stored in the entry, or zero if the entry is free.
+        uint64_t key = 0;
+        /// @brief The sum of the radiance per unit of albedo recorded in the cell.
+        Color radiance = Color(0);
+        /// @brief The number of samples recorded in the cell.
+        uint32_t count = 0;
+    };
+
+    /// @brief The corner of the scene at which the grid starts.
+    Point m_origin;
+    /// @brief The edge length of the cells of the grid.
+    float m_cellSize;
+    /// @brief The entries of the hash table, whose number is a power of two.
+    std::vector<Entry> m_entries;
+
+    /// @brief Returns the key of the cell containing a point on a surface with a given normal (facing the side the
+    /// surface is seen from), which is never zero.
+    uint64_t keyOf(const Point &position, const Vector &normal) const {
+        constexpr uint64_t mask = (uint64_t(1) << CoordinateBits) - 1;
+        uint64_t key = 0;
+        for (int dim = 0; dim < 3; dim++) {
+            const float cell = std::floor((position[dim] - m_origin[dim]) / m_cellSize);
+            key = (key << CoordinateBits) | (uint64_t(std::clamp(cell, 0.f, float(mask))) & mask);
+        }
+
+        // the orientation is one of six directions, given by the dominant axis of the normal and its sign
+        int axis = 0;
+        for (int dim = 1; dim < 3; dim++) {
+            if (std::abs(normal[dim]) > std::abs(normal[axis])) {
+                axis = dim;
+            }
+        }
+        const uint64_t orientation = 2 * axis + (normal[axis] < 0);
+        return (key << 3 | orientation) + 1;
+    }
+
+    /// @brief Returns the first entry probed for a key.
+    size_t slotOf(uint64_t key) const {
+        // mixes the bits of the key (finalizer of MurmurHash3), as cells that are close share most of their bits
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ull;
+        key ^= key >> 33;
+        return size_t(key) & (m_entries.size() - 1);
+    }
+
+public:
+    /**
+     * @param sceneBounds The bounding box of the scene geometry.
+     * @param resolution The number of cells along the longest axis of the scene.
+     * @param memory The number of bytes the hash table may use, which is rounded down to a power of two of entries.
+     */
+    RadianceCache(const Bounds &sceneBounds, int resolution, size_t memory) {
+        m_cellSize = std::max(sceneBounds.diagonal().maxComponent(), Epsilon) / float(std::max(resolution, 1));
+        // the grid starts half a cell before the scene, so that surfaces on the boundary of the scene are not split
+        m_origin = sceneBounds.min() - Vector(m_cellSize / 2);
+        m_entries.resize(std::bit_floor(std::max<size_t>(memory / sizeof(Entry), 1)));
+    }
+
+    /// @brief Returns the number of bytes used by the hash table.
+    size_t memory() const { return m_entries.size() * sizeof(Entry); }
+
+    /// @brief Returns the number of cells that have been recorded into.
+    int cellCount() const {
+        return int(std::count_if(m_entries.begin(), m_entries.end(), [](const Entry &entry) { return entry.key; }));
+    }
+
+    /// @brief Records the radiance per unit of albedo reflected at a point, which is safe to call from many threads
+    /// at once.
+    void record(const Point &position, const Vector &normal, const Color &radiance) {
+        const uint64_t key = keyOf(position, normal);
+        const size_t first = slotOf(key);
+        for (int probe = 0; probe < MaxProbes; probe++) {
+            Entry &entry = m_entries[(first + probe) & (m_entries.size() - 1)];
+
+            // free entries are claimed for the cell, racing with other threads that might claim them for other cells
+            uint64_t current = std::atomic_ref<uint64_t>(entry.key).load(std::memory_order_relaxed);
+            if (current == 0) {
+                std::atomic_ref<uint64_t>(entry.key).compare_exchange_strong(current, key, std::memory_order_relaxed);
+                if (current == 0) {
+                    current = key;
+                }
+            }
+            if (current != key) {
+                continue;
+            }
+
+            atomicAdd(entry.radiance, radiance);
+            std::atomic_ref<uint32_t>(entry.count).fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    /**
+     * @brief Returns the radiance per unit of albedo reflected at a point, or nothing if its cell has received fewer
+     * samples than a given number (which trades noise in the cached values for bias from reusing them).
+     * @note Must not be called while other threads record into the cache.
+     */
+    std::optional<Color> lookup(const Point &position, const Vector &normal, uint32_t minSamples) const {
+        const uint64_t key = keyOf(position, normal);
+        const size_t first = slotOf(key);
+        for (int probe = 0; probe < MaxProbes; probe++) {
+            const Entry &entry = m_entries[(first + probe) & (m_entries.size() - 1)];
+            if (entry.key == 0) {
+                return std::nullopt;
+            }
+            if (entry.key == key) {
+                if (entry.count == 0 || entry.count < minSamples) {
+                    return std::nullopt;
+                }
+                return entry.radiance / float(entry.count);
+            }
+        }
+        return std::nullopt;
+    }
+};
+
+}
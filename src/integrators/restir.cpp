@@ -0,0 +1,423 @@
+#include <lightwave.hpp>
+
+namespace lightwave {
+
+/**
+ * @brief Computes direct illumination by resampling light samples with reservoirs (ReSTIR, see "Spatiotemporal
+ * reservoir resampling for real-time ray tracing with dynamic direct lighting", Bitterli et al. 2020).
+ *
+ * For each pixel sample, a number of candidate light samples is drawn with @ref Scene::sampleLight and
+ * @ref Light::sampleDirect , of which one is kept in a reservoir proportionally to its unshadowed contribution
+ * (resampled importance sampling). The reservoirs of neighbouring pixels within the same batch are then combined,
+ * so that each pixel effectively chooses from the candidates of many pixels, and only the final choice is tested
+ * for visibility with a shadow ray.
+ *
+ * Reservoirs do not store light samples directly, but the seed of the random numbers they have been generated from,
+ * so that the sample can be reproduced for other shading points by calling @ref Light::sampleDirect again. Resampling
+ * hence happens in the space of random numbers, which all pixels share, and needs no conversion between the densities
+ * of different pixels.
+ *
+ * Two modes are supported: @c unbiased weights the sample of each reservoir by how likely the other reservoirs are to
+ * produce it (evaluating its contribution at all neighbours, see "Generalized Resampled Importance Sampling", Lin et
+ * al. 2022), while the cheaper @c biased mode weights reservoirs by their number of candidates, rejects neighbours
+ * with dissimilar geometry instead, and discards occluded samples before sharing them (which reduces noise in
+ * shadows, but darkens their edges).
+ *
+ * As the spatial reuse needs the samples of neighbouring pixels in the same batch, the image is rendered
+ * progressively by default, such that each batch contains one sample of every pixel of a tile.
+ * Surfaces whose BSDF cannot be evaluated (e.g., mirrors) pick up emission through a BSDF sample instead.
+ */
+class ReSTIR : public SamplingIntegrator {
+    /**
+     * @brief Generates the random numbers of light samples from a hash of their seed, so that any sample can be
+     * reproduced by seeding it again. Unlike the sampler of the scene, the sequences of different seeds are
+     * independent of each other and of the other random numbers of the pixel sample, which resampling relies on.
+     */
+    class ReplaySampler : public Sampler {
+        uint64_t m_key = 0;
+        uint64_t m_dimension = 0;
+
+        /// @brief Mixes the bits of a 64-bit integer (SplitMix64 finalizer).
+        static uint64_t mix(uint64_t x) {
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+            return x ^ (x >> 31);
+        }
+
+    public:
+        void seed(int index) override {
+            seed(Point2i(0), index);
+        }
+
+        void seed(const Point2i &pixel, int index) override {
+            m_key = mix(mix(mix(uint64_t(uint32_t(pixel.x()))) ^ uint32_t(pixel.y())) ^ uint32_t(index));
+            m_dimension = 0;
+        }
+
+        float next() override {
+            const uint64_t bits = mix(m_key + 0x9e3779b97f4a7c15ull * ++m_dimension);
+            return std::min(float(bits >> 40) * 0x1p-24f, 1 - Epsilon);
+        }
+
+        void skip(int count) override {
+            m_dimension += uint64_t(count);
+        }
+
+        ref<Sampler> clone() const override {
+            return std::make_shared<ReplaySampler>(*this);
+        }
+
+        std::string toString() const override {
+            return "ReplaySampler[]";
+        }
+    };
+
+    enum class Mode {
+        Biased,
+        Unbiased,
+    };
+
+    /// @brief A light sample chosen from a stream of candidates, along with the weights needed to combine it with
+    /// other reservoirs.
+    struct Reservoir {
+        /// @brief The light source of the chosen sample (or null if no sample has been chosen).
+        const Light *light = nullptr;
+        /// @brief The pixel that seeds the sampler to reproduce the chosen sample.
+        Point2i pixel;
+        /// @brief The sample index that seeds the sampler to reproduce the chosen sample.
+        int index = 0;
+        /// @brief The sum of the resampling weights of all candidates.
+        float weightSum = 0;
+        /// @brief The number of candidates the reservoir has seen.
+        float count = 0;
+        /// @brief The target function (unshadowed contribution) of the chosen sample at the owning shading point.
+        float target = 0;
+        /// @brief The contribution weight of the chosen sample, which makes @c f(y)*weight an estimate of the
+        /// direct illumination.
+        float weight = 0;
+
+        /// @brief Adds a candidate, which replaces the chosen sample with probability proportional to its weight.
+        void update(const Light *candidate, const Point2i &candidatePixel, int candidateIndex, float candidateWeight,
+                    float candidateTarget, float count, float u) {
+            this->count += count;
+            if (!(candidateWeight > 0))
+                return;
+            weightSum += candidateWeight;
+            if (u * weightSum < candidateWeight) {
+                light = candidate;
+                pixel = candidatePixel;
+                index = candidateIndex;
+                target = candidateTarget;
+            }
+        }
+    };
+
+    /// @brief The state of all pixel samples of a batch, stored as structure of arrays.
+    struct Pool {
+        /// @brief The camera weights of the samples.
+        std::vector<Color> cameraWeights;
+        /// @brief The closest intersections of the camera rays.
+        std::vector<Intersection> intersections;
+        /// @brief The radiance that does not depend on the reservoirs (emission and background).
+        std::vector<Color> radiance;
+        /// @brief The reservoirs after generating candidates for each sample.
+        std::vector<Reservoir> initial;
+        /// @brief The reservoirs after combining them with those of neighbouring pixels.
+        std::vector<Reservoir> combined;
+        /// @brief The samples whose reservoirs are combined for the current sample (starting with itself).
+        std::vector<int> neighbors;
+
+        /// @brief The region covered by the pixels of the batch (including its maximum).
+        Bounds2i region;
+        /// @brief The index of the first sample of each pixel within the region (or -1 if it has none).
+        std::vector<int> pixelStart;
+        /// @brief The number of samples of each pixel within the region.
+        std::vector<int> pixelCount;
+
+        void resize(size_t size) {
+            cameraWeights.resize(size);
+            intersections.resize(size);
+            radiance.resize(size);
+            initial.resize(size);
+            combined.resize(size);
+        }
+
+        /// @brief Returns the index of a pixel within @ref pixelStart and @ref pixelCount .
+        int slot(const Point2i &pixel) const {
+            const Vector2i offset = pixel - region.min();
+            return offset.y() * (region.diagonal().x() + 1) + offset.x();
+        }
+    };
+
+    /// @brief The part of the random sequence of a pixel sample used to pick neighbours.
+    static constexpr int SpatialDimensions = 1 << 16;
+
+    /// @brief The number of candidates generated for each pixel sample.
+    int m_candidates;
+    /// @brief The number of neighbouring pixels whose reservoirs are combined with each pixel.
+    int m_spatialSamples;
+    /// @brief The radius (in pixels) within which neighbours are chosen.
+    float m_spatialRadius;
+    Mode m_mode;
+
+    /**
+     * @brief Reproduces the light sample of a reservoir for a given shading point and returns its unshadowed
+     * contribution (the light sample is written to @c dls ).
+     */
+    Color contribution(const Intersection &its, const Light *light, const Point2i &pixel, int index,
+                       Sampler &replay, DirectLightSample &dls) const {
+        replay.seed(pixel, index);
+        dls = light->sampleDirect(its.position, replay);
+        if (dls.isInvalid())
+            return Color(0);
+        const BsdfEval eval = its.evaluateBsdf(dls.wi);
+        if (eval.isInvalid())
+            return Color(0);
+        return dls.weight * eval.value;
+    }
+
+    /// @brief Returns the target function of the sample of a reservoir at a given shading point.
+    float target(const Intersection &its, const Reservoir &reservoir, Sampler &replay) const {
+        if (!reservoir.light)
+            return 0;
+        DirectLightSample dls;
+        return contribution(its, reservoir.light, reservoir.pixel, reservoir.index, replay, dls).mean();
+    }
+
+    /// @brief Draws the candidates for a shading point and keeps one of them in a reservoir.
+    Reservoir generateCandidates(const Intersection &its, const Point2i &pixel, int sampleIndex, Sampler &rng,
+                                 Sampler &replay) const {
+        Reservoir reservoir;
+        if (!m_scene->hasLights())
+            return reservoir;
+
+        for (int candidate = 0; candidate < m_candidates; candidate++) {
+            const LightSample ls = m_scene->sampleLight(its.position, rng);
+            const float u = rng.next();
+            if (ls.isInvalid()) {
+                reservoir.count += 1;
+                continue;
+            }
+
+            // the candidates of each pixel sample use consecutive sample indices of the replay sampler
+            const int index = sampleIndex * m_candidates + candidate;
+            DirectLightSample dls;
+            const float candidateTarget = contribution(its, ls.light, pixel, index, replay, dls).mean();
+            reservoir.update(ls.light, pixel, index, candidateTarget / ls.probability, candidateTarget, 1, u);
+        }
+        reservoir.weight = reservoir.target > 0 ? reservoir.weightSum / (reservoir.count * reservoir.target) : 0;
+        return reservoir;
+    }
+
+    /// @brief Computes the shadowed contribution of the sample of a reservoir.
+    Color shade(const Intersection &its, const Reservoir &reservoir, Sampler &rng, Sampler &replay) const {
+        if (!reservoir.light || reservoir.weight == 0)
+            return Color(0);
+        DirectLightSample dls;
+        const Color value = contribution(its, reservoir.light, reservoir.pixel, reservoir.index, replay, dls);
+        if (value == Color(0) || m_scene->intersect(Ray(its.position, dls.wi), dls.distance, rng))
+            return Color(0);
+        return value * reservoir.weight;
+    }
+
+    /// @brief Computes the contributions of the camera ray that do not depend on light sampling.
+    Color emission(const Ray &ray, const Intersection &its, Sampler &rng) const {
+        if (!its)
+            return m_scene->evaluateBackground(ray.direction).value;
+
+        Color result = its.evaluateEmission();
+
+        // light sampling cannot find lights through BSDFs that cannot be evaluated
+        if (its.instance->bsdf()) {
+            const BsdfSample sample = its.sampleBsdf(rng);
+            if (!sample.isInvalid() && sample.pdf == Infinity) {
+                const Intersection next = m_scene->intersect(Ray(its.position, sample.wi, 1), rng);
+                result += sample.weight * (next ? next.evaluateEmission()
+                                                : m_scene->evaluateBackground(sample.wi).value);
+            }
+        }
+        return result;
+    }
+
+    /// @brief Reports whether the geometry of two shading points is similar enough to share light samples in the
+    /// biased mode.
+    static bool similar(const Intersection &a, const Intersection &b) {
+        return a.frame.normal.dot(b.frame.normal) > 0.9f && abs(a.t - b.t) < 0.1f * std::max(a.t, b.t);
+    }
+
+    /// @brief Finds the samples of the neighbouring pixels of each sample and combines their reservoirs.
+    void combineReservoirs(Pool &pool, std::span<const PixelSample> samples, Sampler &rng, Sampler &replay) const {
+        for (size_t i = 0; i < samples.size(); i++) {
+            const Intersection &its = pool.intersections[i];
+            Reservoir &combined = pool.combined[i];
+            combined = Reservoir();
+            if (!its)
+                continue;
+
+            // the spatial reuse of a sample runs after all other samples have been traced, so it needs its own part
+            // of the random sequence
+            rng.seed(samples[i].pixel, samples[i].sampleIndex);
+            rng.skip(SpatialDimensions);
+
+            // pick random samples of neighbouring pixels, each at most once
+            pool.neighbors.clear();
+            pool.neighbors.push_back(int(i));
+            const int ordinal = int(i) - pool.pixelStart[pool.slot(samples[i].pixel)];
+            for (int attempt = 0; attempt < m_spatialSamples; attempt++) {
+                const Point2 offset = squareToUniformDiskConcentric(rng.next2D());
+                const Point2i pixel = samples[i].pixel + Vector2i(int(std::round(offset.x() * m_spatialRadius)),
+                                                                  int(std::round(offset.y() * m_spatialRadius)));
+                if (pixel == samples[i].pixel || !pool.region.includes(pixel))
+                    continue;
+                const int slot = pool.slot(pixel);
+                if (pool.pixelStart[slot] < 0)
+                    continue;
+                const int neighbor = pool.pixelStart[slot] + ordinal % pool.pixelCount[slot];
+                const Intersection &neighborIts = pool.intersections[neighbor];
+                if (!neighborIts || std::find(pool.neighbors.begin(), pool.neighbors.end(), neighbor) !=
+                                        pool.neighbors.end())
+                    continue;
+                if (m_mode == Mode::Biased && !similar(its, neighborIts))
+                    continue;
+                pool.neighbors.push_back(neighbor);
+            }
+
+            for (int source : pool.neighbors) {
+                const Reservoir &other = pool.initial[source];
+                if (!other.light || other.weight == 0) {
+                    combined.count += other.count;
+                    continue;
+                }
+                const float otherTarget = source == int(i) ? other.target : target(its, other, replay);
+
+                // the unbiased mode weights each sample by how likely each reservoir is to produce it (generalized
+                // balance heuristic), which stays bounded when the neighbours see very different illumination
+                float misWeight = other.count;
+                if (m_mode == Mode::Unbiased) {
+                    float sum = 0;
+                    for (int candidate : pool.neighbors) {
+                        const float candidateTarget = candidate == source
+                                                          ? other.target
+                                                          : target(pool.intersections[candidate], other, replay);
+                        sum += pool.initial[candidate].count * candidateTarget;
+                    }
+                    misWeight = other.count * other.target / sum;
+                }
+                combined.update(other.light, other.pixel, other.index, misWeight * otherTarget * other.weight,
+                                otherTarget, other.count, rng.next());
+            }
+
+            if (!(combined.target > 0))
+                continue;
+            // the biased mode normalizes by the number of all candidates instead
+            const float normalization = m_mode == Mode::Unbiased ? 1 : combined.count;
+            combined.weight = combined.weightSum / (normalization * combined.target);
+        }
+    }
+
+public:
+    ReSTIR(const Properties &properties)
+    : SamplingIntegrator(properties) {
+        m_candidates = std::max(properties.get<int>("candidates", 32), 1);
+        m_spatialSamples = std::max(properties.get<int>("spatialSamples", 5), 0);
+        m_spatialRadius = properties.get<float>("spatialRadius", 10);
+        m_mode = properties.getEnum<Mode>("mode", Mode::Unbiased,
+            {
+                { "biased", Mode::Biased },
+                { "unbiased", Mode::Unbiased },
+            });
+
+        // spatial reuse needs the samples of neighbouring pixels in the same batch
+        m_progressive = properties.get<bool>("progressive", true);
+        m_batchSize = std::max(properties.get<int>("batchSize", 4096), 1);
+    }
+
+    void estimate(std::span<const PixelSample> samples, std::span<Color> results, Sampler &rng) override {
+        if (samples.empty())
+            return;
+
+        thread_local Pool pool;
+        ReplaySampler replay;
+        pool.resize(samples.size());
+
+        // index the samples by pixel, where the samples of a pixel are consecutive within the batch
+        pool.region = Bounds2i(samples[0].pixel, samples[0].pixel);
+        for (const PixelSample &sample : samples)
+            pool.region.extend(sample.pixel);
+        const size_t pixelCount = size_t((pool.region.diagonal() + Vector2i(1)).product());
+        pool.pixelStart.assign(pixelCount, -1);
+        pool.pixelCount.assign(pixelCount, 0);
+        for (size_t i = 0; i < samples.size(); i++) {
+            const int slot = pool.slot(samples[i].pixel);
+            if (pool.pixelStart[slot] < 0)
+                pool.pixelStart[slot] = int(i);
+            pool.pixelCount[slot]++;
+        }
+
+        // stage 1: trace the camera rays and draw the candidates of each sample
+        for (size_t i = 0; i < samples.size(); i++) {
+            rng.seed(samples[i].pixel, samples[i].sampleIndex);
+            const CameraSample cameraSample = m_scene->camera()->sample(samples[i].pixel, rng);
+            pool.cameraWeights[i] = cameraSample.weight;
+            pool.intersections[i] = m_scene->intersect(cameraSample.ray, rng);
+            pool.radiance[i] = emission(cameraSample.ray, pool.intersections[i], rng);
+            pool.initial[i] = Reservoir();
+            if (!pool.intersections[i])
+                continue;
+
+            pool.initial[i] =
+                generateCandidates(pool.intersections[i], samples[i].pixel, samples[i].sampleIndex, rng, replay);
+
+            // share only visible samples in the biased mode
+            if (m_mode == Mode::Biased && shade(pool.intersections[i], pool.initial[i], rng, replay) == Color(0))
+                pool.initial[i].weight = 0;
+        }
+
+        // stage 2: combine the reservoirs of neighbouring pixels
+        combineReservoirs(pool, samples, rng, replay);
+
+        // stage 3: trace a shadow ray for the sample chosen by each pixel sample
+        for (size_t i = 0; i < samples.size(); i++) {
+            Color value = pool.radiance[i];
+            if (pool.intersections[i])
+                value += shade(pool.intersections[i], pool.combined[i], rng, replay);
+            results[i] = pool.cameraWeights[i] * value;
+        }
+    }
+
+    Color Li(const Ray &ray, Sampler &rng) override {
+        ReplaySampler replay;
+        const Intersection its = m_scene->intersect(ray, rng);
+        Color value = emission(ray, its, rng);
+        if (its) {
+            // without a pixel to identify the light samples by, they are identified by a random key instead
+            const Point2i key(int(rng.next() * (1 << 24)), int(rng.next() * (1 << 24)));
+            const Reservoir reservoir = generateCandidates(its, key, 0, rng, replay);
+            value += shade(its, reservoir, rng, replay);
+        }
+        return value;
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "ReSTIR[\n"
+            "  sampler = %s,\n"
+            "  image = %s,\n"
+            "  candidates = %d,\n"
+            "  spatialSamples = %d,\n"
+            "  spatialRadius = %f,\n"
+            "  mode = %s,\n"
+            "]",
+            indent(m_sampler),
+            indent(m_image),
+            m_candidates,
+            m_spatialSamples,
+            m_spatialRadius,
+            m_mode == Mode::Biased ? "biased" : "unbiased"
+        );
+    }
+};
+
+}
+
+REGISTER_INTEGRATOR(ReSTIR, "restir")
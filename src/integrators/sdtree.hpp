@@ -0,0 +1,303 @@
+/**
+ * @file sdtree.hpp
+ * @brief Contains the spatial-directional tree used for path guiding (Müller et al. 2017, "Practical Path Guiding
+ * for Efficient Light-Transport Simulation").
+ */
+
+#pragma once
+
+#include <lightwave.hpp>
+
+#include <array>
+
+namespace lightwave {
+
+/**
+ * @brief A distribution over the sphere of directions, stored as a quadtree over the cylindrical coordinates
+ * (cos theta, phi) of directions, which map the sphere to the unit square while preserving area.
+ * Each node stores the energy of its four quadrants, and quadrants with a large fraction of the total energy are
+ * refined further.
+ */
+class DTree {
+    /// @brief The maximum depth of the quadtree.
+    static constexpr int MaxDepth = 20;
+
+    struct Node {
+        /// @brief The energy recorded in each quadrant (in the order x-y: 00, 10, 01, 11).
+        std::array<float, 4> sums = { 0, 0, 0, 0 };
+        /// @brief The index of the node that refines each quadrant, or zero for quadrants that are leaves.
+        std::array<uint32_t, 4> children = { 0, 0, 0, 0 };
+
+        float total() const { return sums[0] + sums[1] + sums[2] + sums[3]; }
+    };
+
+    /// @brief The nodes of the quadtree, where the root is the first node.
+    std::vector<Node> m_nodes = { Node() };
+
+    /// @brief Returns the quadrant of the unit square that contains a point, and maps the point into the quadrant.
+    static int quadrant(Point2 &p) {
+        const int x = p.x() >= 0.5f, y = p.y() >= 0.5f;
+        p = Point2(2 * p.x() - x, 2 * p.y() - y);
+        return x + 2 * y;
+    }
+
+public:
+    /// @brief Maps a direction to its cylindrical coordinates in the unit square.
+    static Point2 toSquare(const Vector &direction) {
+        const float cosTheta = std::clamp(direction.z(), -1.f, 1.f);
+        float phi = std::atan2(direction.y(), direction.x());
+        if (phi < 0) {
+            phi += 2 * Pi;
+        }
+        return Point2(std::clamp((cosTheta + 1) / 2, 0.f, 1.f), std::clamp(phi * Inv2Pi, 0.f, 1.f));
+    }
+
+    /// @brief Maps cylindrical coordinates in the unit square to a direction (the inverse of @ref toSquare ).
+    static Vector fromSquare(const Point2 &p) {
+        const float cosTheta = 2 * p.x() - 1;
+        const float sinTheta = safe_sqrt(1 - sqr(cosTheta));
+        const float phi = 2 * Pi * p.y();
+        return Vector(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+    }
+
+    /// @brief Returns the total energy recorded in the tree.
+    float total() const { return m_nodes[0].total(); }
+
+    /// @brief Returns the number of nodes of the tree.
+    int nodeCount() const { return int(m_nodes.size()); }
+
+    /// @brief Adds energy arriving from a direction to all nodes containing it, which is safe to call from many
+    /// threads at once.
+    void record(const Vector &direction, float value) {
+        Point2 p = toSquare(direction);
+        uint32_t node = 0;
+        while (true) {
+            const int q = quadrant(p);
+            atomicAdd(m_nodes[node].sums[q], value);
+            if (!m_nodes[node].children[q]) {
+                return;
+            }
+            node = m_nodes[node].children[q];
+        }
+    }
+
+    /// @brief Samples a direction proportionally to the recorded energy (uniformly within the leaves).
+    Vector sample(Sampler &rng) const {
+        Point2 origin = Point2(0);
+        float size = 1;
+        uint32_t node = 0;
+        while (true) {
+            const Node &current = m_nodes[node];
+            const float total = current.total();
+            if (!(total > 0)) {
+                // nodes without energy are sampled uniformly
+                const Point2 u = rng.next2D();
+                return fromSquare(Point2(origin.x() + u.x() * size, origin.y() + u.y() * size));
+            }
+
+            float u = rng.next() * total;
+            int q = 0;
+            while (q < 3 && u >= current.sums[q]) {
+                u -= current.sums[q++];
+            }
+            size /= 2;
+            origin = Point2(origin.x() + (q & 1) * size, origin.y() + (q >> 1) * size);
+
+            if (!current.children[q]) {
+                const Point2 v = rng.next2D();
+                return fromSquare(Point2(origin.x() + v.x() * size, origin.y() + v.y() * size));
+            }
+            node = current.children[q];
+        }
+    }
+
+    /// @brief Returns the probability density (in solid angle) of @ref sample sampling a direction.
+    float pdf(const Vector &direction) const {
+        Point2 p = toSquare(direction);
+        float pdf = Inv4Pi;
+        uint32_t node = 0;
+        while (true) {
+            const Node &current = m_nodes[node];
+            const float total = current.total();
+            if (!(total > 0)) {
+                return pdf;
+            }
+            const int q = quadrant(p);
+            pdf *= 4 * current.sums[q] / total;
+            if (!current.children[q]) {
+                return pdf;
+            }
+            node = current.children[q];
+        }
+    }
+
+    /**
+     * @brief Returns an empty tree whose structure follows the recorded energy, i.e., in which every quadrant that
+     * holds more than a given fraction of the total energy is refined (and all others are leaves).
+     */
+    DTree refined(float energyThreshold) const {
+        DTree result;
+        const float total = this->total();
+        if (!(total > 0)) {
+            return result;
+        }
+
+        struct Entry {
+            /// @brief The corresponding node of this tree, or -1 if the node did not exist before.
+            int oldNode;
+            /// @brief The node of the new tree.
+            uint32_t newNode;
+            int depth;
+            std::array<float, 4> sums;
+        };
+        std::vector<Entry> stack = { { 0, 0, 1, m_nodes[0].sums } };
+        while (!stack.empty()) {
+            const Entry entry = stack.back();
+            stack.pop_back();
+            for (int q = 0; q < 4; q++) {
+                if (entry.depth >= MaxDepth || !(entry.sums[q] > total * energyThreshold)) {
+                    continue;
+                }
+
+                // quadrants that were leaves before are assumed to distribute their energy evenly
+                const int oldChild = entry.oldNode >= 0 && m_nodes[entry.oldNode].children[q]
+                                         ? int(m_nodes[entry.oldNode].children[q]) : -1;
+                const std::array<float, 4> childSums = oldChild >= 0 ? m_nodes[oldChild].sums
+                    : std::array<float, 4> { entry.sums[q] / 4, entry.sums[q] / 4, entry.sums[q] / 4, entry.sums[q] / 4 };
+
+                const uint32_t newChild = uint32_t(result.m_nodes.size());
+                result.m_nodes.emplace_back();
+                result.m_nodes[entry.newNode].children[q] = newChild;
+                stack.push_back({ oldChild, newChild, entry.depth + 1, childSums });
+            }
+        }
+        return result;
+    }
+};
+
+/**
+ * @brief Learns the distribution of light arriving at points in the scene, using a binary tree over space whose
+ * leaves hold a directional quadtree (@ref DTree ) each.
+ * Training happens in iterations: The energy arriving at paths is recorded in the building trees, while the
+ * sampling trees (learned in the previous iteration) guide the paths. After each iteration, leaves that have
+ * received many samples are split, and the building trees become the sampling trees.
+ */
+class SDTree {
+    /// @brief The maximum depth of the spatial tree.
+    static constexpr int MaxDepth = 48;
+
+    struct Leaf {
+        /// @brief The distribution learned in the previous iteration, from which directions are sampled.
+        DTree sampling;
+        /// @brief The distribution recorded in the current iteration.
+        DTree building;
+        /// @brief The number of samples recorded in the current iteration.
+        uint32_t sampleCount = 0;
+    };
+
+    struct Node {
+        /// @brief The index of the two children (split at the middle along the axis given by the depth of the
+        /// node), or zero for leaves.
+        std::array<uint32_t, 2> children = { 0, 0 };
+        /// @brief The index of the leaf data of leaf nodes.
+        uint32_t leaf = 0;
+    };
+
+    /// @brief The cube covering the scene, which the spatial tree subdivides.
+    Bounds m_bounds;
+    /// @brief The nodes of the spatial tree, where the root is the first node.
+    std::vector<Node> m_nodes = { Node() };
+    /// @brief The leaf data of the spatial tree.
+    std::vector<Leaf> m_leaves = { Leaf() };
+
+    /// @brief Returns the leaf data of the spatial tree that contains a point.
+    uint32_t leafAt(const Point &point) const {
+        // points are mapped into the unit cube, and then into the children they belong to
+        const Vector extent = m_bounds.diagonal();
+        Point p;
+        for (int dim = 0; dim < 3; dim++) {
+            p[dim] = std::clamp((point[dim] - m_bounds.min()[dim]) / extent[dim], 0.f, 1.f);
+        }
+
+        uint32_t node = 0;
+        for (int depth = 0; m_nodes[node].children[0]; depth++) {
+            const int axis = depth % 3;
+            const int child = p[axis] >= 0.5f;
+            p[axis] = 2 * p[axis] - child;
+            node = m_nodes[node].children[child];
+        }
+        return m_nodes[node].leaf;
+    }
+
+public:
+    SDTree(const Bounds &sceneBounds) {
+        // the tree covers a slightly enlarged cube around the scene, so that its cells are roughly cubic
+        const Point center = sceneBounds.center();
+        const float extent = std::max(sceneBounds.diagonal().maxComponent(), Epsilon) * 0.51f;
+        m_bounds = Bounds(center - Vector(extent), center + Vector(extent));
+    }
+
+    /// @brief Returns the number of leaves of the spatial tree.
+    int leafCount() const { return int(m_leaves.size()); }
+
+    /// @brief Returns the distribution that directions at a point are sampled from, or null if nothing has been
+    /// learned for the point yet.
+    const DTree *samplingTree(const Point &point) const {
+        const DTree &tree = m_leaves[leafAt(point)].sampling;
+        return tree.total() > 0 ? &tree : nullptr;
+    }
+
+    /// @brief Records energy arriving at a point from a direction, which is safe to call from many threads at once.
+    void record(const Point &point, const Vector &direction, float value) {
+        Leaf &leaf = m_leaves[leafAt(point)];
+        if (value > 0) {
+            leaf.building.record(direction, value);
+        }
+        std::atomic_ref<uint32_t>(leaf.sampleCount).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Completes a training iteration: Splits the leaves that have received more samples than a threshold
+     * (which grows with the square root of the number of samples per iteration, i.e., of two to the iteration),
+     * and replaces the sampling trees by the recorded ones.
+     */
+    void refine(int iteration, float spatialThreshold, float energyThreshold) {
+        const float threshold = spatialThreshold * std::sqrt(float(1 << iteration));
+
+        // split leaves until each has received fewer samples than the threshold (children get half of the samples)
+        std::vector<std::pair<uint32_t, int>> stack = { { 0, 0 } };
+        while (!stack.empty()) {
+            const auto [node, depth] = stack.back();
+            stack.pop_back();
+            if (m_nodes[node].children[0]) {
+                stack.push_back({ m_nodes[node].children[0], depth + 1 });
+                stack.push_back({ m_nodes[node].children[1], depth + 1 });
+                continue;
+            }
+
+            const uint32_t leaf = m_nodes[node].leaf;
+            if (depth >= MaxDepth || m_leaves[leaf].sampleCount <= threshold) {
+                continue;
+            }
+            m_leaves[leaf].sampleCount /= 2;
+            const uint32_t otherLeaf = uint32_t(m_leaves.size());
+            m_leaves.push_back(m_leaves[leaf]);
+
+            const uint32_t firstChild = uint32_t(m_nodes.size());
+            m_nodes.push_back({ .leaf = leaf });
+            m_nodes.push_back({ .leaf = otherLeaf });
+            m_nodes[node].children = { firstChild, firstChild + 1 };
+            stack.push_back({ firstChild, depth + 1 });
+            stack.push_back({ firstChild + 1, depth + 1 });
+        }
+
+        for_each_parallel(Range(0, int(m_leaves.size())), [&](int index) {
+            Leaf &leaf = m_leaves[index];
+            leaf.sampling = leaf.building;
+            leaf.building = leaf.sampling.refined(energyThreshold);
+            leaf.sampleCount = 0;
+        });
+    }
+};
+
+}
@@ -4,36 +4,91 @@ namespace lightwave {
 class Volumepathtracer : public SamplingIntegrator {
 
     int m_depth;
+    /// @brief Whether scatter points in homogeneous media are additionally sampled equiangularly towards point lights,
+    /// combined with free-flight sampling using multiple importance sampling.
+    bool m_equiangular;
 
-    // intersect but ignor volums. Account for them with Tr() and change light contribution
-    // returns a weight that is one of the light is hit right away
+    /**
+     * @brief Samples distances along a ray segment proportionally to the inverse squared distance to a point, which
+     * cancels the falloff of the light emitted from that point (equiangular sampling, Kulla and Fajardo 2012).
+     */
+    struct EquiangularSampling {
+        /// @brief The distance along the ray to the point closest to the target.
+        float delta;
+        /// @brief The distance of the target from the ray.
+        float distance;
+        /// @brief The angles (seen from the target) of the start and end of the segment.
+        float thetaA, thetaB;
+
+        EquiangularSampling(const Ray &ray, float tMax, const Point &target) {
+            delta = (target - ray.origin).dot(ray.direction);
+            // keep the distribution valid for targets that lie on the ray
+            distance = std::max((ray(delta) - target).length(), Epsilon);
+            thetaA = std::atan2(-delta, distance);
+            thetaB = std::atan2(tMax - delta, distance);
+        }
+
+        float sample(float u) const {
+            return delta + distance * std::tan(thetaA + u * (thetaB - thetaA));
+        }
+
+        float pdf(float t) const {
+            return distance / ((thetaB - thetaA) * (sqr(distance) + sqr(t - delta)));
+        }
+    };
+
+    /// @brief Returns the point that equiangular sampling aims at for a light source, which only exists for lights
+    /// that are not hit by rays and emit from a single position (i.e., point lights).
+    static std::optional<Point> equiangularTarget(const Light *light) {
+        if (light->canBeIntersected()) {
+            return std::nullopt;
+        }
+        const auto bounds = light->bounds();
+        if (!bounds || bounds->bounds.diagonal().lengthSquared() > 0) {
+            return std::nullopt;
+        }
+        return bounds->bounds.min();
+    }
+
+    // intersect but ignore volumes. Account for them with Tr() and change light contribution
+    // returns a weight that is one if the light is hit right away
     // returns 0 if the light is blocked
     // returns any value between 0 and 1 if there is a volume
     float intersectTr(const Ray &ray, DirectLightSample dls, Sampler &rng) {
-        float weight = 1;
-        Ray currentRay = ray;
-        float distance = dls.distance;
-        while (true) {
-            // Check if there is something between light and hitpoit
-            const Intersection its_shadow = this->m_scene->intersect(currentRay, rng);
+        // the crossings of all medium boundaries are found in a single traversal of the scene
+        thread_local std::vector<MediumCrossing> crossings;
+        if (!this->m_scene->intersectCrossings(ray, dls.distance, crossings, rng)) {
+            return 0;
+        }
 
-            if (!its_shadow || (its_shadow.t > distance)) {
-                return weight;
-            }
-            
-            if (its_shadow.instance->bsdf() != nullptr) {
-                return 0;
+        // every medium attenuates the parts of the ray that lie inside of it, which end where the ray leaves it (or
+        // at the light source) and start where the ray has entered it (or at the origin of the ray)
+        float weight = 1;
+        for (size_t i = 0; i < crossings.size(); i++) {
+            const MediumCrossing &crossing = crossings[i];
+            const Medium *medium = crossing.instance->medium();
+
+            float start, end;
+            if (crossing.entering) {
+                // only media that the ray does not leave again are handled when entering them
+                const auto next = std::find_if(crossings.begin() + i + 1, crossings.end(),
+                    [&](const MediumCrossing &other) { return other.instance == crossing.instance; });
+                if (next != crossings.end() || dls.distance == Infinity) {
+                    continue;
+                }
+                start = crossing.t, end = dls.distance;
+            } else {
+                const auto previous = std::find_if(crossings.rbegin() + (crossings.size() - i), crossings.rend(),
+                    [&](const MediumCrossing &other) { return other.instance == crossing.instance; });
+                start = previous != crossings.rend() ? previous->t : 0, end = crossing.t;
             }
 
-            if (its_shadow.instance->medium() == nullptr) {
+            weight *= medium->Tr(Ray(ray(start), ray.direction), end - start, rng);
+            if (weight <= 0) {
                 return 0;
             }
-
-            weight *= its_shadow.instance->medium()->Tr(currentRay, its_shadow.t, rng);
-
-            distance -= (its_shadow.position - currentRay.origin).length();
-            currentRay = Ray(its_shadow.position, currentRay.direction);
         }
+        return weight;
     }
     
     Color calculateLight(Intersection &its, Sampler &rng) {
@@ -42,10 +97,12 @@ class Volumepathtracer : public SamplingIntegrator {
         }
 
         // Sample random light source in the scene and sample point on selected light source
-        const LightSample ls = this->m_scene->sampleLight(rng);
+        return calculateLight(its, this->m_scene->sampleLight(its.position, rng), rng);
+    }
 
+    Color calculateLight(Intersection &its, const LightSample &ls, Sampler &rng) {
         // If light can be intersected, don't count it (since it will be hit by the ray already)
-        if (ls.light->canBeIntersected()) {
+        if (ls.isInvalid() || ls.light->canBeIntersected()) {
             return Color(0.0f);
         }
 
@@ -70,12 +127,58 @@ class Volumepathtracer : public SamplingIntegrator {
         return contribution;
     }
 
+    /**
+     * @brief Estimates the light that is scattered towards the origin of a ray segment through a homogeneous medium
+     * by sampling the scatter point equiangularly towards a point light, weighted against free-flight sampling
+     * followed by next event estimation.
+     */
+    Color sampleEquiangular(const Ray &ray, float tMax, const Medium &medium, Sampler &rng) {
+        if (not this->m_scene->hasLights()) {
+            return Color(0.0f);
+        }
+
+        const LightSample ls = this->m_scene->sampleLight(ray.origin, rng);
+        if (ls.isInvalid()) {
+            return Color(0.0f);
+        }
+        const auto target = equiangularTarget(ls.light);
+        if (!target) {
+            return Color(0.0f);
+        }
+
+        const EquiangularSampling equiangular(ray, tMax, *target);
+        const float t = clamp(equiangular.sample(rng.next()), 0.f, tMax);
+        const float pdf = ls.probability * equiangular.pdf(t);
+        if (!(pdf > 0)) {
+            return Color(0.0f);
+        }
+
+        Intersection itsMedium = Intersection(-ray.direction, t);
+        itsMedium.uv = Point2(0,0);
+        itsMedium.position = ray(t);
+
+        const DirectLightSample dls = ls.light->sampleDirect(itsMedium.position, rng);
+        const float traceWeight = this->intersectTr(Ray(itsMedium.position, dls.wi), dls, rng);
+        if (traceWeight <= 0) {
+            return Color(0.0f);
+        }
+
+        // the same path could also have been found by sampling the scatter distance and then the light
+        const float freeFlightPdf = medium.probabilityOfSampelingThisPoint(t);
+        const float misWeight = powerHeuristic(pdf,
+            m_scene->lightSelectionProbability(ls.light, itsMedium.position) * freeFlightPdf);
+
+        const Color scattering = medium.Tr(ray, t, rng) * medium.getColor() / Pi;
+        return misWeight * freeFlightPdf * scattering * traceWeight * dls.weight / pdf;
+    }
+
 public:
     Volumepathtracer(const Properties &properties)
     : SamplingIntegrator(properties) {
         // to parse properties from the scene description, use properties.get(name, default_value)
         // you can also omit the default value if you want to require the user to specify a value
         m_depth = properties.get<int>("depth", 2);
+        m_equiangular = properties.get<bool>("equiangular", true);
     }
 
     /**
@@ -116,6 +219,14 @@ public:
                 break;
             }
 
+            // sample a scatter point equiangularly towards a point light, which finds the light scattered close to
+            // point lights much more reliably than free-flight sampling does in thin media
+            const bool useEquiangular = m_equiangular && currentMedium != nullptr && currentMedium->isHomogeneous() &&
+                                        i < m_depth - 1;
+            if (useEquiangular) {
+                accumulatedLight += accumulatedWeight * sampleEquiangular(currentRay, its.t, *currentMedium, rng);
+            }
+
             // either evaluate medium or surface interaction
             if (tScatter < its.t) {
                 // Medium scatter event
@@ -125,8 +236,22 @@ public:
                 Intersection itsMedium = Intersection(its.wo, tScatter);
                 itsMedium.uv = Point2(0,0);
                 itsMedium.position = currentRay(tScatter);
-                // next event estimation to evaluate light
-                Color lightContribution = calculateLight(itsMedium, rng);
+                // next event estimation to evaluate light, weighted against equiangular sampling towards the same
+                // light if that would have been used as well
+                Color lightContribution = Color(0);
+                if (m_scene->hasLights()) {
+                    const LightSample ls = m_scene->sampleLight(itsMedium.position, rng);
+                    lightContribution = calculateLight(itsMedium, ls, rng);
+                    if (useEquiangular && !ls.isInvalid()) {
+                        if (const auto target = equiangularTarget(ls.light)) {
+                            const EquiangularSampling equiangular(currentRay, its.t, *target);
+                            lightContribution *= powerHeuristic(
+                                ls.probability * currentMedium->probabilityOfSampelingThisPoint(tScatter),
+                                m_scene->lightSelectionProbability(ls.light, currentRay.origin) *
+                                    equiangular.pdf(tScatter));
+                        }
+                    }
+                }
 
                 // get emissions of intersection
                 Color emission = Color(0);
@@ -199,10 +324,12 @@ public:
             "  sampler = %s,\n"
             "  image = %s,\n"
             "  depth = %s,\n"
+            "  equiangular = %s,\n"
             "]",
             indent(m_sampler),
             indent(m_image),
-            indent(m_depth)
+            indent(m_depth),
+            indent(m_equiangular)
         );
     }
 };
@@ -0,0 +1,344 @@
+#include <lightwave.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <typeinfo>
+
+namespace lightwave {
+
+/**
+ * @brief A path tracer that computes the same estimate as @ref Pathtracer , but advances a whole batch of paths
+ * in stages instead of tracing one path at a time.
+ *
+ * Each bounce of the batch is processed in four stages: intersecting all rays with the scene, evaluating the
+ * materials of all hits (sorted by BSDF, so that the same material code and textures are used for long runs of
+ * paths), tracing the shadow rays that have been queued by the material stage, and finally accumulating the
+ * results. The state of the paths is stored in separate arrays (structure of arrays), so that each stage only
+ * touches the data it needs. Batches are the samples of a tile, and the tiles are rendered by all threads in
+ * parallel, so that every stage runs on all cores without synchronizing them between stages.
+ *
+ * As the stages of different paths are interleaved, each stage reseeds the sampler and skips to a part of the
+ * random sequence reserved for that stage of that bounce (see @ref StageSampler ).
+ */
+class WavefrontPathtracer : public SamplingIntegrator {
+    /// @brief The parts of the random sequence of a sample, relative to the start of its bounce.
+    enum Stage {
+        EIntersect = 0,
+        EMaterial  = 64,
+        EShadow    = 192,
+    };
+    /// @brief The number of random numbers reserved for each bounce.
+    static constexpr int DimensionsPerBounce = 256;
+    /// @brief The number of random numbers reserved for generating the camera ray.
+    static constexpr int CameraDimensions = 64;
+
+    /// @brief The state of all paths of a batch, stored as structure of arrays.
+    struct Pool {
+        /// @brief The rays that are traced next.
+        std::vector<Ray> rays;
+        /// @brief The product of all weights along the path so far.
+        std::vector<Color> throughput;
+        /// @brief The radiance gathered by the path so far.
+        std::vector<Color> radiance;
+        /// @brief The density of the BSDF samples that generated the rays (infinite for camera rays), which weights
+        /// light sources that are hit against sampling them through next event estimation.
+        std::vector<float> bsdfPdfs;
+        /// @brief The origins of the BSDF samples that generated the rays.
+        std::vector<Point> previousPositions;
+        /// @brief The closest intersections of the rays.
+        std::vector<Intersection> intersections;
+
+        /// @brief The paths that have not terminated yet.
+        std::vector<int> active;
+        /// @brief The active paths that have hit a surface, sorted by their BSDF.
+        std::vector<int> hits;
+        /// @brief The index of the BSDF of each active path within @ref bsdfs .
+        std::vector<int> hitBsdfs;
+        /// @brief The distinct BSDFs that have been hit along with their type, by which they are sorted (the type
+        /// is identified by the address of its name, which is cheaper to compare).
+        std::vector<std::pair<const char *, const Bsdf *>> bsdfs;
+        /// @brief The indices of @ref bsdfs in sorted order.
+        std::vector<int> bsdfOrder;
+        /// @brief The position of the first hit of each BSDF within @ref hits .
+        std::vector<int> bsdfOffsets;
+
+        /// @brief The paths that queued a shadow ray towards a light source.
+        std::vector<int> shadowPaths;
+        /// @brief The shadow rays towards the light sources.
+        std::vector<Ray> shadowRays;
+        /// @brief The distances to the sampled points on the light sources.
+        std::vector<float> shadowDistances;
+        /// @brief The contributions the light sources make if they are not occluded, including their MIS weight.
+        std::vector<Color> shadowContributions;
+
+        void resize(size_t size) {
+            rays.resize(size);
+            throughput.resize(size);
+            radiance.resize(size);
+            bsdfPdfs.resize(size);
+            previousPositions.resize(size);
+            intersections.resize(size);
+        }
+    };
+
+    int m_depth;
+    /// @brief The number of bounces after which paths are terminated randomly based on their throughput.
+    int m_rouletteDepth;
+
+    /// @brief Computes the MIS weight of a light source that has been hit by a BSDF sample, like @ref Pathtracer .
+    float emissionWeight(const Light *light, const Point &origin, float lightPdf, float bsdfPdf) const {
+        if (!light) {
+            return 1;
+        }
+        return powerHeuristic(bsdfPdf, m_scene->lightSelectionProbability(light, origin) * lightPdf);
+    }
+
+    /**
+     * @brief Forwards to the sampler of a batch after seeding it for a stage of a path. Seeding is deferred until
+     * the first random number is drawn, as most intersection and shadow stages do not draw any.
+     * Paths traced through @ref Li use the sampler as given, since their stages are not interleaved with those of
+     * other paths.
+     */
+    class StageSampler : public Sampler {
+        Sampler &m_rng;
+        const PixelSample *m_sample;
+        int m_dimension;
+
+        void prepare() {
+            if (!m_sample)
+                return;
+            m_rng.seed(m_sample->pixel, m_sample->sampleIndex);
+            m_rng.skip(m_dimension);
+            m_sample = nullptr;
+        }
+
+    public:
+        StageSampler(Sampler &rng, const PixelSample *sample, int bounce, Stage stage)
+        : m_rng(rng), m_sample(sample), m_dimension(CameraDimensions + bounce * DimensionsPerBounce + stage) {}
+
+        float next() override {
+            prepare();
+            return m_rng.next();
+        }
+        Point2 next2D() override {
+            prepare();
+            return m_rng.next2D();
+        }
+        void skip(int count) override {
+            prepare();
+            m_rng.skip(count);
+        }
+        void seed(int index) override {
+            m_sample = nullptr;
+            m_rng.seed(index);
+        }
+        void seed(const Point2i &pixel, int sampleIndex) override {
+            m_sample = nullptr;
+            m_rng.seed(pixel, sampleIndex);
+        }
+        ref<Sampler> clone() const override { return m_rng.clone(); }
+        std::string toString() const override { return m_rng.toString(); }
+    };
+
+    /**
+     * @brief Sorts the active paths of the pool by the type and address of their BSDF into @ref Pool::hits .
+     * As scenes only contain few distinct BSDFs, this uses a counting sort, where paths that hit the same BSDF keep
+     * their order, and BSDFs are looked up by linear search.
+     */
+    static void sortByBsdf(Pool &pool) {
+        pool.bsdfs.clear();
+        pool.hitBsdfs.clear();
+
+        // neighboring paths often hit the same BSDF, which avoids most lookups
+        const Bsdf *previousBsdf = nullptr;
+        int previousIndex = -1;
+        for (int path : pool.active) {
+            const Bsdf *bsdf = pool.intersections[path].instance->bsdf();
+            if (bsdf != previousBsdf || previousIndex < 0) {
+                const auto it = std::find_if(pool.bsdfs.begin(), pool.bsdfs.end(),
+                                             [&](const auto &entry) { return entry.second == bsdf; });
+                previousIndex = int(it - pool.bsdfs.begin());
+                if (it == pool.bsdfs.end())
+                    pool.bsdfs.emplace_back(bsdf ? typeid(*bsdf).name() : nullptr, bsdf);
+                previousBsdf = bsdf;
+            }
+            pool.hitBsdfs.push_back(previousIndex);
+        }
+
+        // order the distinct BSDFs by type, and compute where the hits of each BSDF start
+        pool.bsdfOrder.resize(pool.bsdfs.size());
+        std::iota(pool.bsdfOrder.begin(), pool.bsdfOrder.end(), 0);
+        std::sort(pool.bsdfOrder.begin(), pool.bsdfOrder.end(),
+                  [&](int a, int b) { return pool.bsdfs[a] < pool.bsdfs[b]; });
+        pool.bsdfOffsets.assign(pool.bsdfs.size(), 0);
+        for (int index : pool.hitBsdfs)
+            pool.bsdfOffsets[index]++;
+        int offset = 0;
+        for (int index : pool.bsdfOrder)
+            offset += std::exchange(pool.bsdfOffsets[index], offset);
+
+        pool.hits.resize(pool.active.size());
+        for (size_t i = 0; i < pool.active.size(); i++)
+            pool.hits[pool.bsdfOffsets[pool.hitBsdfs[i]]++] = pool.active[i];
+    }
+
+    /// @brief Advances all paths of the pool until they have terminated.
+    void trace(Pool &pool, std::span<const PixelSample> samples, Sampler &rng) const {
+        const auto sampleOf = [&](int path) { return samples.empty() ? nullptr : &samples[path]; };
+
+        // all paths of the pool advance in lockstep, so that they are all at the same bounce
+        for (int bounce = 0; !pool.active.empty(); bounce++) {
+            // stage 1: find the closest intersection of each path, terminating paths that leave the scene
+            std::erase_if(pool.active, [&](int path) {
+                const Ray &ray = pool.rays[path];
+                StageSampler stageRng { rng, sampleOf(path), bounce, EIntersect };
+                pool.intersections[path] = m_scene->intersect(ray, stageRng, m_depth);
+                if (pool.intersections[path])
+                    return false;
+
+                Color background = m_scene->evaluateBackground(ray.direction).value;
+                if (const BackgroundLight *light = m_scene->background(); light && m_scene->hasLights()) {
+                    background *= emissionWeight(light, pool.previousPositions[path], light->pdfDirect(ray.direction),
+                                                 pool.bsdfPdfs[path]);
+                }
+                pool.radiance[path] += pool.throughput[path] * background;
+                return true;
+            });
+
+            // stage 2: evaluate the materials of all hits, grouped by BSDF
+            sortByBsdf(pool);
+
+            pool.shadowPaths.clear();
+            pool.shadowRays.clear();
+            pool.shadowDistances.clear();
+            pool.shadowContributions.clear();
+            pool.active.clear();
+            for (int path : pool.hits) {
+                const Intersection &its = pool.intersections[path];
+                StageSampler stageRng { rng, sampleOf(path), bounce, EMaterial };
+
+                Color emission = its.evaluateEmission();
+                if (emission != Color(0) && its.instance->light()) {
+                    const Light *light = its.instance->light();
+                    emission *= emissionWeight(light, pool.previousPositions[path],
+                                               light->pdfDirect(pool.previousPositions[path], its),
+                                               pool.bsdfPdfs[path]);
+                }
+                pool.radiance[path] += pool.throughput[path] * emission;
+
+                if (bounce + 1 >= m_depth)
+                    continue;
+
+                // next event estimation, weighted against hitting the light source through BSDF sampling (surfaces
+                // without a BSDF pass rays straight through, so light arriving there is found by continuing the path)
+                if (m_scene->hasLights() && its.instance->bsdf()) {
+                    const LightSample ls = m_scene->sampleLight(its.position, stageRng);
+                    const DirectLightSample dls =
+                        ls.isInvalid() ? DirectLightSample::invalid() : ls.light->sampleDirect(its.position, stageRng);
+                    const BsdfEval eval = dls.isInvalid() ? BsdfEval::invalid() : its.evaluateBsdf(dls.wi);
+                    if (!eval.isInvalid()) {
+                        const float weight = ls.light->canBeIntersected()
+                                                 ? powerHeuristic(ls.probability * dls.pdf, eval.pdf)
+                                                 : 1;
+                        pool.shadowPaths.push_back(path);
+                        pool.shadowRays.push_back(Ray(its.position, dls.wi));
+                        pool.shadowDistances.push_back(dls.distance);
+                        pool.shadowContributions.push_back(weight * pool.throughput[path] * dls.weight * eval.value /
+                                                           ls.probability);
+                    }
+                }
+
+                const BsdfSample sample = its.sampleBsdf(stageRng);
+                if (sample.isInvalid())
+                    continue;
+                pool.throughput[path] *= sample.weight;
+                pool.bsdfPdfs[path] = sample.pdf;
+                pool.previousPositions[path] = its.position;
+
+                // Russian roulette, like in Pathtracer
+                if (bounce + 1 >= m_rouletteDepth) {
+                    const float survivalProbability = std::min(pool.throughput[path].maxComponent(), 0.95f);
+                    if (stageRng.next() >= survivalProbability)
+                        continue;
+                    pool.throughput[path] /= survivalProbability;
+                }
+
+                pool.rays[path] = Ray(its.position, sample.wi, bounce + 1);
+                pool.active.push_back(path);
+            }
+
+            // stage 3: trace the shadow rays, adding the contributions of unoccluded lights
+            for (size_t i = 0; i < pool.shadowPaths.size(); i++) {
+                const int path = pool.shadowPaths[i];
+                StageSampler stageRng { rng, sampleOf(path), bounce, EShadow };
+                if (!m_scene->intersect(pool.shadowRays[i], pool.shadowDistances[i], stageRng))
+                    pool.radiance[path] += pool.shadowContributions[i];
+            }
+        }
+    }
+
+public:
+    WavefrontPathtracer(const Properties &properties)
+    : SamplingIntegrator(properties) {
+        m_depth = properties.get<int>("depth", 2);
+        m_rouletteDepth = properties.get<int>("rouletteDepth", 3);
+        m_batchSize = std::max(properties.get<int>("batchSize", 1024), 1);
+    }
+
+    void estimate(std::span<const PixelSample> samples, std::span<Color> results, Sampler &rng) override {
+        thread_local Pool pool;
+        pool.resize(samples.size());
+
+        // stage 0: generate the camera rays of all samples
+        pool.active.clear();
+        for (size_t path = 0; path < samples.size(); path++) {
+            rng.seed(samples[path].pixel, samples[path].sampleIndex);
+            const auto cameraSample = m_scene->camera()->sample(samples[path].pixel, rng);
+            pool.rays[path] = cameraSample.ray;
+            pool.throughput[path] = cameraSample.weight;
+            pool.radiance[path] = Color(0);
+            pool.bsdfPdfs[path] = Infinity;
+            pool.previousPositions[path] = cameraSample.ray.origin;
+            pool.active.push_back(int(path));
+        }
+
+        trace(pool, samples, rng);
+
+        // stage 4: accumulate the results
+        std::copy_n(pool.radiance.begin(), samples.size(), results.begin());
+    }
+
+    Color Li(const Ray &ray, Sampler &rng) override {
+        thread_local Pool pool;
+        pool.resize(1);
+        pool.rays[0] = ray;
+        pool.throughput[0] = Color(1);
+        pool.radiance[0] = Color(0);
+        pool.bsdfPdfs[0] = Infinity;
+        pool.previousPositions[0] = ray.origin;
+        pool.active = { 0 };
+        trace(pool, {}, rng);
+        return pool.radiance[0];
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "WavefrontPathtracer[\n"
+            "  sampler = %s,\n"
+            "  image = %s,\n"
+            "  depth = %s,\n"
+            "  rouletteDepth = %s,\n"
+            "  batchSize = %s,\n"
+            "]",
+            indent(m_sampler),
+            indent(m_image),
+            indent(m_depth),
+            indent(m_rouletteDepth),
+            indent(m_batchSize)
+        );
+    }
+};
+
+}
+
+REGISTER_INTEGRATOR(WavefrontPathtracer, "wavefront")
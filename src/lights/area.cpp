@@ -2,45 +2,165 @@
 
 namespace lightwave {
 
+/// @brief Enumerates the points of the Halton sequence, used to estimate properties of light sources deterministically.
+class HaltonSampler : public Sampler {
+    int m_index = 1;
+    int m_dimension = 0;
+
+    static float radicalInverse(int base, int index) {
+        float result = 0;
+        float scale = 1.f / base;
+        for (; index > 0; index /= base, scale /= base) {
+            result += (index % base) * scale;
+        }
+        return std::min(result, 1 - Epsilon);
+    }
+
+public:
+    float next() override {
+        static constexpr int primes[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+        return radicalInverse(primes[m_dimension++ % std::size(primes)], m_index);
+    }
+    void seed(int index) override {
+        m_index = index + 1;
+        m_dimension = 0;
+    }
+    void seed(const Point2i &pixel, int sampleIndex) override { seed(sampleIndex); }
+    ref<Sampler> clone() const override { return std::make_shared<HaltonSampler>(*this); }
+    std::string toString() const override { return "HaltonSampler[]"; }
+};
+
 class AreaLight final : public Light {
+    /// @brief The number of points on the shape used to estimate its power and orientation.
+    static constexpr int EstimationSamples = 64;
+
     /// @brief The shape representing the area light
     ref<Instance> m_instance;
+    /// @brief The estimated power emitted by the shape (from both sides).
+    float m_power;
+    /// @brief The normal of the shape if it is planar, or zero otherwise.
+    Vector m_planeNormal;
+
+    /// @brief Estimates the emitted power and whether the shape is planar from a fixed set of points on the shape.
+    void estimateEmission() {
+        HaltonSampler rng;
+        double radiance = 0;
+        m_planeNormal = Vector(0);
+        bool planar = true;
+        for (int i = 0; i < EstimationSamples; i++) {
+            rng.seed(i);
+            const AreaSample sample = m_instance->sampleArea(rng);
+            if (sample.pdf > 0) {
+                radiance += m_instance->emission()->evaluate(sample.uv, Vector(0, 0, 1)).value.mean() / sample.pdf;
+            }
+
+            if (i == 0) {
+                m_planeNormal = sample.frame.normal;
+            } else if (m_planeNormal.dot(sample.frame.normal) < 1 - 1e-4f) {
+                planar = false;
+            }
+        }
+        if (!planar) {
+            m_planeNormal = Vector(0);
+        }
+
+        // lambertian emitters emit pi times their radiance per area, and do so from both sides
+        m_power = float(2 * Pi * radiance / EstimationSamples);
+    }
 
 public:
     AreaLight(const Properties &properties) {
         this->m_instance = properties.getChild<Instance>();
+        this->m_instance->setLight(this);
+        estimateEmission();
     }
 
     DirectLightSample sampleDirect(const Point &origin,
                                    Sampler &rng) const override {
-        AreaSample sample = this->m_instance->sampleArea(rng);  
+        AreaSample sample = this->m_instance->sampleAreaFrom(origin, rng);
 
         const Vector wi = (sample.position - origin).normalized();
         const float distance = (sample.position - origin).length();
 
-        Color intensity = m_instance->emission()->evaluate(sample.uv, sample.frame.toLocal(-1*wi)).value;
-        intensity *= Frame::absCosTheta(sample.frame.toLocal(wi));
+        // convert the area density of the sample to a density in solid angle
+        const float cosTheta = Frame::absCosTheta(sample.frame.toLocal(wi));
+        if (sample.pdf <= 0 || cosTheta <= 0) {
+            return DirectLightSample::invalid();
+        }
+        const float pdf = sample.pdf * sqr(distance) / cosTheta;
 
-        // the next line is hardcoded for a sphere if radius 0.5
-        // fixme
-        // kreuzprodukt gibt an wie sich die fläche auf einem kleinen feld verändert
-        // in relation setzten und dann dann veränderung der größe
-        //intensity *= (1/sample.pdf)*sqr(0.5);
-        intensity *= sample.area;
+        const Color intensity = m_instance->emission()->evaluate(sample.uv, sample.frame.toLocal(-1*wi)).value;
 
         return DirectLightSample{
             .wi = wi,
-            .weight = intensity / sqr(distance),
-            .distance = distance
+            .weight = intensity / pdf,
+            .distance = distance,
+            .pdf = pdf,
         };
 
     }
 
-    bool canBeIntersected() const override { return false; }
+    float pdfDirect(const Point &origin, const SurfaceEvent &event) const override {
+        const Vector direction = event.position - origin;
+        const float cosTheta = abs(event.frame.normal.dot(direction.normalized()));
+        if (cosTheta <= 0) {
+            return 0;
+        }
+        // the density of intersections is that of area sampling, which the shape might refine for the origin
+        const float pdf = event.pdf * m_instance->pdfRatioFrom(origin, event.position);
+        return pdf * direction.lengthSquared() / cosTheta;
+    }
+
+    EmissionSample sampleEmission(const Bounds &sceneBounds, Sampler &rng) const override {
+        const AreaSample sample = m_instance->sampleArea(rng);
+        if (sample.pdf <= 0) {
+            return EmissionSample::invalid();
+        }
+
+        // light leaves either side of the surface, following a cosine-weighted distribution
+        Vector local = squareToCosineHemisphere(rng.next2D());
+        if (rng.next() < 0.5f) {
+            local = Vector(local.x(), local.y(), -local.z());
+        }
+        const Color radiance = m_instance->emission()->evaluate(sample.uv, local).value;
+        return EmissionSample{
+            .ray = Ray(sample.position, sample.frame.toWorld(local).normalized()),
+            .weight = 2 * Pi * radiance / sample.pdf,
+            .normal = sample.frame.normal,
+            .pdf = { sample.pdf, Frame::absCosTheta(local) * InvPi / 2 },
+            .light = nullptr,
+        };
+    }
+
+    EmissionPdf pdfEmission(const SurfaceEvent &event, const Vector &direction) const override {
+        return { event.pdf, std::abs(event.frame.normal.dot(direction)) * InvPi / 2 };
+    }
+
+    // the emission of the instance is already accounted for when it is hit by rays
+    bool canBeIntersected() const override { return m_instance->isVisible(); }
+
+    float power(const Bounds &sceneBounds) const override { return m_power; }
+
+    std::optional<LightBounds> bounds() const override {
+        const bool planar = !m_planeNormal.isZero();
+        return LightBounds{
+            .bounds = m_instance->getBoundingBox(),
+            .power = m_power,
+            .axis = planar ? m_planeNormal : Vector(0, 0, 1),
+            .cosThetaO = planar ? 1.f : -1.f,
+            .cosThetaE = 0,
+            .twoSided = true,
+        };
+    }
 
     std::string toString() const override {
         return tfm::format(
-            "AreaLight[\n");
+            "AreaLight[\n"
+            "  instance = %s,\n"
+            "  power = %s,\n"
+            "]",
+            indent(m_instance),
+            m_power);
     }
 };
 
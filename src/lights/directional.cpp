@@ -21,13 +21,36 @@ public:
         return DirectLightSample{
             .wi = wi,
             .weight = this->m_intensity,
-            .distance = Infinity
+            .distance = Infinity,
+            .pdf = Infinity,
         };
 
     }
 
+    EmissionSample sampleEmission(const Bounds &sceneBounds, Sampler &rng) const override {
+        // rays start on a disk that covers the scene, facing against the direction the light comes from
+        const float radius = sceneBounds.diagonal().length() / 2;
+        const Frame frame(this->m_direction);
+        const Point2 disk = squareToUniformDiskConcentric(rng.next2D());
+        const Point origin = sceneBounds.center() +
+            radius * (this->m_direction + disk.x() * frame.tangent + disk.y() * frame.bitangent);
+        return EmissionSample{
+            .ray = Ray(origin, -this->m_direction),
+            .weight = Pi * sqr(radius) * this->m_intensity,
+            .normal = Vector(0),
+            .pdf = { 0, 0 },
+            .light = nullptr,
+        };
+    }
+
     bool canBeIntersected() const override { return false; }
 
+    float power(const Bounds &sceneBounds) const override {
+        // the power passing through a disk that covers the scene
+        const float radius = sceneBounds.diagonal().length() / 2;
+        return Pi * sqr(radius) * this->m_intensity.mean();
+    }
+
     std::string toString() const override {
         return tfm::format(
             "DirectionalLight[\n"
@@ -2,6 +2,16 @@
 
 namespace lightwave {
 
+/**
+ * @brief A background light that looks up its radiance in a texture using an equirectangular (latitude-longitude)
+ * mapping of directions.
+ *
+ * Directions are importance sampled proportionally to the luminance of the texture, using a piecewise-constant
+ * distribution over a grid in texture coordinates (at the resolution of the texture), whose cells are weighted by the
+ * solid angle they cover. Optionally, the radiance and sampling density of all directions can be precomputed into a
+ * cube map (@c lookup ), which replaces the trigonometry, transform and texture lookup of every ray that leaves the
+ * scene by a single memory access, at the cost of filtering the texture to the resolution of the cube map.
+ */
 class EnvironmentMap final : public BackgroundLight {
     /// @brief The texture to use as background
     ref<Texture> m_texture;
@@ -9,58 +19,259 @@ class EnvironmentMap final : public BackgroundLight {
     /// @brief An optional transform from local-to-world space
     ref<Transform> m_transform;
 
-public:
-    EnvironmentMap(const Properties &properties) {
-        m_texture   = properties.getChild<Texture>();
-        m_transform = properties.getOptionalChild<Transform>();
+    /// @brief The resolution of the grid over texture coordinates from which directions are sampled.
+    Point2i m_resolution;
+    /// @brief Picks cells of the grid proportionally to their luminance times the solid angle they cover.
+    AliasTable m_distribution;
+
+    /// @brief The precomputed radiance and sampling density of the directions of a cell of the cube map.
+    struct LookupEntry {
+        Color value;
+        float pdf;
+    };
+    /// @brief The edge length (in cells) of the faces of the cube map, or zero if no lookup is precomputed.
+    int m_lookupResolution = 0;
+    /// @brief The cells of the six faces of the cube map, indexed by world space directions.
+    std::vector<LookupEntry> m_lookup;
+
+    /// @brief Maps a direction in local coordinates to texture coordinates.
+    static Point2 directionToUv(const Vector &direction) {
+        // Get theta angle (y points up, so take cos^-1 of y value)
+        const float theta = safe_acos(direction.y());
+        const float phi = -atan2(direction.z(), direction.x());
+        return { (phi + Pi) * Inv2Pi, theta * InvPi };
     }
 
-    BackgroundLightEval evaluate(const Vector &direction) const override {
-        // hints:
-        // * if (m_transform) { transform direction vector from world to local
-        // coordinates }
-        // * find the corresponding pixel coordinate for the given local
-        // direction
+    /// @brief Maps texture coordinates to a direction in local coordinates (the inverse of @ref directionToUv ).
+    static Vector uvToDirection(const Point2 &uv) {
+        const float phi = uv.x() * 2 * Pi - Pi;
+        const float theta = uv.y() * Pi;
+        const float sinTheta = std::sin(theta);
+        return { sinTheta * std::cos(phi), std::cos(theta), -sinTheta * std::sin(phi) };
+    }
+
+    Vector toLocal(const Vector &direction) const {
+        return (m_transform ? m_transform->inverse(direction) : direction).normalized();
+    }
+
+    Vector toWorld(const Vector &direction) const {
+        return (m_transform ? m_transform->apply(direction) : direction).normalized();
+    }
 
-        Vector newDirection = direction.normalized();
+    /// @brief Returns the probability density (in solid angle) of sampling the direction with the given texture
+    /// coordinates.
+    float pdfUv(const Point2 &uv) const {
+        const float sinTheta = sin(uv.y() * Pi);
+        if (sinTheta <= 0)
+            return 0;
+        const int x = std::clamp(int(uv.x() * m_resolution.x()), 0, m_resolution.x() - 1);
+        const int y = std::clamp(int(uv.y() * m_resolution.y()), 0, m_resolution.y() - 1);
+        // the density within the unit square of texture coordinates, which covers 2pi^2 sin(theta) in solid angle
+        const float pdf = m_distribution.pmf(y * m_resolution.x() + x) * m_resolution.x() * m_resolution.y();
+        return pdf / (2 * Pi * Pi * sinTheta);
+    }
 
-        if (this->m_transform) {
-            newDirection = this->m_transform->inverse(direction).normalized();
+    /// @brief Returns the index of the cell of the cube map that contains a given direction.
+    int lookupIndex(const Vector &direction) const {
+        // project onto the face of the axis with the largest component
+        const float ax = abs(direction.x()), ay = abs(direction.y()), az = abs(direction.z());
+        int face;
+        float major, s, t;
+        if (ax >= ay && ax >= az) {
+            face = direction.x() > 0 ? 0 : 1;
+            major = ax, s = direction.y(), t = direction.z();
+        } else if (ay >= az) {
+            face = direction.y() > 0 ? 2 : 3;
+            major = ay, s = direction.x(), t = direction.z();
+        } else {
+            face = direction.z() > 0 ? 4 : 5;
+            major = az, s = direction.x(), t = direction.y();
         }
+        if (!(major > 0))
+            return 0;
 
-        // Get theta angle (y points up, so take cos^-1 of y value)
-        const float theta = acos(newDirection.y());
-        const float phi = -atan2(newDirection.z(), newDirection.x());
+        const float scale = m_lookupResolution / (2 * major);
+        const int i = std::clamp(int((s + major) * scale), 0, m_lookupResolution - 1);
+        const int j = std::clamp(int((t + major) * scale), 0, m_lookupResolution - 1);
+        return (face * m_lookupResolution + j) * m_lookupResolution + i;
+    }
+
+    /// @brief Returns a direction through the given position on a face of the cube map (the inverse of
+    /// @ref lookupIndex ).
+    Vector lookupDirection(int face, float i, float j) const {
+        const float s = 2 * i / m_lookupResolution - 1;
+        const float t = 2 * j / m_lookupResolution - 1;
+        const float sign = face % 2 ? -1 : +1;
+        switch (face / 2) {
+        case 0: return Vector(sign, s, t).normalized();
+        case 1: return Vector(s, sign, t).normalized();
+        default: return Vector(s, t, sign).normalized();
+        }
+    }
+
+    /// @brief Builds the distribution that directions are sampled from.
+    void buildDistribution() {
+        // textures without a resolution (e.g., constant textures) are sampled on a coarse grid, and very large
+        // images are sampled on a grid of at most 2048x1024 cells
+        m_resolution = m_texture->resolution();
+        if (m_resolution.x() <= 0 || m_resolution.y() <= 0)
+            m_resolution = Point2i(64, 32);
+        m_resolution = Point2i(std::min(m_resolution.x(), 2048), std::min(m_resolution.y(), 1024));
+
+        // average each cell over several points, so that the luminance filtered into a cell from its neighbours
+        // (e.g., by bilinear interpolation) keeps it from being assigned a probability of zero
+        std::vector<float> weights(size_t(m_resolution.x()) * m_resolution.y());
+        for_each_parallel(Range(0, m_resolution.y()), [&](int y) {
+            const float sinTheta = sin((y + 0.5f) / m_resolution.y() * Pi);
+            for (int x = 0; x < m_resolution.x(); x++) {
+                float luminance = 0;
+                for (float dy : { 0.25f, 0.75f }) {
+                    for (float dx : { 0.25f, 0.75f }) {
+                        const Point2 uv = { (x + dx) / m_resolution.x(), (y + dy) / m_resolution.y() };
+                        luminance += std::max(m_texture->evaluate(uv).luminance(), 0.f) / 4;
+                    }
+                }
+                weights[y * m_resolution.x() + x] = std::isfinite(luminance) ? luminance * sinTheta : 0;
+            }
+        });
+        m_distribution = AliasTable(weights);
+    }
+
+    /// @brief Precomputes the radiance and sampling density of all directions into a cube map.
+    void buildLookup() {
+        // use twice the angular resolution of the texture around the horizon, as radiance that varies within a
+        // cell no longer matches the sampling distribution (which causes noise)
+        m_lookupResolution = std::clamp(m_resolution.x() / 2, 16, 1024);
+        m_lookup.resize(6 * size_t(sqr(m_lookupResolution)));
+        for_each_parallel(Range(0, 6 * m_lookupResolution), [&](int row) {
+            const int face = row / m_lookupResolution;
+            const int j = row % m_lookupResolution;
+            for (int i = 0; i < m_lookupResolution; i++) {
+                LookupEntry entry = { .value = Color(0), .pdf = 0 };
+                for (float dj : { 0.25f, 0.75f }) {
+                    for (float di : { 0.25f, 0.75f }) {
+                        const Point2 uv = directionToUv(toLocal(lookupDirection(face, i + di, j + dj)));
+                        entry.value += m_texture->evaluate(uv) / 4;
+                        entry.pdf += pdfUv(uv) / 4;
+                    }
+                }
+                m_lookup[(face * m_lookupResolution + j) * m_lookupResolution + i] = entry;
+            }
+        });
+    }
 
-        Vector2 warped = Vector2((phi + Pi) * Inv2Pi, theta * InvPi);
+public:
+    EnvironmentMap(const Properties &properties) {
+        m_texture   = properties.getChild<Texture>();
+        m_transform = properties.getOptionalChild<Transform>();
+
+        buildDistribution();
+        if (properties.get<bool>("lookup", false)) {
+            buildLookup();
+        }
+    }
 
+    BackgroundLightEval evaluate(const Vector &direction) const override {
+        if (m_lookupResolution) {
+            return { .value = m_lookup[lookupIndex(direction)].value };
+        }
         return {
-            .value = m_texture->evaluate(warped),
+            .value = m_texture->evaluate(directionToUv(toLocal(direction))),
         };
     }
 
     DirectLightSample sampleDirect(const Point &origin,
                                    Sampler &rng) const override {
-        Vector direction = squareToUniformSphere(rng.next2D());
-        auto E           = evaluate(direction);
+        // pick a cell and a uniformly distributed point within it
+        const int cell = m_distribution.sample(rng.next());
+        const Point2 offset = rng.next2D();
+        const Point2 uv = {
+            (cell % m_resolution.x() + offset.x()) / m_resolution.x(),
+            (cell / m_resolution.x() + offset.y()) / m_resolution.y(),
+        };
+        const float pdf = pdfUv(uv);
+        if (pdf <= 0) {
+            return DirectLightSample::invalid();
+        }
 
-        // implement better importance sampling here, if you ever need it
-        // (useful for environment maps with bright tiny light sources, like the
-        // sun for example)
+        const Vector direction = toWorld(uvToDirection(uv));
+        if (m_lookupResolution) {
+            // the precomputed density is used for weighting samples (e.g., with MIS) consistently with
+            // pdfDirect, while the weight needs the exact density of the sample
+            const LookupEntry &entry = m_lookup[lookupIndex(direction)];
+            return {
+                .wi     = direction,
+                .weight = entry.value / pdf,
+                .distance = Infinity,
+                .pdf = entry.pdf,
+            };
+        }
 
         return {
             .wi     = direction,
-            .weight = E.value / Inv4Pi,
+            .weight = m_texture->evaluate(uv) / pdf,
             .distance = Infinity,
+            .pdf = pdf,
         };
     }
 
+    float pdfDirect(const Vector &direction) const override {
+        if (m_lookupResolution) {
+            return m_lookup[lookupIndex(direction)].pdf;
+        }
+        return pdfUv(directionToUv(toLocal(direction)));
+    }
+
+    EmissionSample sampleEmission(const Bounds &sceneBounds, Sampler &rng) const override {
+        // light arrives from a sampled direction, through a disk that covers the scene
+        const DirectLightSample sample = sampleDirect(sceneBounds.center(), rng);
+        if (sample.isInvalid()) {
+            return EmissionSample::invalid();
+        }
+
+        const float radius = sceneBounds.diagonal().length() / 2;
+        const Frame frame(sample.wi);
+        const Point2 disk = squareToUniformDiskConcentric(rng.next2D());
+        const Point origin = sceneBounds.center() +
+            radius * (sample.wi + disk.x() * frame.tangent + disk.y() * frame.bitangent);
+        return EmissionSample{
+            .ray = Ray(origin, -sample.wi),
+            .weight = Pi * sqr(radius) * sample.weight,
+            .normal = Vector(0),
+            .pdf = { 0, 0 },
+            .light = nullptr,
+        };
+    }
+
+    float power(const Bounds &sceneBounds) const override {
+        // average the radiance over the sphere of directions on a grid of equal angles, weighted by the area of
+        // the cells
+        constexpr int resolution = 64;
+        double radiance = 0, totalWeight = 0;
+        for (int y = 0; y < resolution; y++) {
+            const float theta = (y + 0.5f) * Pi / resolution;
+            for (int x = 0; x < 2 * resolution; x++) {
+                const float phi = (x + 0.5f) * Pi / resolution;
+                const float sinTheta = std::sin(theta);
+                const Vector direction = { sinTheta * std::cos(phi), std::cos(theta), sinTheta * std::sin(phi) };
+                radiance += sinTheta * evaluate(toWorld(direction)).value.mean();
+                totalWeight += sinTheta;
+            }
+        }
+
+        // the power passing through a disk that covers the scene, from all directions
+        const float radius = sceneBounds.diagonal().length() / 2;
+        return 4 * Pi * Pi * sqr(radius) * float(radiance / totalWeight);
+    }
+
     std::string toString() const override {
         return tfm::format("EnvironmentMap[\n"
                            "  texture = %s,\n"
-                           "  transform = %s\n"
+                           "  transform = %s,\n"
+                           "  resolution = %s,\n"
+                           "  lookup = %d\n"
                            "]",
-                           indent(m_texture), indent(m_transform));
+                           indent(m_texture), indent(m_transform), m_resolution, m_lookupResolution);
     }
 };
 
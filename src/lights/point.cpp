@@ -26,13 +26,43 @@ public:
         return DirectLightSample{
             .wi = wi,
             .weight = intensity / sqr(distance),
-            .distance = distance
+            .distance = distance,
+            .pdf = Infinity,
         };
 
     }
 
+    EmissionSample sampleEmission(const Bounds &sceneBounds, Sampler &rng) const override {
+        // all directions are equally likely, so that every ray carries the entire power
+        return EmissionSample{
+            .ray = Ray(this->m_position, squareToUniformSphere(rng.next2D())),
+            .weight = this->m_power,
+            .normal = Vector(0),
+            .pdf = { 1, Inv4Pi },
+            .light = nullptr,
+        };
+    }
+
+    EmissionPdf pdfEmission(const SurfaceEvent &event, const Vector &direction) const override {
+        return { 1, Inv4Pi };
+    }
+
     bool canBeIntersected() const override { return false; }
 
+    float power(const Bounds &sceneBounds) const override { return this->m_power.mean(); }
+
+    std::optional<LightBounds> bounds() const override {
+        // emits into all directions
+        return LightBounds{
+            .bounds = Bounds(this->m_position, this->m_position),
+            .power = this->m_power.mean(),
+            .axis = Vector(0, 0, 1),
+            .cosThetaO = -1,
+            .cosThetaE = 0,
+            .twoSided = false,
+        };
+    }
+
     std::string toString() const override {
         return tfm::format(
             "PointLight[\n"
@@ -0,0 +1,429 @@
+#include <lightwave.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef LW_OS_WINDOWS
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lightwave {
+
+/// @brief A read-only view of a file that is mapped into memory, so that large volumes are only paged in as needed.
+class MappedFile {
+    const std::byte *m_data = nullptr;
+    size_t m_size = 0;
+#ifdef LW_OS_WINDOWS
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#endif
+
+public:
+    MappedFile(const std::filesystem::path &path) {
+#ifdef LW_OS_WINDOWS
+        m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+        LARGE_INTEGER size;
+        if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size)) {
+            lightwave_throw("could not open volume %s", path);
+        }
+        m_size = size_t(size.QuadPart);
+        m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_mapping) {
+            m_data = static_cast<const std::byte *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+#else
+        const int file = open(path.c_str(), O_RDONLY);
+        struct stat status;
+        if (file < 0 || fstat(file, &status) != 0) {
+            if (file >= 0)
+                close(file);
+            lightwave_throw("could not open volume %s", path);
+        }
+        m_size = size_t(status.st_size);
+        void *data = m_size ? mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+        // the mapping stays valid after closing the file
+        close(file);
+        if (data != MAP_FAILED) {
+            m_data = static_cast<const std::byte *>(data);
+        }
+#endif
+        if (!m_data) {
+            lightwave_throw("could not map volume %s into memory", path);
+        }
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile() {
+#ifdef LW_OS_WINDOWS
+        if (m_data)
+            UnmapViewOfFile(m_data);
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+#else
+        if (m_data)
+            munmap(const_cast<std::byte *>(m_data), m_size);
+#endif
+    }
+
+    const std::byte *data() const { return m_data; }
+    size_t size() const { return m_size; }
+};
+
+/**
+ * @brief A heterogeneous medium whose density is given by a grid of voxels, read from a volume file that spans the cube
+ * [-1,-1,-1] to [+1,+1,+1] (placed in the scene by an optional transform, which usually matches that of the instance
+ * containing the medium).
+ *
+ * Volume files start with a 32 byte header, followed by the densities as 32 bit floats (x varying fastest):
+ * - the magic "LWVG" and a version (1), both 4 bytes
+ * - the edge length of bricks in voxels (4 bytes), or zero for dense volumes
+ * - the resolution of the volume in voxels (3 x 4 bytes)
+ * - the number of bricks stored in the file (8 bytes, zero for dense volumes)
+ *
+ * Dense volumes store the density of every voxel. Sparse volumes store a table with one 32 bit index per brick
+ * (-1 for bricks that are empty), followed by the densities of the stored bricks.
+ *
+ * Densities are interpolated trilinearly between voxel centers and scaled by @c sigmaT . Distances are sampled by
+ * delta tracking and transmittance is estimated by ratio tracking, both against a coarse grid of majorants (the
+ * maximal density within each of its cells) that is traversed with a 3D DDA, so that the number of tentative
+ * collisions only depends on the density of the regions a ray passes through.
+ */
+class GridMedium : public Medium {
+    /// @brief The header at the start of volume files.
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t brickSize;
+        int32_t resolution[3];
+        uint64_t brickCount;
+    };
+    static_assert(sizeof(Header) == 32);
+
+    /// @brief The number of voxels along each axis.
+    Vector3i m_resolution;
+    /// @brief The edge length of bricks (or zero for dense volumes).
+    int m_brickSize;
+    /// @brief The number of bricks along each axis (for sparse volumes).
+    Vector3i m_brickResolution;
+
+    std::unique_ptr<MappedFile> m_file;
+    /// @brief The brick table of sparse volumes (points into the mapped file).
+    const int32_t *m_bricks = nullptr;
+    /// @brief The densities of the voxels or bricks (points into the mapped file).
+    const float *m_densities = nullptr;
+
+    /// @brief The number of cells of the majorant grid along each axis.
+    Vector3i m_majorantResolution;
+    /// @brief The maximal density within each cell of the majorant grid.
+    std::vector<float> m_majorants;
+    /// @brief The maximal density of the whole volume.
+    float m_maxDensity;
+
+    float m_sigmaT;
+    Color m_color;
+    ref<Emission> m_emission;
+    ref<Transform> m_transform;
+
+    /// @brief The survival probability of ratio tracking once the transmittance has fallen below @ref RouletteThreshold .
+    static constexpr float RouletteSurvival = 0.75f;
+    static constexpr float RouletteThreshold = 0.05f;
+
+    /// @brief Loads a volume file and checks that its contents are consistent.
+    void load(const std::filesystem::path &path) {
+        logger(EInfo, "loading volume %s", path);
+        m_file = std::make_unique<MappedFile>(path);
+
+        Header header;
+        if (m_file->size() < sizeof(Header)) {
+            lightwave_throw("volume %s is too small", path);
+        }
+        std::memcpy(&header, m_file->data(), sizeof(Header));
+        if (std::memcmp(header.magic, "LWVG", 4) != 0 || header.version != 1) {
+            lightwave_throw("volume %s has an unsupported format", path);
+        }
+
+        m_resolution = Vector3i(header.resolution[0], header.resolution[1], header.resolution[2]);
+        m_brickSize = int(header.brickSize);
+        if (m_resolution.x() <= 0 || m_resolution.y() <= 0 || m_resolution.z() <= 0) {
+            lightwave_throw("volume %s has an invalid resolution", path);
+        }
+
+        // the brick table (if any) precedes the densities
+        size_t tableBytes = 0;
+        size_t densityCount = size_t(m_resolution.x()) * m_resolution.y() * m_resolution.z();
+        if (m_brickSize > 0) {
+            for (int axis = 0; axis < 3; axis++) {
+                m_brickResolution[axis] = (m_resolution[axis] + m_brickSize - 1) / m_brickSize;
+            }
+            const size_t tableSize = size_t(m_brickResolution.x()) * m_brickResolution.y() * m_brickResolution.z();
+            tableBytes = sizeof(int32_t) * tableSize;
+            densityCount = header.brickCount * size_t(m_brickSize) * m_brickSize * m_brickSize;
+        }
+
+        const size_t expectedSize = sizeof(Header) + tableBytes + sizeof(float) * densityCount;
+        if (m_file->size() < expectedSize) {
+            lightwave_throw("volume %s is truncated (%d bytes instead of %d)", path, m_file->size(), expectedSize);
+        }
+        m_densities = reinterpret_cast<const float *>(m_file->data() + sizeof(Header) + tableBytes);
+
+        if (m_brickSize > 0) {
+            m_bricks = reinterpret_cast<const int32_t *>(m_file->data() + sizeof(Header));
+            for (size_t brick = 0; brick < tableBytes / sizeof(int32_t); brick++) {
+                if (m_bricks[brick] < -1 || m_bricks[brick] >= int64_t(header.brickCount)) {
+                    lightwave_throw("volume %s refers to brick %d, but only has %d", path, m_bricks[brick],
+                                    header.brickCount);
+                }
+            }
+        }
+    }
+
+    /// @brief Returns the density of a voxel, clamping indices to the volume.
+    float voxel(int x, int y, int z) const {
+        x = std::clamp(x, 0, m_resolution.x() - 1);
+        y = std::clamp(y, 0, m_resolution.y() - 1);
+        z = std::clamp(z, 0, m_resolution.z() - 1);
+        if (!m_bricks) {
+            return m_densities[(size_t(z) * m_resolution.y() + y) * m_resolution.x() + x];
+        }
+
+        const int brick = m_bricks[(size_t(z / m_brickSize) * m_brickResolution.y() + y / m_brickSize) *
+                                   m_brickResolution.x() + x / m_brickSize];
+        if (brick < 0) {
+            return 0;
+        }
+        const int bx = x % m_brickSize, by = y % m_brickSize, bz = z % m_brickSize;
+        return m_densities[(size_t(brick) * m_brickSize + bz) * m_brickSize * m_brickSize + by * m_brickSize + bx];
+    }
+
+    /// @brief Returns the trilinearly interpolated density at a point in grid coordinates ([0,1]^3), or zero outside.
+    float density(const Point &p) const {
+        if (p.x() < 0 || p.y() < 0 || p.z() < 0 || p.x() > 1 || p.y() > 1 || p.z() > 1) {
+            return 0;
+        }
+
+        const float x = p.x() * m_resolution.x() - 0.5f;
+        const float y = p.y() * m_resolution.y() - 0.5f;
+        const float z = p.z() * m_resolution.z() - 0.5f;
+        const int x0 = int(std::floor(x)), y0 = int(std::floor(y)), z0 = int(std::floor(z));
+        const float fx = x - x0, fy = y - y0, fz = z - z0;
+
+        const auto lerp = [](float a, float b, float t) { return (1 - t) * a + t * b; };
+        const float d00 = lerp(voxel(x0, y0,     z0    ), voxel(x0 + 1, y0,     z0    ), fx);
+        const float d10 = lerp(voxel(x0, y0 + 1, z0    ), voxel(x0 + 1, y0 + 1, z0    ), fx);
+        const float d01 = lerp(voxel(x0, y0,     z0 + 1), voxel(x0 + 1, y0,     z0 + 1), fx);
+        const float d11 = lerp(voxel(x0, y0 + 1, z0 + 1), voxel(x0 + 1, y0 + 1, z0 + 1), fx);
+        return lerp(lerp(d00, d10, fy), lerp(d01, d11, fy), fz);
+    }
+
+    /// @brief Computes the maximal density within each cell of the majorant grid.
+    void buildMajorants(int resolution) {
+        for (int axis = 0; axis < 3; axis++) {
+            m_majorantResolution[axis] = std::clamp(resolution, 1, m_resolution[axis]);
+        }
+        m_majorants.resize(size_t(m_majorantResolution.x()) * m_majorantResolution.y() * m_majorantResolution.z());
+
+        // the range of voxels that influence the interpolated density within a cell along an axis
+        const auto voxelRange = [&](int axis, int cell) {
+            const float lo = float(cell) / m_majorantResolution[axis] * m_resolution[axis] - 0.5f;
+            const float hi = float(cell + 1) / m_majorantResolution[axis] * m_resolution[axis] - 0.5f;
+            return std::pair {
+                std::max(int(std::floor(lo)), 0),
+                std::min(int(std::floor(hi)) + 1, m_resolution[axis] - 1),
+            };
+        };
+
+        for_each_parallel(Range(0, m_majorantResolution.z()), [&](int cz) {
+            const auto [z0, z1] = voxelRange(2, cz);
+            for (int cy = 0; cy < m_majorantResolution.y(); cy++) {
+                const auto [y0, y1] = voxelRange(1, cy);
+                for (int cx = 0; cx < m_majorantResolution.x(); cx++) {
+                    const auto [x0, x1] = voxelRange(0, cx);
+                    float majorant = 0;
+                    for (int z = z0; z <= z1; z++)
+                        for (int y = y0; y <= y1; y++)
+                            for (int x = x0; x <= x1; x++)
+                                majorant = std::max(majorant, voxel(x, y, z));
+                    m_majorants[(size_t(cz) * m_majorantResolution.y() + cy) * m_majorantResolution.x() + cx] =
+                        majorant;
+                }
+            }
+        });
+
+        m_maxDensity = 0;
+        for (float majorant : m_majorants) {
+            m_maxDensity = std::max(m_maxDensity, majorant);
+        }
+    }
+
+    /// @brief Maps a ray to grid coordinates ([0,1]^3), keeping the parametrization of distances along the ray.
+    Ray toGrid(const Ray &ray) const {
+        const Ray local = m_transform ? m_transform->inverse(ray) : ray;
+        return Ray(Point(0.5f) + Vector(local.origin) / 2, local.direction / 2, ray.depth);
+    }
+
+    /**
+     * @brief Traverses the cells of the majorant grid along a ray in grid coordinates up to a given distance (3D DDA),
+     * calling @c visit with the start and end distance and the majorant of each segment, until it returns false.
+     */
+    template<typename F>
+    void traverse(const Ray &ray, float tMax, F &&visit) const {
+        // clip the ray against the bounds of the volume
+        float tMin = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            const float inverse = 1 / ray.direction[axis];
+            float tNear = -ray.origin[axis] * inverse;
+            float tFar = (1 - ray.origin[axis]) * inverse;
+            if (tNear > tFar)
+                std::swap(tNear, tFar);
+            tMin = std::max(tMin, std::isnan(tNear) ? tMin : tNear);
+            tMax = std::min(tMax, std::isnan(tFar) ? tMax : tFar);
+        }
+        if (!(tMin < tMax)) {
+            return;
+        }
+
+        const Point start = ray(tMin);
+        int cell[3], step[3], exit[3];
+        float tNext[3], tDelta[3];
+        for (int axis = 0; axis < 3; axis++) {
+            const int resolution = m_majorantResolution[axis];
+            cell[axis] = std::clamp(int(start[axis] * resolution), 0, resolution - 1);
+            if (ray.direction[axis] == 0) {
+                step[axis] = 0, exit[axis] = -1;
+                tNext[axis] = Infinity, tDelta[axis] = Infinity;
+            } else if (ray.direction[axis] > 0) {
+                step[axis] = +1, exit[axis] = resolution;
+                tNext[axis] = tMin + (float(cell[axis] + 1) / resolution - start[axis]) / ray.direction[axis];
+                tDelta[axis] = 1 / (resolution * ray.direction[axis]);
+            } else {
+                step[axis] = -1, exit[axis] = -1;
+                tNext[axis] = tMin + (float(cell[axis]) / resolution - start[axis]) / ray.direction[axis];
+                tDelta[axis] = -1 / (resolution * ray.direction[axis]);
+            }
+        }
+
+        float t = tMin;
+        while (true) {
+            const int axis = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+            const float tEnd = std::min(tNext[axis], tMax);
+            const float majorant = m_majorants[(size_t(cell[2]) * m_majorantResolution.y() + cell[1]) *
+                                               m_majorantResolution.x() + cell[0]];
+            if (!visit(t, tEnd, m_sigmaT * majorant) || tEnd >= tMax) {
+                return;
+            }
+
+            t = tEnd;
+            cell[axis] += step[axis];
+            if (cell[axis] == exit[axis]) {
+                return;
+            }
+            tNext[axis] += tDelta[axis];
+        }
+    }
+
+public:
+    GridMedium(const Properties &properties) {
+        m_sigmaT = properties.get<float>("sigmaT", 1);
+        m_color = properties.get<Color>("color", Color(0));
+        m_emission = properties.getOptionalChild<Emission>();
+        m_transform = properties.getOptionalChild<Transform>();
+
+        load(properties.get<std::filesystem::path>("filename"));
+        buildMajorants(properties.get<int>("majorantResolution", 16));
+    }
+
+    Emission *emission() const override { return m_emission.get(); }
+
+    float Tr(const Ray &ray, const float tIntersection, Sampler &rng) const override {
+        // ratio tracking: the product of the probabilities of tentative collisions being null collisions
+        const Ray grid = toGrid(ray);
+        float transmittance = 1;
+        traverse(grid, tIntersection, [&](float tMin, float tMax, float majorant) {
+            if (majorant <= 0)
+                return true;
+            for (float t = tMin - std::log(1 - rng.next()) / majorant; t < tMax;
+                 t -= std::log(1 - rng.next()) / majorant) {
+                transmittance *= 1 - m_sigmaT * density(grid(t)) / majorant;
+
+                // terminate paths through dense regions early
+                if (transmittance < RouletteThreshold) {
+                    if (rng.next() >= RouletteSurvival) {
+                        transmittance = 0;
+                        return false;
+                    }
+                    transmittance /= RouletteSurvival;
+                }
+            }
+            return true;
+        });
+        return transmittance;
+    }
+
+    float sampleHitDistance(const Ray &ray, Sampler &rng) const override {
+        // delta tracking: tentative collisions are sampled with the majorant and accepted with the ratio of the
+        // density to the majorant
+        const Ray grid = toGrid(ray);
+        float hitDistance = Infinity;
+        traverse(grid, Infinity, [&](float tMin, float tMax, float majorant) {
+            if (majorant <= 0)
+                return true;
+            for (float t = tMin - std::log(1 - rng.next()) / majorant; t < tMax;
+                 t -= std::log(1 - rng.next()) / majorant) {
+                if (rng.next() * majorant < m_sigmaT * density(grid(t))) {
+                    hitDistance = t;
+                    return false;
+                }
+            }
+            return true;
+        });
+        return hitDistance;
+    }
+
+    /// @note Free-flight probabilities only have a closed form along a given ray, so this reports them for the
+    /// homogeneous medium of the maximal density instead (i.e., for tentative collisions).
+    float probabilityOfSampelingBeforeT(float t) const override {
+        return exp(-m_sigmaT * m_maxDensity * t);
+    }
+
+    /// @note See @ref probabilityOfSampelingBeforeT .
+    float probabilityOfSampelingThisPoint(float t) const override {
+        return m_sigmaT * m_maxDensity * exp(-m_sigmaT * m_maxDensity * t);
+    }
+
+    Color getColor() const override {
+        return m_color;
+    }
+
+    float getSigmaS() const override {
+        return m_sigmaT * m_color.mean();
+    }
+
+    Vector samplePhase(Intersection &its, Sampler &rng) const override {
+        return squareToUniformSphere(rng.next2D());
+    }
+
+    std::string toString() const override {
+        return tfm::format("Grid medium[\n"
+                           "  resolution = %s,\n"
+                           "  brick size = %d,\n"
+                           "  majorants = %s,\n"
+                           "  density = %s\n"
+                           "]",
+                           m_resolution, m_brickSize, m_majorantResolution, m_sigmaT);
+    }
+};
+
+} // namespace lightwave
+
+REGISTER_CLASS(GridMedium, "medium", "grid")
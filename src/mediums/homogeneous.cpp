@@ -39,6 +39,8 @@ public:
         return m_sigmaT*exp(-m_sigmaT*t);
     }
 
+    bool isHomogeneous() const override { return true; }
+
     Color getColor() const override {
         return m_color;
     }
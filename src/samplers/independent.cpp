@@ -1,7 +1,9 @@
 #include <lightwave.hpp>
 
+#include <array>
 #include <functional>
 #include "pcg32.h"
+#include "pcg32x8.h"
 
 namespace lightwave {
 
@@ -10,11 +12,25 @@ namespace lightwave {
  * This is the simplest form of random number generation, and will be sufficient for our introduction to Computer Graphics.
  * If you want to reduce the noise in your renders, a simple way is to implement more sophisticated random numbers (e.g.,
  * jittered sampling or blue noise sampling).
- * @see Internally, this sampler uses the PCG32 library to generate random numbers.
+ * @see Internally, this sampler uses the PCG32 library to generate random numbers, which are generated eight at a
+ * time using SIMD instructions (see @ref pcg32x8::nextFloats ). The sequence of numbers is identical to generating
+ * them one at a time.
  */
 class Independent : public Sampler {
     uint64_t m_seed;
     pcg32 m_pcg;
+    /// @brief Random numbers that have been generated ahead of time, of which the last @ref m_buffered have not
+    /// been returned yet.
+    std::array<float, 8> m_buffer;
+    int m_buffered = 0;
+
+    float nextBuffered() {
+        if (!m_buffered) {
+            pcg32x8::nextFloats(m_pcg, m_buffer);
+            m_buffered = int(m_buffer.size());
+        }
+        return m_buffer[m_buffer.size() - m_buffered--];
+    }
 
 public:
     Independent(const Properties &properties)
@@ -24,16 +40,37 @@ public:
 
     void seed(int sampleIndex) override {
         m_pcg.seed(m_seed, sampleIndex);
+        m_buffered = 0;
     }
 
     void seed(const Point2i &pixel, int sampleIndex) override {
         const uint64_t a = (uint64_t(pixel.x()) << 32) ^ pixel.y();
         m_pcg.seed(m_seed, a);
         m_pcg.seed(m_pcg.nextUInt(), sampleIndex);
+        m_buffered = 0;
     }
 
     float next() override {
-        return m_pcg.nextFloat();
+        return nextBuffered();
+    }
+
+    Point2 next2D() override {
+        const float x = nextBuffered();
+        return { x, nextBuffered() };
+    }
+
+    void nextBatch(std::span<float> values) override {
+        // return the numbers that have already been generated first
+        const size_t buffered = std::min(values.size(), size_t(m_buffered));
+        for (size_t i = 0; i < buffered; i++)
+            values[i] = nextBuffered();
+        pcg32x8::nextFloats(m_pcg, values.subspan(buffered));
+    }
+
+    void skip(int count) override {
+        const int buffered = std::min(count, m_buffered);
+        m_buffered -= buffered;
+        m_pcg.advance(count - buffered);
     }
 
     ref<Sampler> clone() const override {
@@ -0,0 +1,125 @@
+/**
+ * @file pcg32x8.h
+ * @brief Generates batches of random numbers from a @ref pcg32 generator using AVX2, computing eight consecutive
+ * outputs of the sequence at once.
+ */
+
+#pragma once
+
+#include "pcg32.h"
+
+#include <cstring>
+#include <span>
+
+// the AVX2 kernel can be disabled by defining LW_NO_AVX2 (e.g., to compare against the scalar implementation)
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__)) && !defined(LW_NO_AVX2)
+#define LW_PCG32_AVX2
+#include <immintrin.h>
+#endif
+
+namespace lightwave::pcg32x8 {
+
+/// @brief The factors and summands that advance a PCG32 state by i steps (for i = 0 to 8), such that
+/// state_i = multipliers[i] * state_0 + increments[i] * inc.
+struct JumpTable {
+    uint64_t multipliers[9];
+    uint64_t increments[9];
+
+    constexpr JumpTable() : multipliers(), increments() {
+        multipliers[0] = 1;
+        increments[0]  = 0;
+        for (int i = 1; i <= 8; i++) {
+            multipliers[i] = multipliers[i - 1] * PCG32_MULT;
+            increments[i]  = increments[i - 1] * PCG32_MULT + 1;
+        }
+    }
+};
+
+inline constexpr JumpTable jumpTable;
+
+/// @brief Fills the given span with consecutive floats of the sequence, using the scalar implementation.
+inline void nextFloatsScalar(pcg32 &rng, std::span<float> values) {
+    for (float &value : values)
+        value = rng.nextFloat();
+}
+
+#ifdef LW_PCG32_AVX2
+
+/// @brief Multiplies the 64-bit lanes of two vectors (AVX2 only provides 32-bit multiplications).
+__attribute__((target("avx2"))) inline __m256i mul64(__m256i a, __m256i b) {
+    const __m256i low   = _mm256_mul_epu32(a, b);
+    const __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                           _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+}
+
+/// @brief Computes the PCG32 output permutation (XSH RR) of eight states, given as two vectors of four states.
+__attribute__((target("avx2"))) inline __m256i output(__m256i states0, __m256i states1) {
+    // the low 32 bits of each 64-bit lane hold the shifted value and the rotation
+    const __m256i xorshifted0 = _mm256_srli_epi64(_mm256_xor_si256(_mm256_srli_epi64(states0, 18), states0), 27);
+    const __m256i xorshifted1 = _mm256_srli_epi64(_mm256_xor_si256(_mm256_srli_epi64(states1, 18), states1), 27);
+    const __m256i rot0        = _mm256_srli_epi64(states0, 59);
+    const __m256i rot1        = _mm256_srli_epi64(states1, 59);
+
+    // gather the low 32 bits of all lanes into one vector, keeping the order of the states
+    const __m256i compact = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const __m256i xorshifted =
+        _mm256_permute2x128_si256(_mm256_permutevar8x32_epi32(xorshifted0, compact),
+                                  _mm256_permutevar8x32_epi32(xorshifted1, compact), 0x20);
+    const __m256i rot = _mm256_permute2x128_si256(_mm256_permutevar8x32_epi32(rot0, compact),
+                                                  _mm256_permutevar8x32_epi32(rot1, compact), 0x20);
+
+    const __m256i leftRot = _mm256_and_si256(_mm256_sub_epi32(_mm256_setzero_si256(), rot), _mm256_set1_epi32(31));
+    return _mm256_or_si256(_mm256_srlv_epi32(xorshifted, rot), _mm256_sllv_epi32(xorshifted, leftRot));
+}
+
+/// @brief Fills the given span with consecutive floats of the sequence, computing eight at a time with AVX2.
+__attribute__((target("avx2"))) inline void nextFloatsAvx2(pcg32 &rng, std::span<float> values) {
+    const size_t blocks = values.size() / 8;
+    if (blocks) {
+        __m256i multipliers0, multipliers1, increments0, increments1;
+        std::memcpy(&multipliers0, jumpTable.multipliers, 32);
+        std::memcpy(&multipliers1, jumpTable.multipliers + 4, 32);
+        std::memcpy(&increments0, jumpTable.increments, 32);
+        std::memcpy(&increments1, jumpTable.increments + 4, 32);
+        const __m256i inc = _mm256_set1_epi64x(int64_t(rng.inc));
+        increments0       = mul64(increments0, inc);
+        increments1       = mul64(increments1, inc);
+
+        const uint64_t blockMultiplier = jumpTable.multipliers[8];
+        const uint64_t blockIncrement  = jumpTable.increments[8] * rng.inc;
+
+        const __m256i floatOne = _mm256_castps_si256(_mm256_set1_ps(1.0f));
+        for (size_t block = 0; block < blocks; block++) {
+            const __m256i state   = _mm256_set1_epi64x(int64_t(rng.state));
+            const __m256i states0 = _mm256_add_epi64(mul64(multipliers0, state), increments0);
+            const __m256i states1 = _mm256_add_epi64(mul64(multipliers1, state), increments1);
+            rng.state             = rng.state * blockMultiplier + blockIncrement;
+
+            // same as pcg32::nextFloat
+            const __m256i bits = _mm256_or_si256(_mm256_srli_epi32(output(states0, states1), 9), floatOne);
+            _mm256_storeu_ps(values.data() + 8 * block,
+                             _mm256_sub_ps(_mm256_castsi256_ps(bits), _mm256_set1_ps(1.0f)));
+        }
+    }
+    nextFloatsScalar(rng, values.subspan(8 * blocks));
+}
+
+#endif
+
+/**
+ * @brief Fills the given span with the next floats of the sequence, which are bit-exact to calling
+ * @ref pcg32::nextFloat for each of them. Uses AVX2 when supported by the processor.
+ */
+inline void nextFloats(pcg32 &rng, std::span<float> values) {
+#ifdef LW_PCG32_AVX2
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    if (hasAvx2) {
+        nextFloatsAvx2(rng, values);
+        return;
+    }
+#endif
+    nextFloatsScalar(rng, values);
+}
+
+}
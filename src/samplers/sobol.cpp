@@ -0,0 +1,90 @@
+#include <lightwave.hpp>
+
+#include "sobol.h"
+
+namespace lightwave {
+
+/**
+ * @brief Generates low-discrepancy samples from the Sobol sequence with Owen scrambling, which converge notably
+ * faster than independent random numbers for smooth integrands (e.g., direct lighting from area lights).
+ *
+ * Each call to @ref next or @ref next2D draws from its own dimension of the sample, in the order the decisions are
+ * made: the first dimensions steer the position within the pixel and on the lens, followed by the light selection,
+ * light sample and BSDF sample of each bounce. Every dimension uses the first two dimensions of the Sobol sequence
+ * (which form a (0,2)-sequence, i.e., all power-of-two prefixes are stratified in 2D), but is decorrelated from the
+ * other dimensions by shuffling the sample index and scrambling the resulting point with a hash of the pixel and
+ * dimension (see "Practical Hash-based Owen Scrambling", Burley 2020). As all of this is computed from the
+ * pixel and sample index, samples can be generated in any order and by any thread.
+ *
+ * @note The stratification is best when the number of samples per pixel is a power of two.
+ */
+class Sobol : public Sampler {
+    uint32_t m_seed;
+    /// @brief A hash of the pixel (and seed) that is currently sampled.
+    uint32_t m_pixelSeed;
+    /// @brief The index of the current sample within the pixel.
+    uint32_t m_index;
+    /// @brief The dimension the next random number is drawn from.
+    uint32_t m_dimension;
+
+    /// @brief The seed used to scramble the given dimension of the current pixel.
+    uint32_t dimensionSeed(uint32_t dimension) const {
+        return sobol::hashCombine(m_pixelSeed, dimension);
+    }
+
+public:
+    Sobol(const Properties &properties)
+    : Sampler(properties) {
+        m_seed = uint32_t(properties.get<int>("seed", 1337));
+        seed(0);
+    }
+
+    void seed(int sampleIndex) override {
+        m_pixelSeed = sobol::hash(m_seed);
+        m_index = uint32_t(sampleIndex);
+        m_dimension = 0;
+    }
+
+    void seed(const Point2i &pixel, int sampleIndex) override {
+        m_pixelSeed = sobol::hashCombine(sobol::hashCombine(sobol::hash(m_seed), uint32_t(pixel.x())),
+                                         uint32_t(pixel.y()));
+        m_index = uint32_t(sampleIndex);
+        m_dimension = 0;
+    }
+
+    float next() override {
+        const uint32_t seed = dimensionSeed(m_dimension++);
+        const uint32_t index = sobol::owenScramble(m_index, seed);
+        return sobol::toFloat(sobol::owenScramble(sobol::sobol0(index), sobol::hash(seed)));
+    }
+
+    Point2 next2D() override {
+        const uint32_t seed = dimensionSeed(m_dimension++);
+        const uint32_t index = sobol::owenScramble(m_index, seed);
+        return {
+            sobol::toFloat(sobol::owenScramble(sobol::sobol0(index), sobol::hashCombine(seed, 0))),
+            sobol::toFloat(sobol::owenScramble(sobol::sobol1(index), sobol::hashCombine(seed, 1))),
+        };
+    }
+
+    void skip(int count) override {
+        m_dimension += uint32_t(count);
+    }
+
+    ref<Sampler> clone() const override {
+        return std::make_shared<Sobol>(*this);
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "Sobol[\n"
+            "  count = %d\n"
+            "]",
+            m_samplesPerPixel
+        );
+    }
+};
+
+}
+
+REGISTER_SAMPLER(Sobol, "sobol")
@@ -0,0 +1,79 @@
+/**
+ * @file sobol.h
+ * @brief Helpers to generate points of the Sobol sequence with hash-based Owen scrambling, as described in
+ * "Practical Hash-based Owen Scrambling" (Burley, 2020).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace lightwave::sobol {
+
+/// @brief Reverses the order of the bits of a 32-bit integer.
+inline uint32_t reverseBits(uint32_t x) {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+}
+
+/// @brief Mixes the bits of a 32-bit integer, such that similar inputs give uncorrelated outputs.
+inline uint32_t hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x21f0aaadu;
+    x ^= x >> 15;
+    x *= 0x735a2d97u;
+    x ^= x >> 15;
+    return x;
+}
+
+/// @brief Combines a hash with another value.
+inline uint32_t hashCombine(uint32_t seed, uint32_t value) {
+    return hash(seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2)));
+}
+
+/**
+ * @brief A permutation of 32-bit integers in which each bit only depends on the bits below it (Laine and Karras,
+ * 2011), which is a random Owen scramble when applied to a bit-reversed number.
+ */
+inline uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+/**
+ * @brief Applies a random Owen scramble to a 32-bit fixed point number in [0,1), which randomly permutes the
+ * elementary intervals of each level while keeping a point set stratified. Applied to sample indices, this
+ * shuffles the order of the points of a sequence.
+ */
+inline uint32_t owenScramble(uint32_t x, uint32_t seed) {
+    return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+}
+
+/// @brief The first dimension of the Sobol sequence (the van der Corput sequence) as 32-bit fixed point number.
+inline uint32_t sobol0(uint32_t index) { return reverseBits(index); }
+
+/// @brief The second dimension of the Sobol sequence as 32-bit fixed point number.
+inline uint32_t sobol1(uint32_t index) {
+    uint32_t result = 0;
+    for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1) {
+        if (index & 1)
+            result ^= v;
+    }
+    return result;
+}
+
+/// @brief Converts a 32-bit fixed point number to a float in [0,1).
+inline float toFloat(uint32_t x) {
+    // only the upper 24 bits can be represented exactly, which also ensures the result is below one
+    return float(x >> 8) * 0x1p-24f;
+}
+
+}
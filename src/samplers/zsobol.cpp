@@ -0,0 +1,145 @@
+#include <lightwave.hpp>
+
+#include "sobol.h"
+
+namespace lightwave {
+
+/**
+ * @brief Generates Owen-scrambled Sobol samples like @ref Sobol , but distributes the samples of the sequence over
+ * the pixels in Morton (Z-curve) order, such that the error of neighbouring pixels is negatively correlated and
+ * appears as blue noise (see "Screen-Space Blue-Noise Diffusion of Monte Carlo Sampling Error via Hierarchical
+ * Ordering of Pixels", Ahmed and Wonka 2020).
+ *
+ * The samples of a pixel are a consecutive range of the sequence that starts at the Morton code of the pixel. As
+ * prefixes of the Sobol sequence of length 4^k are stratified, each 2^k by 2^k block of pixels jointly covers the
+ * sample space evenly. To avoid visible structure, the base-4 digits of the sample index are randomly permuted
+ * (seeded by the higher digits and the dimension), and each dimension is scrambled with a seed that is shared by
+ * all pixels.
+ *
+ * @note Samples beyond the sample count given to the sampler (e.g., from adaptive sampling) are drawn from
+ * independently scrambled copies of the pattern. The Morton code of the pixel is taken modulo the largest grid that
+ * fits into 32-bit sample indices, so the pattern repeats every 2048 pixels for up to 1024 samples per pixel.
+ */
+class ZSobol : public Sampler {
+    uint32_t m_seed;
+    /// @brief The number of bits of the sample index that are used to enumerate the samples of a pixel.
+    int m_log2Samples;
+    /// @brief The number of base-4 digits of the sample index (including the digits of the sample).
+    int m_base4Digits;
+
+    /// @brief The Morton code of the pixel followed by the sample index within the pixel.
+    uint32_t m_mortonIndex;
+    /// @brief Seeds the scrambling for samples beyond the sample count, zero within the sample count.
+    uint32_t m_repetition;
+    /// @brief The dimension the next random number is drawn from.
+    uint32_t m_dimension;
+
+    /// @brief Interleaves the lower 16 bits of a number with zeros.
+    static uint32_t spreadBits(uint32_t x) {
+        x &= 0x0000ffff;
+        x = (x ^ (x << 8)) & 0x00ff00ff;
+        x = (x ^ (x << 4)) & 0x0f0f0f0f;
+        x = (x ^ (x << 2)) & 0x33333333;
+        x = (x ^ (x << 1)) & 0x55555555;
+        return x;
+    }
+
+    /// @brief Randomly permutes the base-4 digits of the Morton index for the given dimension.
+    uint32_t sampleIndex(uint32_t dimension) const {
+        static constexpr uint8_t permutations[24][4] = {
+            { 0, 1, 2, 3 }, { 0, 1, 3, 2 }, { 0, 2, 1, 3 }, { 0, 2, 3, 1 }, { 0, 3, 2, 1 }, { 0, 3, 1, 2 },
+            { 1, 0, 2, 3 }, { 1, 0, 3, 2 }, { 1, 2, 0, 3 }, { 1, 2, 3, 0 }, { 1, 3, 2, 0 }, { 1, 3, 0, 2 },
+            { 2, 1, 0, 3 }, { 2, 1, 3, 0 }, { 2, 0, 1, 3 }, { 2, 0, 3, 1 }, { 2, 3, 0, 1 }, { 2, 3, 1, 0 },
+            { 3, 1, 2, 0 }, { 3, 1, 0, 2 }, { 3, 2, 1, 0 }, { 3, 2, 0, 1 }, { 3, 0, 2, 1 }, { 3, 0, 1, 2 },
+        };
+
+        // for an odd number of sample bits, the lowest digit is in base 2
+        const int odd = m_log2Samples & 1;
+        const uint32_t dimensionSeed = 0x55555555u * (dimension + 1) ^ m_seed;
+
+        uint32_t index = 0;
+        for (int i = m_base4Digits - 1; i >= odd; i--) {
+            const int shift = 2 * i - odd;
+            const uint32_t digit = (m_mortonIndex >> shift) & 3;
+            const uint64_t higherDigits = uint64_t(m_mortonIndex) >> (shift + 2);
+            const uint32_t permutation = (sobol::hash(uint32_t(higherDigits) ^ dimensionSeed) >> 24) % 24;
+            index |= uint32_t(permutations[permutation][digit]) << shift;
+        }
+        if (odd) {
+            const uint32_t digit = m_mortonIndex & 1;
+            index |= digit ^ (sobol::hash((m_mortonIndex >> 1) ^ dimensionSeed) & 1);
+        }
+        return index;
+    }
+
+    /// @brief The seed used to scramble the given dimension, which is shared by all pixels.
+    uint32_t dimensionSeed(uint32_t dimension) const {
+        return sobol::hashCombine(sobol::hashCombine(m_seed, m_repetition), dimension);
+    }
+
+public:
+    ZSobol(const Properties &properties)
+    : Sampler(properties) {
+        m_seed = uint32_t(properties.get<int>("seed", 1337));
+
+        m_log2Samples = 0;
+        while ((1 << m_log2Samples) < m_samplesPerPixel)
+            m_log2Samples++;
+        if (m_log2Samples > 30) {
+            lightwave_throw("zsobol sampler supports at most 2^30 samples per pixel");
+        }
+        // use as many bits for the Morton code as fit into the 32-bit sample index
+        const int pixelDigits = (32 - m_log2Samples) / 2;
+        m_base4Digits = pixelDigits + (m_log2Samples + 1) / 2;
+        seed(0);
+    }
+
+    void seed(int sampleIndex) override {
+        seed(Point2i(0), sampleIndex);
+    }
+
+    void seed(const Point2i &pixel, int sampleIndex) override {
+        const uint32_t morton = spreadBits(uint32_t(pixel.x())) | (spreadBits(uint32_t(pixel.y())) << 1);
+        const uint32_t sampleMask = (1u << m_log2Samples) - 1;
+        m_mortonIndex = (morton << m_log2Samples) | (uint32_t(sampleIndex) & sampleMask);
+        m_repetition = uint32_t(sampleIndex) >> m_log2Samples;
+        m_dimension = 0;
+    }
+
+    float next() override {
+        const uint32_t dimension = m_dimension++;
+        const uint32_t index = sampleIndex(dimension);
+        return sobol::toFloat(sobol::owenScramble(sobol::sobol0(index), dimensionSeed(dimension)));
+    }
+
+    Point2 next2D() override {
+        const uint32_t dimension = m_dimension++;
+        const uint32_t index = sampleIndex(dimension);
+        const uint32_t seed = dimensionSeed(dimension);
+        return {
+            sobol::toFloat(sobol::owenScramble(sobol::sobol0(index), sobol::hashCombine(seed, 0))),
+            sobol::toFloat(sobol::owenScramble(sobol::sobol1(index), sobol::hashCombine(seed, 1))),
+        };
+    }
+
+    void skip(int count) override {
+        m_dimension += uint32_t(count);
+    }
+
+    ref<Sampler> clone() const override {
+        return std::make_shared<ZSobol>(*this);
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "ZSobol[\n"
+            "  count = %d\n"
+            "]",
+            m_samplesPerPixel
+        );
+    }
+};
+
+}
+
+REGISTER_SAMPLER(ZSobol, "zsobol")
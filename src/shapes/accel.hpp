@@ -140,6 +140,29 @@ class AccelerationStructure : public Shape {
         return wasIntersected;
     }
 
+    /**
+     * @brief Collects the medium crossings of all primitives in a node up to a maximal distance (see
+     * @ref Shape::intersectCrossings ), returning false as soon as a primitive blocks the ray.
+     */
+    bool intersectCrossingsNode(const Node &node, const Ray &ray, float tMax,
+                                std::vector<MediumCrossing> &crossings, Sampler &rng) const {
+        if (node.isLeaf()) {
+            for (NodeIndex i = 0; i < node.primitiveCount; i++) {
+                if (!intersectCrossings(m_primitiveIndices[node.leftFirst + i], ray, tMax, crossings, rng))
+                    return false;
+            }
+            return true;
+        }
+
+        // all children within reach need to be visited, so their order only matters for finding blockers early
+        for (const NodeIndex child : { node.leftChildIndex(), node.rightChildIndex() }) {
+            if (intersectAABB(m_nodes[child].aabb, ray) < tMax &&
+                !intersectCrossingsNode(m_nodes[child], ray, tMax, crossings, rng))
+                return false;
+        }
+        return true;
+    }
+
     /// @brief Performs a slab test to intersect a bounding box with a ray,
     /// returning Infinity in case the ray misses.
     float intersectAABB(const Bounds &bounds, const Ray &ray) const {
@@ -389,6 +412,13 @@ protected:
     /// ray.
     virtual bool intersect(int primitiveIndex, const Ray &ray,
                            Intersection &its, Sampler &rng) const = 0;
+    /// @brief Collects the medium crossings of a single child (see @ref Shape::intersectCrossings ), which by
+    /// default is opaque.
+    virtual bool intersectCrossings(int primitiveIndex, const Ray &ray, float tMax,
+                                    std::vector<MediumCrossing> &crossings, Sampler &rng) const {
+        Intersection its(-ray.direction, tMax);
+        return !intersect(primitiveIndex, ray, its, rng);
+    }
     /// @brief Returns the axis aligned bounding box of the given child.
     virtual Bounds getBoundingBox(int primitiveIndex) const = 0;
     /// @brief Returns the centroid of the given child.
@@ -425,6 +455,13 @@ public:
         return false;
     }
 
+    bool intersectCrossings(const Ray &ray, float tMax, std::vector<MediumCrossing> &crossings,
+                            Sampler &rng) const override {
+        if (m_primitiveIndices.empty() || !(intersectAABB(rootNode().aabb, ray) < tMax))
+            return true;
+        return intersectCrossingsNode(rootNode(), ray, tMax, crossings, rng);
+    }
+
     Bounds getBoundingBox() const override { return rootNode().aabb; }
 
     Point getCentroid() const override { return rootNode().aabb.center(); }
@@ -21,6 +21,11 @@ protected:
         return m_children[primitiveIndex]->intersect(ray, its, rng);
     }
 
+    bool intersectCrossings(int primitiveIndex, const Ray &ray, float tMax, std::vector<MediumCrossing> &crossings,
+                            Sampler &rng) const override {
+        return m_children[primitiveIndex]->intersectCrossings(ray, tMax, crossings, rng);
+    }
+
     Bounds getBoundingBox(int primitiveIndex) const override {
         return m_children[primitiveIndex]->getBoundingBox();
     }
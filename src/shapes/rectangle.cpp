@@ -28,6 +28,61 @@ class Rectangle : public Shape {
         surf.pdf = 1.0f / 4;
     }
 
+    /**
+     * @brief The rectangle as seen from a point, used to sample it by solid angle (see "An Area-Preserving
+     * Parametrization for Spherical Rectangles", Urena et al. 2013).
+     * Coordinates are relative to the point, with the z axis pointing away from the rectangle.
+     */
+    struct SphericalRectangle {
+        float x0, x1, y0, y1, z0;
+        /// @brief The z components of the normals of the planes through the edges at y0 and y1.
+        float b0, b1;
+        /// @brief The interior angles of the spherical rectangle.
+        float g0, g1, g2, g3;
+        /// @brief The solid angle covered by the rectangle.
+        float solidAngle;
+
+        explicit SphericalRectangle(const Point &origin) {
+            x0 = -1 - origin.x(), x1 = 1 - origin.x();
+            y0 = -1 - origin.y(), y1 = 1 - origin.y();
+            z0 = -abs(origin.z());
+
+            // the planes through the origin and each edge of the rectangle
+            const Vector v00(x0, y0, z0), v01(x0, y1, z0), v10(x1, y0, z0), v11(x1, y1, z0);
+            const Vector n0 = v00.cross(v10).normalized();
+            const Vector n1 = v10.cross(v11).normalized();
+            const Vector n2 = v11.cross(v01).normalized();
+            const Vector n3 = v01.cross(v00).normalized();
+            b0 = n0.z(), b1 = n2.z();
+            g0 = angleBetween(-n0, n1);
+            g1 = angleBetween(-n1, n2);
+            g2 = angleBetween(-n2, n3);
+            g3 = angleBetween(-n3, n0);
+            solidAngle = g0 + g1 + g2 + g3 - 2 * Pi;
+        }
+
+        /// @brief Reports whether sampling by solid angle is numerically stable, which fails for tiny solid angles
+        /// (where sampling by area works just as well) and for points (almost) in the plane of the rectangle.
+        bool isStable() const {
+            return z0 < 0 && solidAngle > 3e-4f && solidAngle < 6.22f;
+        }
+
+        /// @brief Computes the angle between two unit vectors accurately (see pbrt-v4).
+        static float angleBetween(const Vector &a, const Vector &b) {
+            if (a.dot(b) < 0)
+                return Pi - 2 * std::asin(std::min((a + b).length() / 2, 1.f));
+            return 2 * std::asin(std::min((b - a).length() / 2, 1.f));
+        }
+    };
+
+    /// @brief Converts the uniform density over the solid angle of the rectangle to a density over area, relative
+    /// to the density 1/4 of sampling by area.
+    static float pdfRatioFrom(const SphericalRectangle &rect, const Point &origin, const Point &position) {
+        const float distance2 = (position - origin).lengthSquared();
+        const float cosTheta = abs(origin.z()) / sqrt(distance2);
+        return 4 * cosTheta / (distance2 * rect.solidAngle);
+    }
+
 public:
     Rectangle(const Properties &properties) {
     }
@@ -77,6 +132,44 @@ public:
         return sample;
     }
 
+    AreaSample sampleAreaFrom(const Point &origin, Sampler &rng) const override {
+        const SphericalRectangle rect(origin);
+        if (!rect.isStable()) {
+            return sampleArea(rng);
+        }
+
+        // sample the x coordinate by the solid angle of the part of the rectangle left of it
+        const Point2 rnd = rng.next2D();
+        const float au = rnd.x() * (rect.g0 + rect.g1 - 2 * Pi) + (rnd.x() - 1) * (rect.g2 + rect.g3);
+        const float fu = (std::cos(au) * rect.b0 - rect.b1) / std::sin(au);
+        const float cu = std::clamp(copysign(1 / sqrt(sqr(fu) + sqr(rect.b0)), fu), -1 + Epsilon, 1 - Epsilon);
+        const float xu = std::clamp(-(cu * rect.z0) / safe_sqrt(1 - sqr(cu)), rect.x0, rect.x1);
+
+        // sample the y coordinate uniformly in solid angle along the line at x
+        const float distance = sqrt(sqr(xu) + sqr(rect.z0));
+        const float h0 = rect.y0 / sqrt(sqr(distance) + sqr(rect.y0));
+        const float h1 = rect.y1 / sqrt(sqr(distance) + sqr(rect.y1));
+        const float hv = h0 + rnd.y() * (h1 - h0);
+        const float yv = sqr(hv) < 1 - Epsilon ? hv * distance / sqrt(1 - sqr(hv)) : rect.y1;
+
+        const Point position {
+            std::clamp(origin.x() + xu, -1.f, +1.f),
+            std::clamp(origin.y() + yv, -1.f, +1.f),
+            0,
+        };
+
+        AreaSample sample;
+        sample.area = 2*2;
+        populate(sample, position);
+        sample.pdf *= pdfRatioFrom(rect, origin, position);
+        return sample;
+    }
+
+    float pdfRatioFrom(const Point &origin, const Point &position) const override {
+        const SphericalRectangle rect(origin);
+        return rect.isStable() ? pdfRatioFrom(rect, origin, position) : 1;
+    }
+
     std::string toString() const override {
         return "Rectangle[]";
     }
@@ -1,6 +1,8 @@
 #include <lightwave.hpp>
 #include "../sdfobject.hpp"
 
+#include <array>
+
 namespace lightwave {
 
 class SDFTransform : public SDFObject {
@@ -38,18 +40,17 @@ public:
         const Point oldMin = oldBounds.min();
         const Point oldMax = oldBounds.max();
 
-        // Calculate new AABB for transformed bounding box
-        std::vector<Point> tPoints;
-
-        // Add all corner points to list
-        tPoints.push_back(oldMin);                                      // 000
-        tPoints.push_back(Point(oldMin.x(), oldMin.y(), oldMax.z()));   // 001
-        tPoints.push_back(Point(oldMin.x(), oldMax.y(), oldMin.z()));   // 010
-        tPoints.push_back(Point(oldMin.x(), oldMax.y(), oldMax.z()));   // 011
-        tPoints.push_back(Point(oldMax.x(), oldMin.y(), oldMin.z()));   // 100
-        tPoints.push_back(Point(oldMax.x(), oldMin.y(), oldMax.z()));   // 101
-        tPoints.push_back(Point(oldMax.x(), oldMax.y(), oldMin.z()));   // 110
-        tPoints.push_back(oldMax);                                      // 111
+        // Calculate new AABB for transformed bounding box from all corner points
+        const std::array<Point, 8> tPoints = {
+            oldMin,                                     // 000
+            Point(oldMin.x(), oldMin.y(), oldMax.z()),  // 001
+            Point(oldMin.x(), oldMax.y(), oldMin.z()),  // 010
+            Point(oldMin.x(), oldMax.y(), oldMax.z()),  // 011
+            Point(oldMax.x(), oldMin.y(), oldMin.z()),  // 100
+            Point(oldMax.x(), oldMin.y(), oldMax.z()),  // 101
+            Point(oldMax.x(), oldMax.y(), oldMin.z()),  // 110
+            oldMax,                                     // 111
+        };
 
         Bounds tBounds;
 
@@ -24,6 +24,10 @@ class Sphere : public Shape {
     /// @brief The radius of the sphere
     float m_radius;
 
+    /// @brief Beyond this value of sin^2 of the half angle of the cone towards the sphere, points count as lying on
+    /// the sphere, for which sampling by solid angle becomes unstable.
+    static constexpr float MaxSin2ThetaMax = 0.999f;
+
     /**
      * @brief Constructs a surface event for a given position, used by @ref intersect to populate the @ref Intersection
      * and by @ref sampleArea to populate the @ref AreaSample .
@@ -121,6 +125,56 @@ public:
         return sample;
     }
     
+    AreaSample sampleAreaFrom(const Point &origin, Sampler &rng) const override {
+        // points within (or on) the sphere see all of its surface, which is sampled by area instead
+        const Vector toOrigin = origin - m_center;
+        const float distance2 = toOrigin.lengthSquared();
+        const float sin2ThetaMax = sqr(m_radius) / distance2;
+        if (!(sin2ThetaMax < MaxSin2ThetaMax)) {
+            return sampleArea(rng);
+        }
+
+        // sample a direction within the cone of directions towards the sphere (see pbrt-v4), where 1-cos(theta) is
+        // computed from sines to remain accurate for small spheres
+        const float oneMinusCosThetaMax = sin2ThetaMax / (1 + safe_sqrt(1 - sin2ThetaMax));
+        const Point2 rnd = rng.next2D();
+        const float oneMinusCosTheta = rnd.x() * oneMinusCosThetaMax;
+        const float cosTheta = 1 - oneMinusCosTheta;
+        const float sin2Theta = oneMinusCosTheta * (2 - oneMinusCosTheta);
+
+        // find the point on the sphere that the direction hits first, given by its angle alpha to the direction
+        // towards the origin as seen from the center
+        const float cosAlpha = sin2Theta / sqrt(sin2ThetaMax) + cosTheta * safe_sqrt(1 - sin2Theta / sin2ThetaMax);
+        const float sinAlpha = safe_sqrt(1 - sqr(cosAlpha));
+        const float phi = 2 * Pi * rnd.y();
+        const Frame frame(toOrigin / sqrt(distance2));
+        const Vector normal = frame.toWorld(Vector(sinAlpha * std::cos(phi), sinAlpha * std::sin(phi), cosAlpha));
+
+        AreaSample sample;
+        sample.area = 4*Pi;
+        populate(sample, m_center + m_radius * normal.normalized());
+        sample.pdf *= pdfRatioFrom(origin, sample.position);
+        return sample;
+    }
+
+    float pdfRatioFrom(const Point &origin, const Point &position) const override {
+        const Vector toOrigin = origin - m_center;
+        const float sin2ThetaMax = sqr(m_radius) / toOrigin.lengthSquared();
+        if (!(sin2ThetaMax < MaxSin2ThetaMax)) {
+            return 1;
+        }
+
+        // convert the uniform density over the cone to a density over area, relative to the density 1/(4pi) of
+        // sampling by area
+        const float solidAngle = 2 * Pi * sin2ThetaMax / (1 + safe_sqrt(1 - sin2ThetaMax));
+        const Vector toPoint = origin - position;
+        const float cosTheta = (position - m_center).dot(toPoint) / (m_radius * toPoint.length());
+        if (cosTheta <= 0) {
+            return 0;
+        }
+        return 4 * Pi * cosTheta / (toPoint.lengthSquared() * solidAngle);
+    }
+
     std::string toString() const override {
         return "Sphere[]";
     }
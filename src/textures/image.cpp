@@ -122,6 +122,8 @@ public:
         return pxColor * this->m_exposure;
     }
 
+    Point2i resolution() const override { return m_image->resolution(); }
+
     std::string toString() const override {
         return tfm::format("ImageTexture[\n"
                            "  image = %s,\n"
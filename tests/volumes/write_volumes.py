@@ -0,0 +1,81 @@
+#! /usr/bin/env python3
+
+# Writes the volumes used by the tests of the grid medium (see src/mediums/grid.cpp for the file format):
+# - constant.lwvg: a dense volume of density one everywhere
+# - cloud_dense.lwvg: a few smooth blobs, stored densely
+# - cloud_sparse.lwvg: the same blobs, stored in bricks of which the empty ones are left out
+
+import math
+import os
+import struct
+
+RESOLUTION = 32
+BRICK_SIZE = 8
+
+# the centers (in [-1,1]^3), radii and peak densities of the blobs
+BLOBS = [
+    ((-0.25, 0.1, 0.0), 0.45, 4.0),
+    ((0.3, -0.2, 0.1), 0.35, 6.0),
+    ((0.05, 0.35, -0.2), 0.3, 3.0),
+]
+
+
+def cloud(x, y, z):
+    """Returns the density of a voxel, whose center is mapped to [-1,1]^3."""
+    p = [2 * (c + 0.5) / RESOLUTION - 1 for c in (x, y, z)]
+    density = 0
+    for center, radius, peak in BLOBS:
+        r = math.dist(p, center) / radius
+        if r < 1:
+            density += peak * (1 - r * r) ** 2
+    return density
+
+
+def header(brick_size, resolution, brick_count):
+    return b"LWVG" + struct.pack("<IIiiiQ", 1, brick_size, *resolution, brick_count)
+
+
+def write_dense(path, resolution, density):
+    with open(path, "wb") as f:
+        f.write(header(0, resolution, 0))
+        for z in range(resolution[2]):
+            for y in range(resolution[1]):
+                for x in range(resolution[0]):
+                    f.write(struct.pack("<f", density(x, y, z)))
+
+
+def write_sparse(path, resolution, brick_size, density):
+    bricks = [(r + brick_size - 1) // brick_size for r in resolution]
+    table = []
+    data = bytearray()
+    for bz in range(bricks[2]):
+        for by in range(bricks[1]):
+            for bx in range(bricks[0]):
+                # voxels outside of the volume are stored as zero, as they are never read
+                values = [
+                    density(x, y, z)
+                    if x < resolution[0] and y < resolution[1] and z < resolution[2] else 0
+                    for z in range(bz * brick_size, (bz + 1) * brick_size)
+                    for y in range(by * brick_size, (by + 1) * brick_size)
+                    for x in range(bx * brick_size, (bx + 1) * brick_size)
+                ]
+                if not any(values):
+                    table.append(-1)
+                    continue
+                table.append(len(data) // (4 * brick_size ** 3))
+                data += struct.pack(f"<{len(values)}f", *values)
+
+    brick_count = len(data) // (4 * brick_size ** 3)
+    with open(path, "wb") as f:
+        f.write(header(brick_size, resolution, brick_count))
+        f.write(struct.pack(f"<{len(table)}i", *table))
+        f.write(data)
+    print(f"{os.path.basename(path)}: {brick_count} of {len(table)} bricks stored")
+
+
+if __name__ == "__main__":
+    directory = os.path.dirname(os.path.abspath(__file__))
+    resolution = (RESOLUTION,) * 3
+    write_dense(os.path.join(directory, "constant.lwvg"), (4, 4, 4), lambda x, y, z: 1.0)
+    write_dense(os.path.join(directory, "cloud_dense.lwvg"), resolution, cloud)
+    write_sparse(os.path.join(directory, "cloud_sparse.lwvg"), resolution, BRICK_SIZE, cloud)